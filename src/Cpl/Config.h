@@ -30,3 +30,5 @@
 
 //#define CPL_IMPLEMENT
 
+//#define CPL_YAML_NO_EXCEPTIONS
+
@@ -28,6 +28,7 @@
 
 #include "Cpl/String.h"
 #include "Cpl/Log.h"
+#include "Cpl/Performance.h"
 #include "Cpl/Xml.h"
 #include "Cpl/Yaml.h"
 #include "Cpl/File.h"
@@ -80,7 +81,8 @@ namespace Cpl
             CloneNode((Unknown*)&other);
         }
 
-        bool Save(std::ostream& os, bool full, ParamFormat format) const
+        /// Set flow to write arithmetic vectors in YAML flow style ([1, 2, 3]).
+        bool Save(std::ostream& os, bool full, ParamFormat format, bool flow = false) const
         {
             if (format == ParamFormatXml)
             {
@@ -95,7 +97,10 @@ namespace Cpl
             else if (format == ParamFormatYaml)
             {
                 Yaml::Node root;
-                this->SaveNodeYaml(root, full);
+                if (flow)
+                    this->SaveNodeYamlFlow(root, full);
+                else
+                    this->SaveNodeYaml(root, full);
                 try
                 {
                     Yaml::Serialize(root, os);
@@ -114,7 +119,7 @@ namespace Cpl
             return true;
         }
 
-        bool Save(const String& path, bool full, ParamFormat format = ParamFormatByExt) const
+        bool Save(const String& path, bool full, ParamFormat format = ParamFormatByExt, bool flow = false) const
         {
             if (!DetectFormat(path, format))
                 return false;
@@ -122,7 +127,7 @@ namespace Cpl
             std::ofstream ofs(path.c_str());
             if (ofs.is_open())
             {
-                result = this->Save(ofs, full, format);
+                result = this->Save(ofs, full, format, flow);
                 ofs.close();
             }
             else
@@ -151,7 +156,7 @@ namespace Cpl
                     CPL_LOG_SS(Error, "Exception " << e.GetType() << ": " << e.what());
                     return false;
                 }
-                return LoadNodeYaml(root);
+                return LoadNodeYamlConst(root);
             }
             else
             {
@@ -179,7 +184,7 @@ namespace Cpl
                     CPL_LOG_SS(Error, "Exception " << e.GetType() << ": " << e.what());
                     return false;
                 }
-                return LoadNodeYaml(root);
+                return LoadNodeYamlConst(root);
             }
             else
             {
@@ -245,6 +250,7 @@ namespace Cpl
                 CPL_LOG_SS(Error, "Can't parse xml! There is an exception: " << e.what());
                 return false;
             }
+            CPL_PERF_MEM("xml pool", doc.GetStatistics().bytes);
             return this->LoadNodeXml(&doc);
         }
 
@@ -262,8 +268,28 @@ namespace Cpl
 
         virtual bool LoadNodeYaml(Yaml::Node& node) = 0;
 
+        /// Loads from a node which is not modified (copy-on-write nodes stay shared), the default forwards to LoadNodeYaml().
+        virtual bool LoadNodeYamlConst(const Yaml::Node& node)
+        {
+            return LoadNodeYaml(const_cast<Yaml::Node&>(node));
+        }
+
         virtual void SaveNodeYaml(Yaml::Node & node, bool full) const = 0;
 
+        /// Saves arithmetic vectors in YAML flow style ([1, 2, 3]), containers pass it to their children.
+        virtual void SaveNodeYamlFlow(Yaml::Node& node, bool full) const
+        {
+            SaveNodeYaml(node, full);
+        }
+
+        static void SaveChildYaml(const Unknown* param, Yaml::Node& node, bool full, bool flow)
+        {
+            if (flow)
+                param->SaveNodeYamlFlow(node, full);
+            else
+                param->SaveNodeYaml(node, full);
+        }
+
         template<typename> friend struct Param;
         template<typename> friend struct ParamValue;
         template<typename> friend struct ParamLimited;
@@ -320,27 +346,32 @@ namespace Cpl
         {
             Xml::XmlNode<char>* xmlCurrent = xmlParent->FirstNode(this->Name().c_str());
             if (xmlCurrent)
-                Cpl::ToVal(xmlCurrent->Value(), this->_value);
+                xmlCurrent->Get(this->_value);
             return true;
         }
 
         void SaveNodeXml(Xml::XmlDocument<char>& xmlDoc, Xml::XmlNode<char>* xmlParent, bool full) const override
         {
-            Xml::XmlNode<char>* xmlCurrent = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString(this->Name().c_str()));
-            xmlCurrent->Value(xmlDoc.AllocateString(Cpl::ToStr(this->_value).c_str()));
+            Xml::XmlNode<char>* xmlCurrent = xmlDoc.CreateNode(Xml::NodeElement, this->Name().c_str(), Cpl::ToStr(this->_value).c_str());
             xmlParent->AppendNode(xmlCurrent);
         }
 
         bool LoadNodeYaml(Yaml::Node& node) override
         {
-            Yaml::Node & current = node[this->Name()];
-            if (current.Type() != Yaml::Node::None)
+            return LoadNodeYamlConst(node);
+        }
+
+        bool LoadNodeYamlConst(const Yaml::Node& node) override
+        {
+            const Yaml::Node* current = node.Find(this->Name());
+            if (current && current->Type() != Yaml::Node::None)
             {
-                if (current.Type() != Yaml::Node::ScalarType)
+                if (current->Type() == Yaml::Node::SequenceType)
+                    return current->Get(this->_value);
+                if (current->Type() != Yaml::Node::ScalarType)
                     return false;
-                String string = current.As<String>();
-                if(string != "\n")
-                    Cpl::ToVal(current.As<String>(), this->_value);
+                if (current->As<String>() != "\n")
+                    current->Get(this->_value);
             }
             return true;
         }
@@ -349,6 +380,39 @@ namespace Cpl
         {
             node[this->Name()] = Cpl::ToStr(this->_value);
         }
+
+        void SaveNodeYamlFlow(Yaml::Node& node, bool /*full*/) const override
+        {
+            SaveYamlFlow(node[this->Name()], this->_value);
+        }
+
+    private:
+        template<class V> static void SaveYamlFlow(Yaml::Node& node, const V& value)
+        {
+            node = Cpl::ToStr(value);
+        }
+
+        template<class V> static void SaveYamlFlow(Yaml::Node& node, const std::vector<V>& values)
+        {
+            SaveYamlFlow(node, values, std::is_arithmetic<V>());
+        }
+
+        template<class V> static void SaveYamlFlow(Yaml::Node& node, const std::vector<V>& values, std::true_type)
+        {
+            if (values.empty())
+            {
+                node = Cpl::ToStr(values);
+                return;
+            }
+            for (size_t i = 0; i < values.size(); ++i)
+                node.PushBack() = Cpl::ToStr(values[i]);
+            node.SetFlow(true);
+        }
+
+        template<class V> static void SaveYamlFlow(Yaml::Node& node, const std::vector<V>& values, std::false_type)
+        {
+            node = Cpl::ToStr(values);
+        }
     };
 
     //---------------------------------------------------------------------------------------------
@@ -427,7 +491,7 @@ namespace Cpl
             if (xmlCurrent)
             {
                 T value;
-                Cpl::ToVal(xmlCurrent->Value(), value);
+                xmlCurrent->Get(value);
                 (*this)() = value;
             }
             return true;
@@ -435,13 +499,18 @@ namespace Cpl
 
         bool LoadNodeYaml(Yaml::Node& node) override
         {
-            Yaml::Node& current = node[this->Name()];
-            if (current.Type() != Yaml::Node::None)
+            return LoadNodeYamlConst(node);
+        }
+
+        bool LoadNodeYamlConst(const Yaml::Node& node) override
+        {
+            const Yaml::Node* current = node.Find(this->Name());
+            if (current && current->Type() != Yaml::Node::None)
             {
-                if (current.Type() != Yaml::Node::ScalarType)
+                if (current->Type() != Yaml::Node::ScalarType)
                     return false;
                 T value;
-                Cpl::ToVal(current.As<String>(), value);
+                current->Get(value);
                 (*this)() = value;
             }
             return true;
@@ -519,7 +588,7 @@ namespace Cpl
 
         void SaveNodeXml(Xml::XmlDocument<char>& xmlDoc, Xml::XmlNode<char>* xmlParent, bool full) const override
         {
-            Xml::XmlNode<char>* xmlCurrent = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString(this->Name().c_str()));
+            Xml::XmlNode<char>* xmlCurrent = xmlDoc.CreateNode(Xml::NodeElement, this->Name().c_str());
             for (const Unknown* paramChild = this->ChildBeg(); paramChild < this->End(); paramChild = paramChild->End())
             {
                 if (full || paramChild->Changed())
@@ -530,14 +599,19 @@ namespace Cpl
 
         bool LoadNodeYaml(Yaml::Node& node) override
         {
-            Yaml::Node & current = node[this->Name()];
-            if (current.Type() != Yaml::Node::None)
+            return LoadNodeYamlConst(node);
+        }
+
+        bool LoadNodeYamlConst(const Yaml::Node& node) override
+        {
+            const Yaml::Node* current = node.Find(this->Name());
+            if (current && current->Type() != Yaml::Node::None)
             {
-                if (current.Type() != Yaml::Node::MapType)
+                if (current->Type() != Yaml::Node::MapType)
                     return false;
                 for (Unknown* paramChild = this->ChildBeg(); paramChild < this->End(); paramChild = paramChild->End())
                 {
-                    if (!paramChild->LoadNodeYaml(current))
+                    if (!paramChild->LoadNodeYamlConst(*current))
                         return true;
                 }
             }
@@ -545,12 +619,22 @@ namespace Cpl
         }
 
         void SaveNodeYaml(Yaml::Node& node, bool full) const override
+        {
+            SaveYaml(node, full, false);
+        }
+
+        void SaveNodeYamlFlow(Yaml::Node& node, bool full) const override
+        {
+            SaveYaml(node, full, true);
+        }
+
+        void SaveYaml(Yaml::Node& node, bool full, bool flow) const
         {
             Yaml::Node& current = node[this->Name()];
             for (const Unknown* paramChild = this->ChildBeg(); paramChild < this->End(); paramChild = paramChild->End())
             {
                 if (full || paramChild->Changed())
-                    paramChild->SaveNodeYaml(current, full);
+                    Unknown::SaveChildYaml(paramChild, current, full, flow);
             }
         }
 
@@ -644,12 +728,12 @@ namespace Cpl
 
         void SaveNodeXml(Xml::XmlDocument<char>& xmlDoc, Xml::XmlNode<char>* xmlParent, bool full) const override
         {
-            Xml::XmlNode<char>* xmlCurrent = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString(this->Name().c_str()));
+            Xml::XmlNode<char>* xmlCurrent = xmlDoc.CreateNode(Xml::NodeElement, this->Name().c_str());
             for (size_t i = 0; i < Size(); ++i)
             {
                 const Unknown* paramChild = this->ChildBeg(i);
                 const Unknown* paramChildEnd = this->ChildBeg(i + 1);
-                Xml::XmlNode<char>* xmlItem = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString(ItemName().c_str()));
+                Xml::XmlNode<char>* xmlItem = xmlDoc.CreateNode(Xml::NodeElement, ItemName().c_str());
                 for (; paramChild < paramChildEnd; paramChild = paramChild->End())
                 {
                     if (full || paramChild->Changed())
@@ -662,19 +746,24 @@ namespace Cpl
 
         bool LoadNodeYaml(Yaml::Node& node) override
         {
-            Yaml::Node& current = node[this->Name()];
-            if (current.Type() != Yaml::Node::None)
+            return LoadNodeYamlConst(node);
+        }
+
+        bool LoadNodeYamlConst(const Yaml::Node& node) override
+        {
+            const Yaml::Node* current = node.Find(this->Name());
+            if (current && current->Type() != Yaml::Node::None)
             {
-                if (current.Type() != Yaml::Node::SequenceType)
+                if (current->Type() != Yaml::Node::SequenceType)
                     return false;
-                Resize(current.Size());
+                Resize(current->Size());
                 for (size_t i = 0; i < Size(); ++i)
                 {
                     Unknown* paramChild = this->ChildBeg(i);
                     const Unknown* paramChildEnd = this->ChildBeg(i + 1);
                     for (; paramChild < paramChildEnd; paramChild = paramChild->End())
                     {
-                        if (!paramChild->LoadNodeYaml(current[i]))
+                        if (!paramChild->LoadNodeYamlConst((*current)[i]))
                             return true;
                     }
                 }
@@ -683,6 +772,16 @@ namespace Cpl
         }
 
         void SaveNodeYaml(Yaml::Node& node, bool full) const override
+        {
+            SaveYaml(node, full, false);
+        }
+
+        void SaveNodeYamlFlow(Yaml::Node& node, bool full) const override
+        {
+            SaveYaml(node, full, true);
+        }
+
+        void SaveYaml(Yaml::Node& node, bool full, bool flow) const
         {
             Yaml::Node& current = node[this->Name()];
             for (size_t i = 0; i < Size(); ++i)
@@ -695,12 +794,12 @@ namespace Cpl
                 {
                     if (full || paramChild->Changed())
                     {
-                        paramChild->SaveNodeYaml(childNode, full);
+                        Unknown::SaveChildYaml(paramChild, childNode, full, flow);
                         saved = true;
                     }
                 }
                 if(!saved)
-                    this->ChildBeg(i)->SaveNodeYaml(childNode, full);
+                    Unknown::SaveChildYaml(this->ChildBeg(i), childNode, full, flow);
             }
         }
     };
@@ -799,7 +898,7 @@ namespace Cpl
                     if (xmlKey)
                     {
                         K key;
-                        Cpl::ToVal(xmlKey->Value(), key);
+                        xmlKey->Get(key);
                         T & value = this->_value[key];
                         Xml::XmlNode<char>* xmlValue = xmlItem->FirstNode(ValueName().c_str());
                         if (xmlValue)
@@ -821,16 +920,15 @@ namespace Cpl
 
         void SaveNodeXml(Xml::XmlDocument<char>& xmlDoc, Xml::XmlNode<char>* xmlParent, bool full) const override
         {
-            Xml::XmlNode<char>* xmlCurrent = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString(this->Name().c_str()));
+            Xml::XmlNode<char>* xmlCurrent = xmlDoc.CreateNode(Xml::NodeElement, this->Name().c_str());
             for (typename Map::const_iterator it = this->_value.begin(); it != this->_value.end(); ++it)
             {
-                Xml::XmlNode<char>* xmlItem = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString(ItemName().c_str()));
+                Xml::XmlNode<char>* xmlItem = xmlDoc.CreateNode(Xml::NodeElement, ItemName().c_str());
 
-                Xml::XmlNode<char>* xmlKey = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString(KeyName().c_str()));
-                xmlKey->Value(xmlDoc.AllocateString(Cpl::ToStr(it->first).c_str()));
+                Xml::XmlNode<char>* xmlKey = xmlDoc.CreateNode(Xml::NodeElement, KeyName().c_str(), Cpl::ToStr(it->first).c_str());
                 xmlItem->AppendNode(xmlKey);
 
-                Xml::XmlNode<char>* xmlValue = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString(ValueName().c_str()));
+                Xml::XmlNode<char>* xmlValue = xmlDoc.CreateNode(Xml::NodeElement, ValueName().c_str());
                 const Unknown* paramChild = this->ChildBeg(it->second);
                 const Unknown* paramChildEnd = this->ChildEnd(it->second);
                 for (; paramChild < paramChildEnd; paramChild = paramChild->End())
@@ -847,12 +945,17 @@ namespace Cpl
 
         bool LoadNodeYaml(Yaml::Node& node) override
         {
-            Yaml::Node& current = node[this->Name()];
-            if (current.Type() != Yaml::Node::None)
+            return LoadNodeYamlConst(node);
+        }
+
+        bool LoadNodeYamlConst(const Yaml::Node& node) override
+        {
+            const Yaml::Node* current = node.Find(this->Name());
+            if (current && current->Type() != Yaml::Node::None)
             {
-                if (current.Type() != Yaml::Node::MapType)
+                if (current->Type() != Yaml::Node::MapType)
                     return false;
-                for (Yaml::Iterator it = current.Begin(), end = current.End(); it != end; it++)
+                for (Yaml::ConstIterator it = current->Begin(), end = current->End(); it != end; it++)
                 {
                     K key;
                     Cpl::ToVal((*it).first, key);
@@ -863,7 +966,7 @@ namespace Cpl
                         Unknown* paramChildEnd = ChildEnd(value);
                         for (; paramChild < paramChildEnd; paramChild = paramChild->End())
                         {
-                            if (!paramChild->LoadNodeYaml((*it).second))
+                            if (!paramChild->LoadNodeYamlConst((*it).second))
                                 return true;
                         }
                     }
@@ -873,6 +976,16 @@ namespace Cpl
         }
 
         void SaveNodeYaml(Yaml::Node& node, bool full) const override
+        {
+            SaveYaml(node, full, false);
+        }
+
+        void SaveNodeYamlFlow(Yaml::Node& node, bool full) const override
+        {
+            SaveYaml(node, full, true);
+        }
+
+        void SaveYaml(Yaml::Node& node, bool full, bool flow) const
         {
             Yaml::Node& current = node[this->Name()];
             for (typename Map::const_iterator it = this->_value.begin(); it != this->_value.end(); ++it)
@@ -885,12 +998,12 @@ namespace Cpl
                 {
                     if (full || paramChild->Changed())
                     {
-                        paramChild->SaveNodeYaml(childNode, full);
+                        Unknown::SaveChildYaml(paramChild, childNode, full, flow);
                         saved = true;
                     }
                 }
                 if (!saved)
-                    this->ChildBeg(it->second)->SaveNodeYaml(childNode, full);
+                    Unknown::SaveChildYaml(this->ChildBeg(it->second), childNode, full, flow);
             }
         }
     };
@@ -59,7 +59,7 @@ namespace Cpl
                         return false;
 
                     int count = 0;
-                    Cpl::ToVal(countNode->Value(), count);
+                    countNode->Get(count);
                     if (count != itemCount)
                         return false;
                 }
@@ -86,17 +86,16 @@ namespace Cpl
 
         void SaveNodeXml(Xml::XmlDocument<char>& xmlDoc, Xml::XmlNode<char>* xmlParent, bool full) const override
         {
-            Xml::XmlNode<char>* xmlCurrent = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString(this->Name().c_str()));
+            Xml::XmlNode<char>* xmlCurrent = xmlDoc.CreateNode(Xml::NodeElement, this->Name().c_str());
             
-            Xml::XmlNode<char>* xmlCount = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString(CountName().c_str()));
-            xmlCount->Value(xmlDoc.AllocateString(Cpl::ToStr(Cpl::ParamVector<T>::Size()).c_str()));
+            Xml::XmlNode<char>* xmlCount = xmlDoc.CreateNode(Xml::NodeElement, CountName().c_str(), Cpl::ToStr(Cpl::ParamVector<T>::Size()).c_str());
             xmlCurrent->AppendNode(xmlCount);
 
             for (size_t i = 0; i < Cpl::ParamVector<T>::Size(); ++i)
             {
                 const Unknown* paramChild = Cpl::ParamVector<T>::ChildBeg(i);
                 const Unknown* paramChildEnd = Cpl::ParamVector<T>::ChildBeg(i + 1);
-                Xml::XmlNode<char>* xmlItem = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString(Cpl::ParamVector<T>::ItemName().c_str()));
+                Xml::XmlNode<char>* xmlItem = xmlDoc.CreateNode(Xml::NodeElement, Cpl::ParamVector<T>::ItemName().c_str());
                 for (; paramChild < paramChildEnd; paramChild = paramChild->End())
                 {
                     if (full || paramChild->Changed())
@@ -140,7 +139,7 @@ namespace Cpl
                         return false;
 
                     int count = 0;
-                    Cpl::ToVal(countNode->Value(), count);
+                    countNode->Get(count);
                     if (count != itemCount)
                         return false;
                 }
@@ -154,7 +153,7 @@ namespace Cpl
                     if (xmlKey)
                     {
                         K key;
-                        Cpl::ToVal(xmlKey->Value(), key);
+                        xmlKey->Get(key);
                         T& value = this->_value[key];
                         Xml::XmlNode<char>* xmlValue = xmlItem->FirstNode(Cpl::ParamMap<K, T>::ValueName().c_str());
                         if (xmlValue)
@@ -176,20 +175,18 @@ namespace Cpl
 
         void SaveNodeXml(Xml::XmlDocument<char>& xmlDoc, Xml::XmlNode<char>* xmlParent, bool full) const override
         {
-            Xml::XmlNode<char>* xmlCurrent = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString(this->Name().c_str()));
-            Xml::XmlNode<char>* xmlCount = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString(CountName().c_str()));
-            xmlCount->Value(xmlDoc.AllocateString(Cpl::ToStr(this->_value.size()).c_str()));
+            Xml::XmlNode<char>* xmlCurrent = xmlDoc.CreateNode(Xml::NodeElement, this->Name().c_str());
+            Xml::XmlNode<char>* xmlCount = xmlDoc.CreateNode(Xml::NodeElement, CountName().c_str(), Cpl::ToStr(this->_value.size()).c_str());
             xmlCurrent->AppendNode(xmlCount);
             
             for (typename Cpl::ParamMap<K, T>::Map::const_iterator it = this->_value.begin(); it != this->_value.end(); ++it)
             {
-                Xml::XmlNode<char>* xmlItem = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString(Cpl::ParamMap<K, T>::ItemName().c_str()));
+                Xml::XmlNode<char>* xmlItem = xmlDoc.CreateNode(Xml::NodeElement, Cpl::ParamMap<K, T>::ItemName().c_str());
 
-                Xml::XmlNode<char>* xmlKey = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString(Cpl::ParamMap<K, T>::KeyName().c_str()));
-                xmlKey->Value(xmlDoc.AllocateString(Cpl::ToStr(it->first).c_str()));
+                Xml::XmlNode<char>* xmlKey = xmlDoc.CreateNode(Xml::NodeElement, Cpl::ParamMap<K, T>::KeyName().c_str(), Cpl::ToStr(it->first).c_str());
                 xmlItem->AppendNode(xmlKey);
 
-                Xml::XmlNode<char>* xmlValue = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString(Cpl::ParamMap<K, T>::ValueName().c_str()));
+                Xml::XmlNode<char>* xmlValue = xmlDoc.CreateNode(Xml::NodeElement, Cpl::ParamMap<K, T>::ValueName().c_str());
                 const Unknown* paramChild = this->ChildBeg(it->second);
                 const Unknown* paramChildEnd = this->ChildEnd(it->second);
                 for (; paramChild < paramChildEnd; paramChild = paramChild->End())
@@ -98,6 +98,7 @@ namespace Cpl
         String	_name;
         int64_t _start, _current, _total, _min, _max;
         int64_t _count, _flop;
+        int64_t _memory, _memoryMax, _memoryCount;
         bool _entered, _paused;
 
     public:
@@ -110,6 +111,9 @@ namespace Cpl
             , _total(0)
             , _min(std::numeric_limits<int64_t>::max())
             , _max(std::numeric_limits<int64_t>::min())
+            , _memory(0)
+            , _memoryMax(0)
+            , _memoryCount(0)
             , _entered(false)
             , _paused(false)
         {
@@ -124,6 +128,9 @@ namespace Cpl
             , _total(pm._total)
             , _min(pm._min)
             , _max(pm._max)
+            , _memory(pm._memory)
+            , _memoryMax(pm._memoryMax)
+            , _memoryCount(pm._memoryCount)
             , _entered(pm._entered)
             , _paused(pm._paused)
         {
@@ -167,6 +174,21 @@ namespace Cpl
             _total += other._total;
             _min = std::min(_min, other._min);
             _max = std::max(_max, other._max);
+            _memory += other._memory;
+            _memoryMax = std::max(_memoryMax, other._memoryMax);
+            _memoryCount += other._memoryCount;
+        }
+
+        CPL_INLINE void Memory(int64_t bytes)
+        {
+            _memory += bytes;
+            _memoryMax = std::max(_memoryMax, bytes);
+            _memoryCount++;
+        }
+
+        CPL_INLINE size_t MemoryCount() const
+        {
+            return (size_t)_memoryCount;
         }
 
         CPL_INLINE double Average() const
@@ -211,6 +233,8 @@ namespace Cpl
             ss << " {min=" << Cpl::ToStr(Min(), 3) << "; max=" << Cpl::ToStr(Max(), 3) << "}";
             if (_flop)
                 ss << " " << Cpl::ToStr(GFlops(), 1) << " GFlops";
+            if (_memoryCount)
+                ss << " {memory: " << _memoryCount << " x " << Cpl::ToStr(double(_memory) / _memoryCount / 1024.0, 1) << " kB; max=" << Cpl::ToStr(double(_memoryMax) / 1024.0, 1) << " kB}";
             return ss.str();
         }
     };
@@ -321,7 +345,8 @@ namespace Cpl
         void Clear()
         {
             std::lock_guard<std::mutex> lock(_mutex);
-            _map.clear();
+            for (ThreadMap::iterator thread = _map.begin(); thread != _map.end(); ++thread)
+                thread->second.clear();
         }
 
         String Report() const
@@ -331,7 +356,7 @@ namespace Cpl
             for (FunctionMap::const_iterator function = merged.begin(); function != merged.end(); ++function)
             {
                 const PerformanceMeasurer& pm = *function->second;
-                if (pm.Count())
+                if (pm.Count() || pm.MemoryCount())
                     report << function->first << ": " << pm.ToStr() << std::endl;
             }
             return report.str();
@@ -373,6 +398,7 @@ namespace Cpl
 #define CPL_PERF_INIT(name, desc)  CPL_PERF_INITF(name, desc, 0);
 #define CPL_PERF_START(name) name.Enter(); 
 #define CPL_PERF_PAUSE(name) name.Leave(true);
+#define CPL_PERF_MEM(desc, bytes) Cpl::PerformanceStorage::Global().Get(CPL_FUNCTION, desc)->Memory((int64_t)(bytes));
 
 #else
 
@@ -387,5 +413,6 @@ namespace Cpl
 #define CPL_PERF_INIT(name, desc)
 #define CPL_PERF_START(name)
 #define CPL_PERF_PAUSE(name)
+#define CPL_PERF_MEM(desc, bytes)
 
 #endif
@@ -68,7 +68,7 @@ namespace Cpl
         {
             Xml::XmlNode<char>* xmlValue = xmlParent->FirstNode("value");
             if(xmlValue)
-                Cpl::ToVal(xmlValue->Value(), this->_value);
+                xmlValue->Get(this->_value);
             return true;
         }
 
@@ -79,24 +79,19 @@ namespace Cpl
 
         void SaveNodeXml(Xml::XmlDocument<char>& xmlDoc, Xml::XmlNode<char>* xmlParent, bool full) const override
         {
-            Xml::XmlNode<char>* xmlValue = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString("value"));
-            xmlValue->Value(xmlDoc.AllocateString(NotEmpty(Cpl::ToStr(this->_value))));
+            Xml::XmlNode<char>* xmlValue = xmlDoc.CreateNode(Xml::NodeElement, "value", NotEmpty(Cpl::ToStr(this->_value)));
             xmlParent->AppendNode(xmlValue);
 
-            Xml::XmlNode<char>* xmlDescr = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString("desc"));
-            xmlDescr->Value(xmlDoc.AllocateString(NotEmpty(this->Description())));
+            Xml::XmlNode<char>* xmlDescr = xmlDoc.CreateNode(Xml::NodeElement, "desc", NotEmpty(this->Description()));
             xmlParent->AppendNode(xmlDescr);
 
-            Xml::XmlNode<char>* xmlMin = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString("value_min"));
-            xmlMin->Value(xmlDoc.AllocateString(this->Limited() ? NotEmpty(Cpl::ToStr(this->Min())) : " "));
+            Xml::XmlNode<char>* xmlMin = xmlDoc.CreateNode(Xml::NodeElement, "value_min", this->Limited() ? NotEmpty(Cpl::ToStr(this->Min())) : " ");
             xmlParent->AppendNode(xmlMin);
 
-            Xml::XmlNode<char>* xmlMax = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString("value_max"));
-            xmlMax->Value(xmlDoc.AllocateString(this->Limited() ? NotEmpty(Cpl::ToStr(this->Max())) : " "));
+            Xml::XmlNode<char>* xmlMax = xmlDoc.CreateNode(Xml::NodeElement, "value_max", this->Limited() ? NotEmpty(Cpl::ToStr(this->Max())) : " ");
             xmlParent->AppendNode(xmlMax);
 
-            Xml::XmlNode<char>* xmlDefault = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString("value_default"));
-            xmlDefault->Value(xmlDoc.AllocateString(NotEmpty(Cpl::ToStr(this->Default()))));
+            Xml::XmlNode<char>* xmlDefault = xmlDoc.CreateNode(Xml::NodeElement, "value_default", NotEmpty(Cpl::ToStr(this->Default())));
             xmlParent->AppendNode(xmlDefault);
         }
 
@@ -179,10 +174,10 @@ namespace Cpl
 
         void SaveNodeXml(Xml::XmlDocument<char>& xmlDoc, Xml::XmlNode<char>* xmlParent, bool full) const override
         {
-            Xml::XmlNode<char>* xmlStorage = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString("storage"));
-            Xml::XmlNode<char>* xmlMap = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString("map"));
+            Xml::XmlNode<char>* xmlStorage = xmlDoc.CreateNode(Xml::NodeElement, "storage");
+            Xml::XmlNode<char>* xmlMap = xmlDoc.CreateNode(Xml::NodeElement, "map");
 
-            Xml::XmlNode<char>* xmlCount = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString("count"));
+            Xml::XmlNode<char>* xmlCount = xmlDoc.CreateNode(Xml::NodeElement, "count");
             if(full)
                 xmlCount->Value(xmlDoc.AllocateString(Cpl::ToStr(_map.size()).c_str()));
             else
@@ -199,13 +194,12 @@ namespace Cpl
             {
                 if (it->second->Changed() || full)
                 {
-                    Xml::XmlNode<char>* xmlItem = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString("item"));
+                    Xml::XmlNode<char>* xmlItem = xmlDoc.CreateNode(Xml::NodeElement, "item");
 
-                    Xml::XmlNode<char>* xmlFirst = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString("first"));
-                    xmlFirst->Value(xmlDoc.AllocateString(it->first.c_str()));
+                    Xml::XmlNode<char>* xmlFirst = xmlDoc.CreateNode(Xml::NodeElement, "first", it->first.c_str());
                     xmlItem->AppendNode(xmlFirst);
 
-                    Xml::XmlNode<char>* xmlSecond = xmlDoc.AllocateNode(Xml::NodeElement, xmlDoc.AllocateString("second"));
+                    Xml::XmlNode<char>* xmlSecond = xmlDoc.CreateNode(Xml::NodeElement, "second");
                     it->second->SaveNodeXml(xmlDoc, xmlSecond, true);
                     xmlItem->AppendNode(xmlSecond);
 
@@ -31,6 +31,15 @@
 #include <array>
 #include <memory>
 #include <cstddef>
+#include <cstdlib>
+#include <clocale>
+#include <type_traits>
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
 
 namespace Cpl
 {
@@ -147,6 +156,194 @@ namespace Cpl
 
     //-----------------------------------------------------------------------------------
 
+    namespace Detail
+    {
+        CPL_INLINE bool IsSpace(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+        }
+
+        CPL_INLINE bool EqualNoCase(const char* beg, const char* end, const char* token)
+        {
+            for (; beg < end; ++beg, ++token)
+            {
+                if (*token == 0 || ::tolower((unsigned char)*beg) != *token)
+                    return false;
+            }
+            return *token == 0;
+        }
+
+        template<class T> CPL_INLINE bool ParseInteger(const char* beg, const char* end, T& value)
+        {
+            typedef typename std::make_unsigned<T>::type U;
+            while (beg < end && IsSpace(*beg))
+                ++beg;
+            bool negative = false;
+            if (beg < end && (*beg == '-' || *beg == '+'))
+                negative = *beg++ == '-';
+            if (negative && !std::is_signed<T>::value)
+                return false;
+            const U limit = negative && std::is_signed<T>::value ? U(std::numeric_limits<T>::max()) + 1 : U(std::numeric_limits<T>::max());
+            const char* digits = beg;
+            U result = 0;
+            for (; beg < end && *beg >= '0' && *beg <= '9'; ++beg)
+            {
+                U digit = U(*beg - '0');
+                if (result > (limit - digit) / 10)
+                    return false;
+                result = U(result * 10 + digit);
+            }
+            if (beg == digits)
+                return false;
+            value = T(negative ? U(U(0) - result) : result);
+            return true;
+        }
+
+        template<class T> CPL_INLINE bool ParseFloat(const char* beg, const char* end, T& value)
+        {
+            while (beg < end && IsSpace(*beg))
+                ++beg;
+            if (beg < end && *beg == '+')
+                ++beg;
+#if defined(__cpp_lib_to_chars)
+            std::from_chars_result result = std::from_chars(beg, end, value);
+            return result.ec == std::errc();
+#else
+            // The item is copied to the stack for strtod which depends on the decimal point of the global locale:
+            // it is replaced to parse as the C locale does. Longer items than the buffer are not converted.
+            char buffer[128];
+            const char point = *::localeconv()->decimal_point;
+            size_t size = 0;
+            for (; beg < end && !IsSpace(*beg) && (*beg != point || point == '.'); ++beg)
+            {
+                if (size == sizeof(buffer) - 1)
+                    return false;
+                buffer[size++] = *beg == '.' ? point : *beg;
+            }
+            buffer[size] = 0;
+            char* last = buffer;
+            const double result = ::strtod(buffer, &last);
+            if (last == buffer)
+                return false;
+            value = T(result);
+            return true;
+#endif
+        }
+
+        CPL_INLINE bool ParseBool(const char* beg, const char* end, bool& value)
+        {
+            while (beg < end && IsSpace(*beg))
+                ++beg;
+            while (beg < end && IsSpace(end[-1]))
+                --end;
+            if (EqualNoCase(beg, end, "0") || EqualNoCase(beg, end, "false") || EqualNoCase(beg, end, "no") || EqualNoCase(beg, end, "off"))
+                value = false;
+            else if (EqualNoCase(beg, end, "1") || EqualNoCase(beg, end, "true") || EqualNoCase(beg, end, "yes") || EqualNoCase(beg, end, "on"))
+                value = true;
+            else
+                return false;
+            return true;
+        }
+
+        template<class T, class Enable = void> struct ValueParser
+        {
+            static CPL_INLINE bool Parse(const char* beg, const char* end, T& value)
+            {
+                ToVal(String(beg, end), value);
+                return true;
+            }
+        };
+
+        template<class T> struct ValueParser<T, typename std::enable_if<std::is_integral<T>::value && (sizeof(T) > 1) && !std::is_same<T, bool>::value>::type>
+        {
+            static CPL_INLINE bool Parse(const char* beg, const char* end, T& value)
+            {
+                return ParseInteger(beg, end, value);
+            }
+        };
+
+        template<class T> struct ValueParser<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+        {
+            static CPL_INLINE bool Parse(const char* beg, const char* end, T& value)
+            {
+                return ParseFloat(beg, end, value);
+            }
+        };
+
+        template<> struct ValueParser<bool>
+        {
+            static CPL_INLINE bool Parse(const char* beg, const char* end, bool& value)
+            {
+                return ParseBool(beg, end, value);
+            }
+        };
+
+        template<> struct ValueParser<String>
+        {
+            static CPL_INLINE bool Parse(const char* beg, const char* end, String& value)
+            {
+                if (beg < end)
+                    value.assign(beg, end);
+                return true;
+            }
+        };
+
+        CPL_INLINE const char* NextItem(const char*& beg, const char* end)
+        {
+            while (beg < end && IsSpace(*beg))
+                ++beg;
+            const char* item = beg;
+            while (beg < end && !IsSpace(*beg))
+                ++beg;
+            return item;
+        }
+    }
+
+    /*!
+    * Converts string given by pointer and size to value without creation of temporary strings (for arithmetic types and bool).
+    * Leading spaces are skipped, conversion stops at first unsuitable character (as std::stringstream does).
+    * Returns false (value is not changed) if the string can't be converted.
+    */
+    template<class T> CPL_INLINE bool ToVal(const char* str, size_t size, T& value)
+    {
+        return Detail::ValueParser<T>::Parse(str, str + size, value);
+    }
+
+    template<class T> CPL_INLINE bool ToVal(const char* str, size_t size, std::vector<T>& values)
+    {
+        std::vector<T> parsed;
+        for (const char* beg = str, *end = str + size; beg < end;)
+        {
+            const char* item = Detail::NextItem(beg, end);
+            if (item == beg)
+                break;
+            T value = T();
+            if (!Detail::ValueParser<T>::Parse(item, beg, value))
+                return false;
+            parsed.push_back(value);
+        }
+        values.swap(parsed);
+        return true;
+    }
+
+    /*!
+    * Converts space separated items of the string to the array of values. Returns number of converted items.
+    */
+    template<class T> CPL_INLINE size_t ToVals(const char* str, size_t size, T* values, size_t capacity)
+    {
+        size_t count = 0;
+        for (const char* beg = str, *end = str + size; beg < end && count < capacity;)
+        {
+            const char* item = Detail::NextItem(beg, end);
+            if (item == beg || !Detail::ValueParser<T>::Parse(item, beg, values[count]))
+                break;
+            count++;
+        }
+        return count;
+    }
+
+    //-----------------------------------------------------------------------------------
+
     CPL_INLINE String ToLowerCase(const String& src)
     {
         String dst(src);
@@ -27,13 +27,20 @@
 #pragma once
 
 #include "Cpl/Defs.h"
+#include "Cpl/String.h"
 
 #include <cstdlib>
+#include <cstring>
 #include <cassert>
 #include <iterator>
 #include <new>
 #include <exception>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPL_XML_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace Cpl
 {
     namespace Xml
@@ -56,6 +63,11 @@ namespace Cpl
                 return _what;
             }
 
+            virtual const char * what() const throw()
+            {
+                return _what;
+            }
+
             template<class Ch> Ch * Where() const
             {
                 return (Ch*)_where;
@@ -82,6 +94,46 @@ namespace Cpl
             NodePi
         };
 
+        /*!
+        * \brief Limits of document size. Zero value means that there is no limit.
+        */
+        struct Limits
+        {
+            size_t bytes; //!< total size of memory allocated from the pool.
+            size_t nodes; //!< number of allocated nodes.
+            size_t depth; //!< nesting depth of elements during parsing.
+
+            Limits(size_t bytes_ = 0, size_t nodes_ = 0, size_t depth_ = 0)
+                : bytes(bytes_)
+                , nodes(nodes_)
+                , depth(depth_)
+            {
+            }
+        };
+
+        /*!
+        * \brief Memory usage counters of the document.
+        */
+        struct Statistics
+        {
+            size_t bytes; //!< total size of memory allocated from the pool.
+            size_t reserved; //!< size of dynamic memory blocks requested by the pool.
+            size_t blocks; //!< number of dynamic memory blocks.
+            size_t nodes; //!< number of allocated nodes.
+            size_t attributes; //!< number of allocated attributes.
+            size_t depth; //!< maximal nesting depth of parsed elements.
+
+            Statistics()
+                : bytes(0)
+                , reserved(0)
+                , blocks(0)
+                , nodes(0)
+                , attributes(0)
+                , depth(0)
+            {
+            }
+        };
+
         const int ParseNoDataNodes = 0x1;
         const int ParseNoElementValues = 0x2;
         const int ParseNoStringTerminators = 0x4;
@@ -157,6 +209,161 @@ namespace Cpl
                 }
                 return true;
             }
+
+            struct TreeSize
+            {
+                size_t nodes, attributes, chars;
+
+                TreeSize()
+                    : nodes(0)
+                    , attributes(0)
+                    , chars(0)
+                {
+                }
+            };
+
+            /// Number of characters which are copied for a string: empty strings are not copied.
+            inline size_t StringChars(size_t size)
+            {
+                return size ? size + 1 : 0;
+            }
+
+            template<class Ch> inline void MeasureTree(const XmlNode<Ch> * root, TreeSize & size)
+            {
+                const XmlNode<Ch> *node = root;
+                while (1)
+                {
+                    size.nodes += 1;
+                    size.chars += StringChars(node->NameSize()) + StringChars(node->ValueSize());
+                    for (XmlAttribute<Ch> *attr = node->FirstAttribute(); attr; attr = attr->NextAttribute())
+                    {
+                        size.attributes += 1;
+                        size.chars += StringChars(attr->NameSize()) + StringChars(attr->ValueSize());
+                    }
+                    if (node->FirstNode())
+                    {
+                        node = node->FirstNode();
+                        continue;
+                    }
+                    while (node != root && !node->NextSibling())
+                        node = node->Parent();
+                    if (node == root)
+                        return;
+                    node = node->NextSibling();
+                }
+            }
+
+            inline char * PutUtf8(char * dst, unsigned long code)
+            {
+                if (code < 0x80)
+                    *dst++ = char(code);
+                else if (code < 0x800)
+                {
+                    *dst++ = char(0xC0 | (code >> 6));
+                    *dst++ = char(0x80 | (code & 0x3F));
+                }
+                else if (code < 0x10000)
+                {
+                    *dst++ = char(0xE0 | (code >> 12));
+                    *dst++ = char(0x80 | ((code >> 6) & 0x3F));
+                    *dst++ = char(0x80 | (code & 0x3F));
+                }
+                else
+                {
+                    *dst++ = char(0xF0 | (code >> 18));
+                    *dst++ = char(0x80 | ((code >> 12) & 0x3F));
+                    *dst++ = char(0x80 | ((code >> 6) & 0x3F));
+                    *dst++ = char(0x80 | (code & 0x3F));
+                }
+                return dst;
+            }
+
+            /*!
+            * Converts UTF-16 text to UTF-8. Output buffer must have at least 3 * size bytes.
+            * Blocks of ASCII characters are converted with SSE2 (if it is available).
+            * Unpaired surrogates are replaced by U+FFFD. Returns size of the output.
+            */
+            inline size_t Utf16ToUtf8(const char16_t * src, size_t size, bool swap, char * dst)
+            {
+                char * start = dst;
+                size_t i = 0;
+#if defined(CPL_XML_SSE2)
+                const __m128i ascii = _mm_set1_epi16(swap ? short(0x80FF) : short(0xFF80));
+                const __m128i zero = _mm_setzero_si128();
+#endif
+                while (i < size)
+                {
+#if defined(CPL_XML_SSE2)
+                    if (i + 8 <= size)
+                    {
+                        __m128i value = _mm_loadu_si128((const __m128i*)(src + i));
+                        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(value, ascii), zero)) == 0xFFFF)
+                        {
+                            if (swap)
+                                value = _mm_srli_epi16(value, 8);
+                            _mm_storel_epi64((__m128i*)dst, _mm_packus_epi16(value, value));
+                            dst += 8;
+                            i += 8;
+                            continue;
+                        }
+                    }
+#endif
+                    unsigned long code = swap ? ((src[i] >> 8) | ((src[i] & 0xFF) << 8)) : src[i];
+                    i++;
+                    if (code >= 0xD800 && code < 0xE000)
+                    {
+                        unsigned long low = i < size ? (swap ? ((src[i] >> 8) | ((src[i] & 0xFF) << 8)) : src[i]) : 0;
+                        if (code < 0xDC00 && low >= 0xDC00 && low < 0xE000)
+                        {
+                            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                            i++;
+                        }
+                        else
+                            code = 0xFFFD;
+                    }
+                    dst = PutUtf8(dst, code);
+                }
+                return dst - start;
+            }
+
+            /*!
+            * Converts UTF-32 text to UTF-8. Output buffer must have at least 4 * size bytes.
+            * Blocks of ASCII characters are converted with SSE2 (if it is available).
+            * Surrogates and values out of Unicode range are replaced by U+FFFD. Returns size of the output.
+            */
+            template<class Unit> inline size_t Utf32ToUtf8(const Unit * src, size_t size, char * dst)
+            {
+                static_assert(sizeof(Unit) == 4, "UTF-32 code units must have 4 bytes!");
+                char * start = dst;
+                size_t i = 0;
+#if defined(CPL_XML_SSE2)
+                const __m128i ascii = _mm_set1_epi32(int(0xFFFFFF80));
+                const __m128i zero = _mm_setzero_si128();
+#endif
+                while (i < size)
+                {
+#if defined(CPL_XML_SSE2)
+                    if (i + 8 <= size)
+                    {
+                        __m128i lo = _mm_loadu_si128((const __m128i*)(src + i));
+                        __m128i hi = _mm_loadu_si128((const __m128i*)(src + i + 4));
+                        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(_mm_or_si128(lo, hi), ascii), zero)) == 0xFFFF)
+                        {
+                            __m128i value = _mm_packs_epi32(lo, hi);
+                            _mm_storel_epi64((__m128i*)dst, _mm_packus_epi16(value, value));
+                            dst += 8;
+                            i += 8;
+                            continue;
+                        }
+                    }
+#endif
+                    unsigned long code = (unsigned long)(uint32_t)src[i++];
+                    if ((code >= 0xD800 && code < 0xE000) || code > 0x10FFFF)
+                        code = 0xFFFD;
+                    dst = PutUtf8(dst, code);
+                }
+                return dst - start;
+            }
         }
 
         template<class Ch = char> class MemoryPool
@@ -166,7 +373,8 @@ namespace Cpl
             typedef void (free_func)(void *); 
 
             MemoryPool()
-                : _allocFunc(0)
+                : _parsing(false)
+                , _allocFunc(0)
                 , _freeFunc(0)
             {
                 Init();
@@ -181,6 +389,7 @@ namespace Cpl
                 size_t nameSize = 0, size_t valueSize = 0)
             {
                 void * memory = AllocateAligned(sizeof(XmlNode<Ch>));
+                CountNodes(1);
                 XmlNode<Ch> *node = new(memory) XmlNode<Ch>(type);
                 if (name)
                 {
@@ -203,6 +412,7 @@ namespace Cpl
                 size_t nameSize = 0, size_t valueSize = 0)
             {
                 void * memory = AllocateAligned(sizeof(XmlAttribute<Ch>));
+                _stat.attributes += 1;
                 XmlAttribute<Ch> *attribute = new(memory) XmlAttribute<Ch>;
                 if (name)
                 {
@@ -254,23 +464,87 @@ namespace Cpl
                 return result;
             }
 
+            /*!
+            * \fn XmlNode<Ch> * CreateNode(NodeType type, const Ch *name, const Ch *value = 0, size_t nameSize = 0, size_t valueSize = 0)
+            *
+            * \brief Allocates node together with copies of its name and value in one pool block.
+            *
+            * @param [in] type - type of the node.
+            * @param [in] name - name of the node (it is copied).
+            * @param [in] value - value of the node (it is copied if not null).
+            * @param [in] nameSize - length of the name (0 means that the name is null terminated).
+            * @param [in] valueSize - length of the value (0 means that the value is null terminated).
+            */
+            XmlNode<Ch> * CreateNode(NodeType type, const Ch *name, const Ch *value = 0, size_t nameSize = 0, size_t valueSize = 0)
+            {
+                assert(name);
+                if (nameSize == 0)
+                    nameSize = Internal::Measure(name);
+                if (value && valueSize == 0)
+                    valueSize = Internal::Measure(value);
+                size_t chars = nameSize + 1 + (value ? valueSize + 1 : 0);
+                char * memory = static_cast<char*>(AllocateAligned(sizeof(XmlNode<Ch>) + chars * sizeof(Ch)));
+                CountNodes(1);
+                XmlNode<Ch> *node = new(memory) XmlNode<Ch>(type);
+                Ch * dst = reinterpret_cast<Ch*>(memory + sizeof(XmlNode<Ch>));
+                node->Name(CopyString(dst, name, nameSize), nameSize);
+                if (value)
+                    node->Value(CopyString(dst, value, valueSize), valueSize);
+                return node;
+            }
+
+            /*!
+            * \fn XmlNode<Ch> * AllocateNodes(NodeType type, size_t count)
+            *
+            * \brief Allocates contiguous array of nodes of given type. Use XmlNode::AppendNodes to attach all of them at once.
+            *
+            * @param [in] type - type of the nodes.
+            * @param [in] count - number of the nodes.
+            */
+            XmlNode<Ch> * AllocateNodes(NodeType type, size_t count)
+            {
+                XmlNode<Ch> * nodes = static_cast<XmlNode<Ch>*>(AllocateAligned(count * sizeof(XmlNode<Ch>)));
+                CountNodes(count);
+                for (size_t i = 0; i < count; ++i)
+                    new(nodes + i) XmlNode<Ch>(type);
+                return nodes;
+            }
+
+            /*!
+            * \fn XmlAttribute<Ch> * AllocateAttributes(size_t count)
+            *
+            * \brief Allocates contiguous array of empty attributes.
+            *
+            * @param [in] count - number of the attributes.
+            */
+            XmlAttribute<Ch> * AllocateAttributes(size_t count)
+            {
+                XmlAttribute<Ch> * attributes = static_cast<XmlAttribute<Ch>*>(AllocateAligned(count * sizeof(XmlAttribute<Ch>)));
+                _stat.attributes += count;
+                for (size_t i = 0; i < count; ++i)
+                    new(attributes + i) XmlAttribute<Ch>;
+                return attributes;
+            }
+
+            /*!
+            * \fn XmlNode<Ch> * CloneNode(const XmlNode<Ch> *source, XmlNode<Ch> *result = 0)
+            *
+            * \brief Clones subtree. Names and values of the clone point to the strings of the source.
+            */
             XmlNode<Ch> * CloneNode(const XmlNode<Ch> *source, XmlNode<Ch> *result = 0)
             {
-                if (result)
-                {
-                    result->RemoveAllAttributes();
-                    result->RemoveAllNodes();
-                    result->Type(source->Type());
-                }
-                else
-                    result = AllocateNode(source->Type());
-                result->Name(source->Name(), source->NameSize());
-                result->Value(source->Value(), source->ValueSize());
-                for (XmlNode<Ch> *child = source->FirstNode(); child; child = child->NextSibling())
-                    result->AppendNode(CloneNode(child));
-                for (XmlAttribute<Ch> *attr = source->FirstAttribute(); attr; attr = attr->NextAttribute())
-                    result->AppendAttribute(AllocateAttribute(attr->Name(), attr->Value(), attr->NameSize(), attr->ValueSize()));
-                return result;
+                return CloneTree(source, result, false);
+            }
+
+            /*!
+            * \fn XmlNode<Ch> * CopyNode(const XmlNode<Ch> *source, XmlNode<Ch> *result = 0)
+            *
+            * \brief Clones subtree with copying of all names and values into this pool.
+            *        The subtree is measured first, so nodes, attributes and strings are allocated by three contiguous blocks.
+            */
+            XmlNode<Ch> * CopyNode(const XmlNode<Ch> *source, XmlNode<Ch> *result = 0)
+            {
+                return CloneTree(source, result, true);
             }
 
             void Clear()
@@ -287,6 +561,32 @@ namespace Cpl
                 Init();
             }
 
+            /*!
+            * \fn void SetLimits(const Limits & limits)
+            *
+            * \brief Sets limits of the parsing. Exceeding of the limits during parsing causes ParseError exception.
+            *        Nodes and memory which are allocated outside of parsing are counted but not limited.
+            */
+            void SetLimits(const Limits & limits)
+            {
+                _limits = limits;
+            }
+
+            const Limits & GetLimits() const
+            {
+                return _limits;
+            }
+
+            /*!
+            * \fn const Statistics & GetStatistics() const
+            *
+            * \brief Gets memory usage counters (they are reset by Clear()).
+            */
+            const Statistics & GetStatistics() const
+            {
+                return _stat;
+            }
+
             void SetAllocator(alloc_func *af, free_func *ff)
             {
                 assert(_begin == _staticMemory && _ptr == Align(_begin));    // Verify that no memory is allocated yet
@@ -294,14 +594,141 @@ namespace Cpl
                 _freeFunc = ff;
             }
 
+        protected:
+            Limits _limits;
+            Statistics _stat;
+            bool _parsing;
+
+            /// Enables checking of the limits while it exists.
+            struct ParsingScope
+            {
+                ParsingScope(MemoryPool & pool)
+                    : _pool(pool)
+                    , _outer(pool._parsing)
+                {
+                    pool._parsing = true;
+                }
+
+                ~ParsingScope()
+                {
+                    _pool._parsing = _outer;
+                }
+
+            private:
+                MemoryPool & _pool;
+                bool _outer;
+            };
+
         private:
             struct Header
             {
                 char * prevBegin;
             };
 
+            struct Cursor
+            {
+                XmlNode<Ch> * node;
+                XmlAttribute<Ch> * attribute;
+                Ch * chars;
+            };
+
+            static Ch * CopyString(Ch *& dst, const Ch * src, size_t size)
+            {
+                Ch * result = dst;
+                for (size_t i = 0; i < size; ++i)
+                    dst[i] = src[i];
+                dst[size] = 0;
+                dst += size + 1;
+                return result;
+            }
+
+            void * AllocateArray(size_t size)
+            {
+                return size ? AllocateAligned(size) : 0;
+            }
+
+            XmlNode<Ch> * CloneTree(const XmlNode<Ch> *source, XmlNode<Ch> *result, bool copy)
+            {
+                Internal::TreeSize size;
+                Internal::MeasureTree(source, size);
+                if (result)
+                {
+                    result->RemoveAllAttributes();
+                    result->RemoveAllNodes();
+                    result->Type(source->Type());
+                    size.nodes -= 1;
+                }
+                Cursor cursor;
+                cursor.node = static_cast<XmlNode<Ch>*>(AllocateArray(size.nodes * sizeof(XmlNode<Ch>)));
+                cursor.attribute = static_cast<XmlAttribute<Ch>*>(AllocateArray(size.attributes * sizeof(XmlAttribute<Ch>)));
+                cursor.chars = copy ? static_cast<Ch*>(AllocateArray(size.chars * sizeof(Ch))) : 0;
+                CountNodes(size.nodes);
+                _stat.attributes += size.attributes;
+                if (!result)
+                    result = new(cursor.node++) XmlNode<Ch>(source->Type());
+
+                const XmlNode<Ch> *node = source;
+                XmlNode<Ch> *clone = result;
+                while (1)
+                {
+                    CloneContent(node, clone, copy, cursor);
+                    if (node->FirstNode())
+                    {
+                        node = node->FirstNode();
+                        XmlNode<Ch> *child = new(cursor.node++) XmlNode<Ch>(node->Type());
+                        clone->AppendNode(child);
+                        clone = child;
+                        continue;
+                    }
+                    while (node != source && !node->NextSibling())
+                    {
+                        node = node->Parent();
+                        clone = clone->Parent();
+                    }
+                    if (node == source)
+                        return result;
+                    node = node->NextSibling();
+                    XmlNode<Ch> *sibling = new(cursor.node++) XmlNode<Ch>(node->Type());
+                    clone->Parent()->AppendNode(sibling);
+                    clone = sibling;
+                }
+            }
+
+            template<class Base> static void CloneStrings(const Base *source, Base *result, bool copy, Cursor & cursor)
+            {
+                if (copy)
+                {
+                    result->Name(source->NameSize() ? CopyString(cursor.chars, source->Name(), source->NameSize()) : 0, source->NameSize());
+                    result->Value(source->ValueSize() ? CopyString(cursor.chars, source->Value(), source->ValueSize()) : 0, source->ValueSize());
+                }
+                else
+                {
+                    result->Name(source->Name(), source->NameSize());
+                    result->Value(source->Value(), source->ValueSize());
+                }
+            }
+
+            void CloneContent(const XmlNode<Ch> *source, XmlNode<Ch> *result, bool copy, Cursor & cursor)
+            {
+                CloneStrings(source, result, copy, cursor);
+                for (XmlAttribute<Ch> *attr = source->FirstAttribute(); attr; attr = attr->NextAttribute())
+                {
+                    XmlAttribute<Ch> * clone = new(cursor.attribute++) XmlAttribute<Ch>;
+                    CloneStrings(attr, clone, copy, cursor);
+                    result->AppendAttribute(clone);
+                }
+            }
+
+            void CountNodes(size_t count)
+            {
+                if (_parsing && _limits.nodes && _stat.nodes + count > _limits.nodes)
+                    throw ParseError("node count limit exceeded", 0);
+                _stat.nodes += count;
+            }
+
             void Init()
             {
+                _stat = Statistics();
                 _begin = _staticMemory;
                 _ptr = Align(_begin);
                 _end = _staticMemory + sizeof(_staticMemory);
@@ -330,6 +757,9 @@ namespace Cpl
 
             void * AllocateAligned(size_t size)
             {
+                if (_parsing && _limits.bytes && _stat.bytes + size > _limits.bytes)
+                    throw ParseError("memory limit exceeded", 0);
+                _stat.bytes += size;
                 char * result = Align(_ptr);
                 if (result + size > _end)
                 {
@@ -339,6 +769,8 @@ namespace Cpl
 
                     size_t allocSize = sizeof(Header) + (2 * ALIGNMENT - 2) + pool_size;
                     char * rawMemory = AllocateRaw(allocSize);
+                    _stat.reserved += allocSize;
+                    _stat.blocks += 1;
 
                     char *pool = Align(rawMemory);
                     Header *newHeader = reinterpret_cast<Header *>(pool);
@@ -413,6 +845,40 @@ namespace Cpl
                 this->Value(value, Internal::Measure(value));
             }
 
+            /*!
+            * \fn template<class T> T As(const T & defaultValue = T()) const
+            *
+            * \brief Converts value to given type. Arithmetic types and bool are parsed directly from the value string.
+            *
+            * @param [in] defaultValue - it is returned if the value can't be converted.
+            */
+            template<class T> T As(const T & defaultValue = T()) const
+            {
+                T value = defaultValue;
+                Cpl::ToVal(Value(), ValueSize(), value);
+                return value;
+            }
+
+            /*!
+            * \fn template<class T> bool Get(T & value) const
+            *
+            * \brief Converts value to given type. Returns false (and does not change the output) if the value can't be converted.
+            */
+            template<class T> bool Get(T & value) const
+            {
+                return Cpl::ToVal(Value(), ValueSize(), value);
+            }
+
+            /*!
+            * \fn template<class T> size_t Get(T * values, size_t size) const
+            *
+            * \brief Converts space separated numbers of the value to given array. Returns number of converted numbers.
+            */
+            template<class T> size_t Get(T * values, size_t size) const
+            {
+                return Cpl::ToVals(Value(), ValueSize(), values, size);
+            }
+
             XmlNode<Ch> * Parent() const
             {
                 return _parent;
@@ -495,10 +961,10 @@ namespace Cpl
                 : _type(type)
                 , _firstNode(0)
                 , _lastNode(0)
+                , _firstAttribute(0)
+                , _lastAttribute(0)
                 , _prevSibling(0)
                 , _nextSibling(0)
-                , _lastAttribute(0)
-                , _firstAttribute(0)
             {
             }
 
@@ -649,6 +1115,28 @@ namespace Cpl
                 child->_nextSibling = 0;
             }
 
+            void AppendNodes(XmlNode<Ch> *children, size_t count)
+            {
+                if (count == 0)
+                    return;
+                for (size_t i = 0; i < count; ++i)
+                {
+                    XmlNode<Ch> *child = children + i;
+                    assert(!child->Parent() && child->Type() != NodeDocument);
+                    child->_parent = this;
+                    child->_prevSibling = i ? child - 1 : 0;
+                    child->_nextSibling = i + 1 < count ? child + 1 : 0;
+                }
+                if (FirstNode())
+                {
+                    children->_prevSibling = _lastNode;
+                    _lastNode->_nextSibling = children;
+                }
+                else
+                    _firstNode = children;
+                _lastNode = children + count - 1;
+            }
+
             void InsertNode(XmlNode<Ch> *where, XmlNode<Ch> *child)
             {
                 assert(!where || where->parent() == this);
@@ -838,15 +1326,59 @@ namespace Cpl
         public:
             XmlDocument()
                 : XmlNode<Ch>(NodeDocument)
+                , _depth(0)
             {
             }
 
+            /*!
+            * \fn template<int Flags> void ParseUtf16(const char16_t * text, size_t length)
+            *
+            * \brief Parses UTF-16 text (byte order is detected by BOM, native order is used without BOM).
+            *        The text is converted to UTF-8 into the memory pool, so the char specialized parser is used.
+            *
+            * @param [in] text - pointer to UTF-16 text (it is not changed and may be released after parsing).
+            * @param [in] length - length of the text in UTF-16 code units.
+            */
+            template<int Flags> void ParseUtf16(const char16_t * text, size_t length)
+            {
+                static_assert(sizeof(Ch) == 1, "UTF-16 input is converted to UTF-8 and requires XmlDocument<char>!");
+                typename MemoryPool<Ch>::ParsingScope parsing(*this);
+                bool swap = false;
+                if (length && (text[0] == 0xFEFF || text[0] == 0xFFFE))
+                {
+                    swap = text[0] == 0xFFFE;
+                    text++;
+                    length--;
+                }
+                Ch * utf8 = this->AllocateString(0, length * 3 + 1);
+                size_t size = Internal::Utf16ToUtf8(text, length, swap, reinterpret_cast<char*>(utf8));
+                utf8[size] = 0;
+                Parse<Flags>(utf8, size);
+            }
+
+            /*!
+            * \fn template<int Flags> void ParseWide(const wchar_t * text, size_t length)
+            *
+            * \brief Parses wide text: UTF-16 if wchar_t has 2 bytes (Windows), UTF-32 otherwise (a leading BOM is skipped).
+            *        The text is converted to UTF-8 into the memory pool, so the char specialized parser is used.
+            *
+            * @param [in] text - pointer to wide text (it is not changed and may be released after parsing).
+            * @param [in] length - length of the text in wchar_t units.
+            */
+            template<int Flags> void ParseWide(const wchar_t * text, size_t length)
+            {
+                static_assert(sizeof(Ch) == 1, "Wide input is converted to UTF-8 and requires XmlDocument<char>!");
+                ParseWide<Flags>(text, length, std::integral_constant<bool, sizeof(wchar_t) == sizeof(char16_t)>());
+            }
+
             template<int Flags> void Parse(Ch * text, size_t length)
             {
                 assert(text);
+                typename MemoryPool<Ch>::ParsingScope parsing(*this);
                 const Ch * startPos = text;
                 this->RemoveAllNodes();
                 this->RemoveAllAttributes();
+                _depth = 0;
                 ParseBom<Flags>(text);
                 while (length - size_t(text - startPos) && *text != 0)
                 {
@@ -854,8 +1386,13 @@ namespace Cpl
                     if (*text == Ch('<'))
                     {
                         ++text;
-                        if (XmlNode<Ch> *node = ParseNode<Flags>(text))
+                        bool open = false;
+                        if (XmlNode<Ch> *node = ParseNode<Flags>(text, open))
+                        {
                             this->AppendNode(node);
+                            if (open)
+                                ParseNodeContents<Flags>(text, node);
+                        }
                     }
                     else if (*text != 0)
                         throw ParseError("expected <", text);
@@ -870,6 +1407,28 @@ namespace Cpl
             }
 
         private:
+            size_t _depth;
+
+            /// wchar_t is UTF-16.
+            template<int Flags> void ParseWide(const wchar_t * text, size_t length, std::true_type)
+            {
+                ParseUtf16<Flags>(reinterpret_cast<const char16_t*>(text), length);
+            }
+
+            /// wchar_t is UTF-32.
+            template<int Flags> void ParseWide(const wchar_t * text, size_t length, std::false_type)
+            {
+                if (length && text[0] == wchar_t(0xFEFF))
+                {
+                    text++;
+                    length--;
+                }
+                typename MemoryPool<Ch>::ParsingScope parsing(*this);
+                Ch * utf8 = this->AllocateString(0, length * 4 + 1);
+                size_t size = Internal::Utf32ToUtf8(text, length, reinterpret_cast<char*>(utf8));
+                utf8[size] = 0;
+                Parse<Flags>(utf8, size);
+            }
 
             struct Whitespace
             {
@@ -1567,7 +2126,7 @@ namespace Cpl
                 return cdata;
             }
 
-            template<int Flags> XmlNode<Ch> * ParseElement(Ch *&text)
+            template<int Flags> XmlNode<Ch> * ParseElement(Ch *&text, bool & open)
             {
                 XmlNode<Ch> *element = this->AllocateNode(NodeElement);
                 Ch *name = text;
@@ -1580,7 +2139,12 @@ namespace Cpl
                 if (*text == Ch('>'))
                 {
                     ++text;
-                    ParseNodeContents<Flags>(text, element);
+                    if (++_depth > this->_limits.depth && this->_limits.depth)
+                        throw ParseError("nesting depth limit exceeded", text);
+                    if (_depth > this->_stat.depth)
+                        this->_stat.depth = _depth;
+                    open = true;
+                    return element;
                 }
                 else if (*text == Ch('/'))
                 {
@@ -1596,12 +2160,12 @@ namespace Cpl
                 return element;
             }
 
-            template<int Flags> XmlNode<Ch> * ParseNode(Ch *&text)
+            template<int Flags> XmlNode<Ch> * ParseNode(Ch *&text, bool & open)
             {
                 switch (text[0])
                 {
                 default:
-                    return ParseElement<Flags>(text);
+                    return ParseElement<Flags>(text, open);
                 case Ch('?'):
                     ++text;
                     if ((text[0] == Ch('x') || text[0] == Ch('X')) &&
@@ -1656,6 +2220,7 @@ namespace Cpl
 
             template<int Flags> void ParseNodeContents(Ch *&text, XmlNode<Ch> * node)
             {
+                XmlNode<Ch> * root = node;
                 while (1)
                 {
                     Ch *contents_start = text; 
@@ -1682,14 +2247,24 @@ namespace Cpl
                             Skip<Whitespace, Flags>(text);
                             if (*text != Ch('>'))
                                 throw ParseError("expected >", text);
-                            ++text;  
-                            return; 
+                            ++text;
+                            if (!(Flags & ParseNoStringTerminators))
+                                node->Name()[node->NameSize()] = Ch('\0');
+                            --_depth;
+                            if (node == root)
+                                return;
+                            node = node->Parent();
                         }
                         else
                         {
                             ++text;
-                            if (XmlNode<Ch> *child = ParseNode<Flags>(text))
+                            bool open = false;
+                            if (XmlNode<Ch> *child = ParseNode<Flags>(text, open))
+                            {
                                 node->AppendNode(child);
+                                if (open)
+                                    node = child;
+                            }
                         }
                         break;
                     case Ch('\0'):
@@ -1953,15 +2528,6 @@ namespace Cpl
                 return false;
             }
 
-            template<class OutIt, class Ch> inline OutIt PrintNode(OutIt out, const XmlNode<Ch> *node, int flags, int indent);
-
-            template<class OutIt, class Ch> inline OutIt PrintChildren(OutIt out, const XmlNode<Ch> *node, int flags, int indent)
-            {
-                for (XmlNode<Ch> *child = node->FirstNode(); child; child = child->NextSibling())
-                    out = PrintNode(out, child, flags, indent);
-                return out;
-            }
-
             template<class OutIt, class Ch> inline OutIt PrintAttributes(OutIt out, const XmlNode<Ch> *node, int flags)
             {
                 for (XmlAttribute<Ch> *attribute = node->FirstAttribute(); attribute; attribute = attribute->NextAttribute())
@@ -2018,7 +2584,16 @@ namespace Cpl
                 return out;
             }
 
-            template<class OutIt, class Ch> inline OutIt PrintElementNode(OutIt out, const XmlNode<Ch> *node, int flags, int indent)
+            template<class OutIt, class Ch> inline OutIt PrintElementEnd(OutIt out, const XmlNode<Ch> *node)
+            {
+                *out = Ch('<'), ++out;
+                *out = Ch('/'), ++out;
+                out = CopyChars(node->Name(), node->Name() + node->NameSize(), out);
+                *out = Ch('>'), ++out;
+                return out;
+            }
+
+            template<class OutIt, class Ch> inline OutIt PrintElementBegin(OutIt out, const XmlNode<Ch> *node, int flags, int indent, bool & children)
             {
                 assert(node->Type() == NodeElement);
                 if (!(flags & PrintNoIndenting))
@@ -2026,6 +2601,7 @@ namespace Cpl
                 *out = Ch('<'), ++out;
                 out = CopyChars(node->Name(), node->Name() + node->NameSize(), out);
                 out = PrintAttributes(out, node, flags);
+                children = false;
                 if (node->ValueSize() == 0 && !node->FirstNode())
                 {
                     *out = Ch('/'), ++out;
@@ -2047,14 +2623,10 @@ namespace Cpl
                     {
                         if (!(flags & PrintNoIndenting))
                             *out = Ch('\n'), ++out;
-                        out = PrintChildren(out, node, flags, indent + 1);
-                        if (!(flags & PrintNoIndenting))
-                            out = FillChars(out, indent, Ch('\t'));
+                        children = true;
+                        return out;
                     }
-                    *out = Ch('<'), ++out;
-                    *out = Ch('/'), ++out;
-                    out = CopyChars(node->Name(), node->Name() + node->NameSize(), out);
-                    *out = Ch('>'), ++out;
+                    out = PrintElementEnd(out, node);
                 }
                 return out;
             }
@@ -2125,41 +2697,70 @@ namespace Cpl
                 return out;
             }
 
-            template<class OutIt, class Ch> inline OutIt PrintNode(OutIt out, const XmlNode<Ch> *node, int flags, int indent)
-            {
-                switch (node->Type())
-                {
-                case NodeDocument:
-                    out = PrintChildren(out, node, flags, indent);
-                    break;
-                case NodeElement:
-                    out = PrintElementNode(out, node, flags, indent);
-                    break;
-                case NodeData:
-                    out = PrintDataNode(out, node, flags, indent);
-                    break;
-                case NodeCData:
-                    out = PrintCDataNode(out, node, flags, indent);
-                    break;
-                case NodeDeclaration:
-                    out = PrintDeclarationNode(out, node, flags, indent);
-                    break;
-                case NodeComment:
-                    out = PrintCommentNode(out, node, flags, indent);
-                    break;
-                case NodeDocType:
-                    out = PrintDocTypeNode(out, node, flags, indent);
-                    break;
-                case NodePi:
-                    out = PrintPiNode(out, node, flags, indent);
-                    break;
-                default:
-                    assert(0);
-                    break;
+            template<class OutIt, class Ch> inline OutIt PrintNode(OutIt out, const XmlNode<Ch> *root, int flags, int indent)
+            {
+                const XmlNode<Ch> *node = root;
+                while (1)
+                {
+                    bool children = false;
+                    switch (node->Type())
+                    {
+                    case NodeDocument:
+                        children = node->FirstNode() != 0;
+                        break;
+                    case NodeElement:
+                        out = PrintElementBegin(out, node, flags, indent, children);
+                        break;
+                    case NodeData:
+                        out = PrintDataNode(out, node, flags, indent);
+                        break;
+                    case NodeCData:
+                        out = PrintCDataNode(out, node, flags, indent);
+                        break;
+                    case NodeDeclaration:
+                        out = PrintDeclarationNode(out, node, flags, indent);
+                        break;
+                    case NodeComment:
+                        out = PrintCommentNode(out, node, flags, indent);
+                        break;
+                    case NodeDocType:
+                        out = PrintDocTypeNode(out, node, flags, indent);
+                        break;
+                    case NodePi:
+                        out = PrintPiNode(out, node, flags, indent);
+                        break;
+                    default:
+                        assert(0);
+                        break;
+                    }
+                    if (children)
+                    {
+                        if (node->Type() == NodeElement)
+                            indent++;
+                        node = node->FirstNode();
+                        continue;
+                    }
+                    while (1)
+                    {
+                        if (!(flags & PrintNoIndenting))
+                            *out = Ch('\n'), ++out;
+                        if (node == root)
+                            return out;
+                        if (node->NextSibling())
+                        {
+                            node = node->NextSibling();
+                            break;
+                        }
+                        node = node->Parent();
+                        if (node->Type() == NodeElement)
+                        {
+                            indent--;
+                            if (!(flags & PrintNoIndenting))
+                                out = FillChars(out, indent, Ch('\t'));
+                            out = PrintElementEnd(out, node);
+                        }
+                    }
                 }
-                if (!(flags & PrintNoIndenting))
-                    *out = Ch('\n'), ++out;
-                return out;
             }
         }
 
@@ -2226,6 +2827,7 @@ namespace Cpl
                 _data.resize(size + 1);
                 ifs.read(_data.data(), (std::streamsize)size);
                 _data[size] = 0;
+                DecodeUtf16(std::integral_constant<bool, sizeof(Ch) == 1>());
                 return true;
             }
 
@@ -2245,6 +2847,26 @@ namespace Cpl
             }
 
         private:
+            /// Converts a file with UTF-16 BOM to UTF-8 (only for File<char>).
+            void DecodeUtf16(std::true_type)
+            {
+                const size_t size = _data.size() - 1;
+                if (size < 2 || !(
+                    (static_cast<unsigned char>(_data[0]) == 0xFF && static_cast<unsigned char>(_data[1]) == 0xFE) ||
+                    (static_cast<unsigned char>(_data[0]) == 0xFE && static_cast<unsigned char>(_data[1]) == 0xFF)))
+                    return;
+                std::vector<char16_t> utf16((_data.size() - 1) / 2);
+                std::memcpy(utf16.data(), _data.data(), utf16.size() * sizeof(char16_t));
+                _data.resize(utf16.size() * 3 + 1);
+                const size_t utf8 = Internal::Utf16ToUtf8(utf16.data() + 1, utf16.size() - 1, utf16[0] == 0xFFFE, reinterpret_cast<char*>(_data.data()));
+                _data.resize(utf8 + 1);
+                _data[utf8] = 0;
+            }
+
+            void DecodeUtf16(std::false_type)
+            {
+            }
+
             std::vector<Ch> _data;
         };
 
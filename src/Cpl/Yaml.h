@@ -26,6 +26,46 @@
 
 #include "Cpl/String.h"
 
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPL_YAML_SSE2
+#include <emmintrin.h>
+#endif
+
+#if !defined(CPL_YAML_NO_MMAP)
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#define CPL_YAML_MMAP
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CPL_YAML_MMAP
+#endif
+#endif
+
+#if !defined(CPL_YAML_NO_EXCEPTIONS) && !(defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND))
+#define CPL_YAML_NO_EXCEPTIONS
+#endif
+
+#if defined(CPL_YAML_NO_EXCEPTIONS)
+#define CPL_YAML_THROW(exception) Cpl::Yaml::Detail::Abort(exception)
+#else
+#define CPL_YAML_THROW(exception) throw exception
+#endif
+
 namespace Cpl
 {
     namespace Yaml
@@ -34,6 +74,15 @@ namespace Cpl
 
         namespace Detail
         {
+            class Arena;
+            class NodeImp;
+            struct NodeHolder;
+            class NodeBuilder;
+            class Serializer;
+
+            template<typename T, class Enable = void> struct ScalarConverter;
+            CPL_INLINE const char* ScalarData(const void* pImp, size_t& size);
+
             template<typename T> struct StringConverter
             {
                 static T Get(const std::string& data)
@@ -159,6 +208,53 @@ namespace Cpl
             }
         };
 
+        /*!
+        * \brief Result of parsing without exceptions (TryParse()), an error is described as by the exception of Parse().
+        */
+        struct Status
+        {
+            Status()
+                : Failed(false)
+                , Type(Exception::ParsingError)
+                , Line(0)
+                , Column(0)
+            {
+            }
+
+            explicit operator bool() const
+            {
+                return Failed == false;
+            }
+
+            bool Failed;
+            Exception::Type Type;
+            size_t Line;            ///< Line of the error (from 1) or 0.
+            size_t Column;          ///< Column of the error (from 1) or 0.
+            std::string Message;    ///< Message of the exception which is thrown by Parse().
+        };
+
+        namespace Detail
+        {
+#if defined(CPL_YAML_NO_EXCEPTIONS)
+            /// Replaces throwing of exceptions if they are disabled.
+            [[noreturn]] inline void Abort(const Exception& exception)
+            {
+                std::cerr << exception.what() << std::endl;
+                std::abort();
+            }
+#endif
+
+            /// Throws the exception which is described by the failed status.
+            [[noreturn]] inline void Throw(const Status& status)
+            {
+                if (status.Type == Exception::InternalError)
+                    CPL_YAML_THROW(InternalException(status.Message));
+                if (status.Type == Exception::OperationError)
+                    CPL_YAML_THROW(OperationException(status.Message));
+                CPL_YAML_THROW(ParsingException(status.Message));
+            }
+        }
+
         class Iterator
         {
         public:
@@ -172,6 +268,7 @@ namespace Cpl
 
             ~Iterator();
 
+            /// Returns key and value of current element, the key reference is valid while the element is in the map.
             std::pair<const std::string&, Node&> operator *();
 
             Iterator& operator ++ (int);
@@ -192,7 +289,8 @@ namespace Cpl
             };
 
             eType m_Type;
-            void* m_pImp;
+            void* m_pImp;       ///< Implementation of iterated node.
+            size_t m_Index;     ///< Index of current element.
         };
 
         class ConstIterator
@@ -208,6 +306,7 @@ namespace Cpl
 
             ~ConstIterator();
 
+            /// Returns key and value of current element, the key reference is valid while the element is in the map.
             std::pair<const std::string&, const Node&> operator *();
 
             ConstIterator& operator ++ (int);
@@ -227,13 +326,23 @@ namespace Cpl
             };
 
             eType m_Type;
-            void* m_pImp;
+            void* m_pImp;       ///< Implementation of iterated node.
+            size_t m_Index;     ///< Index of current element.
         };
 
         class Node
         {
         public:
             friend class Iterator;
+            friend class ConstIterator;
+            friend class Document;
+            friend struct Detail::NodeHolder;
+            friend class Detail::NodeImp;
+            friend class Detail::NodeBuilder;
+            friend class Detail::Serializer;
+            friend class Path;
+            friend class PathSet;
+            friend void CopyNode(const Node& from, Node& to);
 
             enum eType
             {
@@ -245,6 +354,10 @@ namespace Cpl
 
             Node(bool none = false);
 
+            /// Copies (also by operator =) share subtrees with the source (copy-on-write) in O(number of children).
+            /// A mutation copies only the nodes on the path to the changed one. References to nested nodes
+            /// taken before a copy stay in their tree: a change through them is not visible in the copy.
+            /// Memory of erased and overwritten subtrees which are not shared with copies is reused by the tree.
             Node(const Node& node);
 
             Node(const std::string& value);
@@ -258,16 +371,48 @@ namespace Cpl
             bool IsMap() const;
             bool IsScalar() const;
 
+            /// Flow style ([...] or {...}) of sequence or map, it is used by serialization.
+            bool IsFlow() const;
+            void SetFlow(bool flow);
+
             void Clear();
 
+            /// Converts scalar to given type. Numbers are parsed once and cached in the node until its value is changed.
             template<typename T> T As() const
             {
-                return Detail::StringConverter<T>::Get(AsString());
+                return Detail::ScalarConverter<T>::Get(m_pImp);
             }
 
             template<typename T> T As(const T& defaultValue) const
             {
-                return Detail::StringConverter<T>::Get(AsString(), defaultValue);
+                return Detail::ScalarConverter<T>::Get(m_pImp, defaultValue);
+            }
+
+            /// Converts scalar directly from node storage with Cpl::ToVal rules, nothing is cached.
+            /// Returns false (the output is not changed) if the value can't be converted.
+            template<typename T> bool Get(T& value) const
+            {
+                size_t size;
+                const char* data = Detail::ScalarData(m_pImp, size);
+                return data ? Cpl::ToVal(data, size, value) : false;
+            }
+
+            /// Converts elements of sequence or space separated items of scalar.
+            template<typename T> bool Get(std::vector<T>& values) const
+            {
+                if (IsSequence())
+                {
+                    values.resize(Size());
+                    for (size_t i = 0; i < values.size(); ++i)
+                    {
+                        if (!(*this)[i].Get(values[i]))
+                            return false;
+                    }
+                    return true;
+                }
+                size_t size;
+                const char* data = Detail::ScalarData(m_pImp, size);
+                return data ? Cpl::ToVal(data, size, values) : false;
             }
 
             size_t Size() const;
@@ -281,13 +426,25 @@ namespace Cpl
             Node& operator []  (const size_t index);
             Node& operator [] (const std::string& key);
 
+            /// Read-only access, missing elements are returned as an empty node.
+            const Node& operator [] (const size_t index) const;
+            const Node& operator [] (const std::string& key) const;
+
+            /// Returns value of the key or nullptr. Missing keys are not inserted, nothing is changed.
+            Node* Find(const std::string& key);
+            const Node* Find(const std::string& key) const;
+
+            /// Erases element of sequence, indices of the following elements decrease by one (they are shifted).
             void Erase(const size_t index);
+
+            /// Erases entry of map, the order of other keys is kept.
             void Erase(const std::string& key);
 
             Node& operator = (const Node& node);
             Node& operator = (const std::string& value);
             Node& operator = (const char* value);
 
+            /// Maps are iterated in order of insertion of keys (parsed maps in order of the document), not sorted by keys.
             Iterator Begin();
             ConstIterator Begin() const;
 
@@ -295,9 +452,57 @@ namespace Cpl
             ConstIterator End() const;
 
         private:
-            const std::string& AsString() const;
+            Node(Detail::NodeImp* pImp);
+
+            /// Implementation which can be changed: shared ancestors and a shared implementation are replaced
+            /// by copies (copy-on-write).
+            Detail::NodeImp* Mutable(bool copy);
+
+            /// Replaces a shared implementation of the node by its copy.
+            Detail::NodeImp* Detach(bool copy);
 
             void* m_pImp; ///< Implementation of node class.
+            Detail::Arena* m_pArena; ///< Arena of the tree which contains the node.
+            Detail::NodeHolder* m_pHolder; ///< Holder of a child node or nullptr for a root.
+        };
+
+        /*!
+        * \brief Receiver of parsing events (SAX-style interface) for Parse(Handler&, ...).
+        *
+        * Events are produced in document order directly from the scanned lines, no Node tree is built.
+        * Returning false from MapStart(), SequenceStart() or Key() skips the whole subtree: its events
+        * (including the matching MapEnd() or SequenceEnd()) are not produced and its scalars are not assembled.
+        * Skipped subtrees are checked for structure only.
+        */
+        class Handler
+        {
+        public:
+            virtual ~Handler() {}
+
+            virtual bool MapStart() { return true; }
+            virtual void MapEnd() {}
+
+            virtual bool SequenceStart() { return true; }
+            virtual void SequenceEnd() {}
+
+            /// Start of flow collections ([...] and {...}), they end with SequenceEnd() and MapEnd().
+            virtual bool FlowMapStart() { return MapStart(); }
+            virtual bool FlowSequenceStart() { return SequenceStart(); }
+
+            /// Key of the next value of current map. Escape tokens are already removed.
+            virtual bool Key(const char* /*data*/, size_t /*size*/) { return true; }
+
+            virtual void Scalar(const char* /*data*/, size_t /*size*/) {}
+
+            /// Empty value (a block scalar without lines or a flow map key without value).
+            virtual void Null() {}
+
+            /// Anchor (&name) of the next value, it precedes events of the value.
+            virtual void Anchor(const char* /*data*/, size_t /*size*/) {}
+
+            /// Alias (*name) of an anchored value, it is passed instead of the value. Anchor is defined before.
+            /// Merge keys ("<<") are passed as usual keys.
+            virtual void Alias(const char* /*data*/, size_t /*size*/) { Null(); }
         };
 
         void Parse(Node& root, const char* filename);
@@ -305,6 +510,22 @@ namespace Cpl
         void Parse(Node& root, const std::string& string);
         void Parse(Node& root, const char* buffer, const size_t size);
 
+        void Parse(Handler& handler, const char* filename);
+        void Parse(Handler& handler, std::istream& stream);
+        void Parse(Handler& handler, const std::string& string);
+        void Parse(Handler& handler, const char* buffer, const size_t size);
+
+        /// Parsing which doesn't throw exceptions: the error is returned (the root is cleared if the input is invalid).
+        Status TryParse(Node& root, const char* filename);
+        Status TryParse(Node& root, std::istream& stream);
+        Status TryParse(Node& root, const std::string& string);
+        Status TryParse(Node& root, const char* buffer, const size_t size);
+
+        Status TryParse(Handler& handler, const char* filename);
+        Status TryParse(Handler& handler, std::istream& stream);
+        Status TryParse(Handler& handler, const std::string& string);
+        Status TryParse(Handler& handler, const char* buffer, const size_t size);
+
         struct SerializeConfig
         {
             SerializeConfig(const size_t spaceIndentation = 2,
@@ -318,6 +539,7 @@ namespace Cpl
             bool MapScalarNewline;      ///< Put scalars on a new line if parent node is a map.
         };
 
+        /// Keys of maps are written in order of their insertion (see Node::Begin()).
         void Serialize(const Node& root, const char* filename, const SerializeConfig& config = { 2, 64, false, false });
         void Serialize(const Node& root, std::ostream& stream, const SerializeConfig& config = { 2, 64, false, false });
         void Serialize(const Node& root, std::string& string, const SerializeConfig& config = { 2, 64, false, false });
@@ -336,2032 +558,5158 @@ namespace Cpl
                 return empty;
             }
 
-            class TypeImp
+            /// Read-only view of a whole file. The file is mapped to memory if it is possible, otherwise it is read to a buffer.
+            /// A mapped file must not be changed while the view is used.
+            class FileView
             {
             public:
-
-                virtual ~TypeImp()
+                FileView()
+                    : m_pData(nullptr)
+                    , m_Size(0)
+                    , m_Mapped(false)
                 {
                 }
 
-                virtual const std::string& GetData() const = 0;
-                virtual bool SetData(const std::string& data) = 0;
-                virtual size_t GetSize() const = 0;
-                virtual Node* GetNode(const size_t index) = 0;
-                virtual Node* GetNode(const std::string& key) = 0;
-                virtual Node* Insert(const size_t index) = 0;
-                virtual Node* PushFront() = 0;
-                virtual Node* PushBack() = 0;
-                virtual void Erase(const size_t index) = 0;
-                virtual void Erase(const std::string& key) = 0;
-            };
-
-            //-------------------------------------------------------------------------------------
-
-            class SequenceImp : public TypeImp
-            {
-            public:
-                ~SequenceImp()
+                ~FileView()
                 {
-                    for (auto it = m_Sequence.begin(); it != m_Sequence.end(); it++)
-                    {
-                        delete it->second;
-                    }
+                    Close();
                 }
 
-                virtual const std::string& GetData() const
+                /// Returns false if the file can't be opened.
+                bool Open(const char* filename)
                 {
-                    return Detail::EmptyString();
+                    Close();
+                    if (Map(filename))
+                        return true;
+
+                    std::ifstream f(filename, std::ifstream::binary);
+                    if (f.is_open() == false)
+                        return false;
+                    // The size is only a hint: it is unknown for pipes and devices (tellg() < 0), the file is read by chunks.
+                    f.seekg(0, f.end);
+                    const std::streamoff hint = f.tellg();
+                    f.clear();
+                    f.seekg(0, f.beg);
+                    f.clear();
+                    size_t capacity = hint > 0 ? static_cast<size_t>(hint) + 1 : READ_CHUNK;
+                    char* pBuffer = new char[capacity];
+                    for (;;)
+                    {
+                        if (m_Size + 1 == capacity)
+                        {
+                            char* pGrown = new char[capacity * 2];
+                            memcpy(pGrown, pBuffer, m_Size);
+                            delete[] pBuffer;
+                            pBuffer = pGrown;
+                            capacity *= 2;
+                        }
+                        f.read(pBuffer + m_Size, static_cast<std::streamsize>(capacity - 1 - m_Size));
+                        m_Size += static_cast<size_t>(f.gcount());
+                        if (f.good() == false)
+                            break;
+                    }
+                    pBuffer[m_Size] = 0;
+                    m_pData = pBuffer;
+                    return true;
                 }
 
-                virtual bool SetData(const std::string& data)
+                void Close()
                 {
-                    return false;
+                    if (m_pData && m_Mapped)
+                    {
+#if defined(CPL_YAML_MMAP) && defined(_WIN32)
+                        UnmapViewOfFile(m_pData);
+#elif defined(CPL_YAML_MMAP)
+                        munmap(const_cast<char*>(m_pData), m_Size);
+#endif
+                    }
+                    else
+                        delete[] m_pData;
+                    m_pData = nullptr;
+                    m_Size = 0;
+                    m_Mapped = false;
                 }
 
-                virtual size_t GetSize() const
+                const char* Data() const
                 {
-                    return m_Sequence.size();
+                    return m_pData;
                 }
 
-                virtual Node* GetNode(const size_t index)
+                size_t Size() const
                 {
-                    auto it = m_Sequence.find(index);
-                    if (it != m_Sequence.end())
-                    {
-                        return it->second;
-                    }
-                    return nullptr;
+                    return m_Size;
                 }
 
-                virtual Node* GetNode(const std::string& key)
+                bool Mapped() const
                 {
-                    return nullptr;
+                    return m_Mapped;
                 }
 
-                virtual Node* Insert(const size_t index)
-                {
-                    if (m_Sequence.size() == 0)
-                    {
-                        Node* pNode = new Node;
-                        m_Sequence.insert({ 0, pNode });
-                        return pNode;
-                    }
+            private:
+                static const size_t READ_CHUNK = 64 * 1024;
 
-                    if (index >= m_Sequence.size())
-                    {
-                        auto it = m_Sequence.end();
-                        --it;
-                        Node* pNode = new Node;
-                        m_Sequence.insert({ it->first, pNode });
-                        return pNode;
-                    }
+                FileView(const FileView&);
+                FileView& operator = (const FileView&);
 
-                    auto it = m_Sequence.cbegin();
-                    while (it != m_Sequence.cend())
+                /// Maps a non-empty regular file.
+                bool Map(const char* filename)
+                {
+#if defined(_WIN32) && defined(CPL_YAML_MMAP)
+                    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+                    if (file == INVALID_HANDLE_VALUE)
+                        return false;
+                    LARGE_INTEGER size;
+                    if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && uint64_t(size.QuadPart) <= SIZE_MAX)
                     {
-                        m_Sequence[it->first + 1] = it->second;
-
-                        if (it->first == index)
+                        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+                        if (mapping)
                         {
-                            break;
+                            m_pData = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                            CloseHandle(mapping);
                         }
                     }
-
-                    Node* pNode = new Node;
-                    m_Sequence.insert({ index, pNode });
-                    return pNode;
-                }
-
-                virtual Node* PushFront()
-                {
-                    for (auto it = m_Sequence.cbegin(); it != m_Sequence.cend(); it++)
-                    {
-                        m_Sequence[it->first + 1] = it->second;
-                    }
-
-                    Node* pNode = new Node;
-                    m_Sequence.insert({ 0, pNode });
-                    return pNode;
-                }
-
-                virtual Node* PushBack()
-                {
-                    size_t index = 0;
-                    if (m_Sequence.size())
+                    CloseHandle(file);
+                    if (m_pData)
                     {
-                        auto it = m_Sequence.end();
-                        --it;
-                        index = it->first + 1;
+                        m_Size = static_cast<size_t>(size.QuadPart);
+                        m_Mapped = true;
                     }
-
-                    Node* pNode = new Node;
-                    m_Sequence.insert({ index, pNode });
-                    return pNode;
-                }
-
-                virtual void Erase(const size_t index)
-                {
-                    auto it = m_Sequence.find(index);
-                    if (it == m_Sequence.end())
+#elif defined(CPL_YAML_MMAP)
+                    int file = open(filename, O_RDONLY);
+                    if (file < 0)
+                        return false;
+                    struct stat info;
+                    if (fstat(file, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 && uint64_t(info.st_size) <= SIZE_MAX)
                     {
-                        return;
+                        void* pData = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+                        if (pData != MAP_FAILED)
+                        {
+                            m_pData = static_cast<const char*>(pData);
+                            m_Size = static_cast<size_t>(info.st_size);
+                            m_Mapped = true;
+                        }
                     }
-                    delete it->second;
-                    m_Sequence.erase(index);
-                }
-
-                virtual void Erase(const std::string& key)
-                {
+                    close(file);
+#else
+                    (void)filename;
+#endif
+                    return m_Mapped;
                 }
 
-                std::map<size_t, Node*> m_Sequence;
+                const char* m_pData;
+                size_t m_Size;
+                bool m_Mapped;
             };
 
             //-------------------------------------------------------------------------------------
 
-            class MapImp : public TypeImp
+            /// Bump allocator which owns all nodes and strings of one node tree.
+            /// Memory blocks are kept in a reference counted store: a tree which shares nodes of other tree
+            /// (copy-on-write) borrows its store, so the shared nodes outlive clearing or destruction of their tree.
+            /// Memory of erased and overwritten nodes is returned by Free() and reused by next allocations of the tree.
+            class Arena
             {
             public:
-                ~MapImp()
+                Arena()
+                    : m_pStore(new Store())
+                    , m_pPtr(nullptr)
+                    , m_pEnd(nullptr)
+                    , m_NextSize(MIN_BLOCK)
                 {
-                    for (auto it = m_Map.begin(); it != m_Map.end(); it++)
-                    {
-                        delete it->second;
-                    }
                 }
 
-                virtual const std::string& GetData() const
+                ~Arena()
                 {
-                    return Detail::EmptyString();
+                    Release(m_pStore);
                 }
 
-                virtual bool SetData(const std::string& data)
+                void* Allocate(size_t size)
                 {
-                    return false;
+                    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+                    if (m_Free.size())
+                    {
+                        void* pFree = Reuse(size);
+                        if (pFree)
+                            return pFree;
+                    }
+                    if (size > size_t(m_pEnd - m_pPtr))
+                        Grow(size);
+                    void* pResult = m_pPtr;
+                    m_pPtr += size;
+                    return pResult;
                 }
 
-                virtual size_t GetSize() const
+                /// Returns memory of Allocate(size) to the arena. It is kept in free lists of size classes: exact sizes
+                /// for small blocks and powers of two for large ones.
+                void Free(void* pMemory, size_t size)
                 {
-                    return m_Map.size();
+                    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+                    const size_t index = Class(size);
+                    if (index >= m_Free.size())
+                        m_Free.resize(index + 1, nullptr);
+                    FreeBlock* pBlock = static_cast<FreeBlock*>(pMemory);
+                    pBlock->next = m_Free[index];
+                    if (size > SMALL_MAX)
+                        pBlock->size = size;
+                    m_Free[index] = pBlock;
                 }
 
-                virtual Node* GetNode(const size_t index)
+                char* Copy(const char* data, size_t size)
                 {
-                    return nullptr;
+                    char* pResult = static_cast<char*>(Allocate(size + 1));
+                    memcpy(pResult, data, size);
+                    pResult[size] = 0;
+                    return pResult;
                 }
 
-                virtual Node* GetNode(const std::string& key)
+                struct Store;
+
+                /// Key of map element as std::string (for iterators). It is created on the first access
+                /// and is deleted with its holder or with the store of the holder.
+                struct KeyString
                 {
-                    auto it = m_Map.find(key);
-                    if (it == m_Map.end())
-                    {
-                        Node* pNode = new Node;
-                        m_Map.insert({ key, pNode });
-                        return pNode;
-                    }
-                    return it->second;
-                }
+                    std::string value;
+                    KeyString* prev;
+                    KeyString* next;
+                };
 
-                virtual Node* Insert(const size_t index)
+                /// Store of memory blocks which are allocated now.
+                Store* Owner() const
                 {
-                    return nullptr;
+                    return m_pStore;
                 }
 
-                virtual Node* PushFront()
+                /// Returns the string of the key in the slot, it is created once (also by concurrent readers).
+                static const std::string& Key(std::atomic<KeyString*>& slot, Store* pStore, const char* data, size_t size)
                 {
-                    return nullptr;
+                    KeyString* pKey = slot.load(std::memory_order_acquire);
+                    if (pKey == nullptr)
+                    {
+                        std::lock_guard<std::mutex> lock(pStore->mutex);
+                        pKey = slot.load(std::memory_order_relaxed);
+                        if (pKey == nullptr)
+                        {
+                            pKey = new KeyString{ std::string(data, size), nullptr, pStore->keys };
+                            if (pStore->keys)
+                                pStore->keys->prev = pKey;
+                            pStore->keys = pKey;
+                            slot.store(pKey, std::memory_order_release);
+                        }
+                    }
+                    return pKey->value;
                 }
 
-                virtual Node* PushBack()
+                static void DropKey(std::atomic<KeyString*>& slot, Store* pStore)
                 {
-                    return nullptr;
+                    KeyString* pKey = slot.load(std::memory_order_acquire);
+                    if (pKey == nullptr)
+                        return;
+                    std::lock_guard<std::mutex> lock(pStore->mutex);
+                    if (pKey->prev)
+                        pKey->prev->next = pKey->next;
+                    else
+                        pStore->keys = pKey->next;
+                    if (pKey->next)
+                        pKey->next->prev = pKey->prev;
+                    delete pKey;
+                    slot.store(nullptr, std::memory_order_relaxed);
                 }
 
-                virtual void Erase(const size_t index)
+                /// Opens a view of the file which lives as long as this memory, returns nullptr if the file can't be opened.
+                const FileView* Open(const char* filename)
                 {
+                    std::unique_ptr<FileView> pFile(new FileView());
+                    if (pFile->Open(filename) == false)
+                        return nullptr;
+                    m_pStore->files.push_back(pFile.get());
+                    return pFile.release();
                 }
 
-                virtual void Erase(const std::string& key)
+                /// Releases all memory except the last (largest) block which is reused.
+                /// Memory which is borrowed by other arenas is left to them, this arena starts a new store.
+                void Clear()
                 {
-                    auto it = m_Map.find(key);
-                    if (it == m_Map.end())
+                    m_Free.clear();
+                    if (m_pStore->refs > 1)
                     {
+                        Release(m_pStore);
+                        m_pStore = new Store();
+                        m_pPtr = nullptr;
+                        m_pEnd = nullptr;
+                        return;
+                    }
+                    for (size_t i = 0; i < m_pStore->borrowed.size(); ++i)
+                        Release(m_pStore->borrowed[i]);
+                    m_pStore->borrowed.clear();
+                    for (size_t i = 0; i < m_pStore->files.size(); ++i)
+                        delete m_pStore->files[i];
+                    m_pStore->files.clear();
+                    DeleteKeys(m_pStore);
+                    Block* pBlock = m_pStore->pBlock;
+                    if (pBlock == nullptr)
                         return;
+                    for (Block* pPrev = pBlock->prev; pPrev;)
+                    {
+                        Block* pNext = pPrev->prev;
+                        delete[] reinterpret_cast<char*>(pPrev);
+                        pPrev = pNext;
                     }
-                    delete it->second;
-                    m_Map.erase(key);
+                    pBlock->prev = nullptr;
+                    m_pPtr = reinterpret_cast<char*>(pBlock + 1);
+                    m_pEnd = reinterpret_cast<char*>(pBlock) + pBlock->size;
                 }
 
-                std::map<std::string, Node*> m_Map;
-
-            };
-
-            //-------------------------------------------------------------------------------------
-
-            class ScalarImp : public TypeImp
-            {
-
-            public:
-                ~ScalarImp()
+                size_t Reserved() const
                 {
+                    size_t reserved = 0;
+                    for (const Block* pBlock = m_pStore->pBlock; pBlock; pBlock = pBlock->prev)
+                        reserved += pBlock->size;
+                    return reserved;
                 }
 
-                virtual const std::string& GetData() const
+                /// Keeps memory of other arena alive until this memory is released: nodes of this tree refer to it.
+                void Borrow(const Arena& other)
                 {
-                    return m_Value;
+                    Store* pOther = other.m_pStore;
+                    if (pOther == m_pStore || std::find(m_pStore->borrowed.begin(), m_pStore->borrowed.end(), pOther) != m_pStore->borrowed.end())
+                        return;
+                    pOther->refs++;
+                    m_pStore->borrowed.push_back(pOther);
                 }
 
-                virtual bool SetData(const std::string& data)
+                /// Memory of this arena refers (directly or indirectly) to memory of other arena.
+                bool Borrows(const Arena& other) const
                 {
-                    m_Value = data;
-                    return true;
+                    return Borrows(m_pStore, other.m_pStore);
                 }
 
-                virtual size_t GetSize() const
+            private:
+                static const size_t ALIGNMENT = sizeof(void*) > 8 ? sizeof(void*) : 8;
+                static const size_t MIN_BLOCK = 256;
+                static const size_t MAX_BLOCK = 64 * 1024;
+                static const size_t SMALL_MAX = 512; ///< Free blocks up to this size are reused for the same size only.
+
+                struct Block
                 {
-                    return 0;
-                }
+                    Block* prev;
+                    size_t size;
+                    size_t padding;
+                };
 
-                virtual Node* GetNode(const size_t index)
+                struct FreeBlock
                 {
-                    return nullptr;
-                }
+                    FreeBlock* next;
+                    size_t size;    ///< It is set for large blocks only: small ones can be smaller than this struct.
+                };
+
+            public:
+                struct Store
+                {
+                    std::atomic<size_t> refs;
+                    Block* pBlock;                  ///< Current block, blocks are linked to previous ones.
+                    std::vector<Store*> borrowed;   ///< Stores of other arenas which are referred from this one.
+                    std::vector<FileView*> files;   ///< Views of files which are referred by scalars and keys.
+                    KeyString* keys;                ///< Key strings of holders which are allocated in this store.
+                    std::mutex mutex;               ///< It guards the key strings.
+
+                    Store()
+                        : refs(1)
+                        , pBlock(nullptr)
+                        , keys(nullptr)
+                    {
+                    }
+                };
+
+            private:
+
+                Arena(const Arena&);
+                Arena& operator = (const Arena&);
 
-                virtual Node* GetNode(const std::string& key)
+                /// Index of free list: small sizes have own lists, large ones are grouped by their highest bit.
+                static size_t Class(size_t size)
                 {
-                    return nullptr;
+                    if (size <= SMALL_MAX)
+                        return size / ALIGNMENT - 1;
+                    size_t index = SMALL_MAX / ALIGNMENT;
+                    for (size >>= 10; size; size >>= 1)
+                        index++;
+                    return index;
                 }
 
-                virtual Node* Insert(const size_t index)
+                void* Reuse(size_t size)
                 {
+                    size_t index = Class(size);
+                    for (size_t end = std::min(index + (size > SMALL_MAX ? 2 : 1), m_Free.size()); index < end; ++index)
+                    {
+                        FreeBlock* pBlock = m_Free[index];
+                        if (pBlock && (size <= SMALL_MAX || pBlock->size >= size))
+                        {
+                            m_Free[index] = pBlock->next;
+                            return pBlock;
+                        }
+                    }
                     return nullptr;
                 }
 
-                virtual Node* PushFront()
+                void Grow(size_t size)
                 {
-                    return nullptr;
+                    size_t blockSize = std::max(m_NextSize, size + sizeof(Block));
+                    m_NextSize = m_NextSize * 2 < MAX_BLOCK ? m_NextSize * 2 : size_t(MAX_BLOCK);
+                    Block* pBlock = reinterpret_cast<Block*>(new char[blockSize]);
+                    pBlock->prev = m_pStore->pBlock;
+                    pBlock->size = blockSize;
+                    m_pStore->pBlock = pBlock;
+                    m_pPtr = reinterpret_cast<char*>(pBlock + 1);
+                    m_pEnd = reinterpret_cast<char*>(pBlock) + blockSize;
                 }
 
-                virtual Node* PushBack()
+                static void Release(Store* pStore)
                 {
-                    return nullptr;
+                    if (--pStore->refs)
+                        return;
+                    for (Block* pBlock = pStore->pBlock; pBlock;)
+                    {
+                        Block* pPrev = pBlock->prev;
+                        delete[] reinterpret_cast<char*>(pBlock);
+                        pBlock = pPrev;
+                    }
+                    for (size_t i = 0; i < pStore->borrowed.size(); ++i)
+                        Release(pStore->borrowed[i]);
+                    for (size_t i = 0; i < pStore->files.size(); ++i)
+                        delete pStore->files[i];
+                    DeleteKeys(pStore);
+                    delete pStore;
                 }
 
-                virtual void Erase(const size_t index)
+                static void DeleteKeys(Store* pStore)
                 {
+                    for (KeyString* pKey = pStore->keys; pKey;)
+                    {
+                        KeyString* pNext = pKey->next;
+                        delete pKey;
+                        pKey = pNext;
+                    }
+                    pStore->keys = nullptr;
                 }
 
-                virtual void Erase(const std::string& key)
+                static bool Borrows(const Store* pStore, const Store* pOther)
                 {
+                    for (size_t i = 0; i < pStore->borrowed.size(); ++i)
+                    {
+                        if (pStore->borrowed[i] == pOther || Borrows(pStore->borrowed[i], pOther))
+                            return true;
+                    }
+                    return false;
                 }
 
-                std::string m_Value;
+                Store* m_pStore;
+                char* m_pPtr;
+                char* m_pEnd;
+                size_t m_NextSize;
+                std::vector<FreeBlock*> m_Free; ///< Free lists of size classes.
             };
 
             //-------------------------------------------------------------------------------------
 
+            /// Node data. It lives in the arena of the tree and owns no other memory, so the whole tree is released with the arena.
             class NodeImp
             {
-
             public:
-
-                NodeImp() :
-                    m_Type(Node::None),
-                    m_pImp(nullptr)
+                NodeImp(Arena* pArena, bool root, bool embedded)
+                    : m_Type(Node::None)
+                    , m_Flow(false)
+                    , m_Embedded(embedded)
+                    , m_Root(root)
+                    , m_Shared(false)
+                    , m_Anchored(false)
+                    , m_pArena(pArena)
+                    , m_pOwner(nullptr)
+                    , m_Anchor(nullptr)
                 {
+                    Reset();
                 }
 
-                ~NodeImp()
-                {
-                    Clear();
-                }
+                /// Copies the node without its subtree: children become shared and are copied on write.
+                void Assign(const NodeImp& from);
+
+                /// Moves the value and the children (their holders stay the same) of other node to this one.
+                void Take(NodeImp& from);
+
+                /// Assigns the node of the same tree. The old value and subtree are released after it: the source can be their part.
+                void Replace(const NodeImp& from);
+
+                /// Replaces shared ancestors of the holder from the root down: their holders (and references to them)
+                /// are moved to copies, the shared ones keep snapshots for the trees which refer to them.
+                static void Unshare(NodeHolder* pHolder);
+
+                /// The node is a part of this subtree. Shared subtrees are skipped: they can't contain a changed node.
+                bool Contains(const Node* pNode) const;
+
+                /// Returns memory of the value and of the subtree to the arena, the node becomes empty. Shared nodes
+                /// can be referred from other places: they (and their subtrees) are kept.
+                void Release();
 
                 void Clear()
                 {
-                    if (m_pImp != nullptr)
+                    if (m_Root)
                     {
-                        delete m_pImp;
-                        m_pImp = nullptr;
+                        m_pArena->Clear();
+                        m_Anchor = nullptr;
                     }
+                    else
+                        Release();
+                    Reset();
                     m_Type = Node::None;
                 }
 
-                void InitSequence()
+                /// Changes type of the node, the old value is released. The parser keeps it: anchors can refer to it.
+                void Init(Node::eType type, bool release = true)
                 {
-                    if (m_Type != Node::SequenceType || m_pImp == nullptr)
+                    if (m_Type != type)
                     {
-                        if (m_pImp)
-                        {
-                            delete m_pImp;
-                        }
-                        m_pImp = new SequenceImp;
-                        m_Type = Node::SequenceType;
+                        if (release)
+                            Release();
+                        Reset();
+                        m_Type = type;
                     }
                 }
 
-                void InitMap()
+                void SetValue(const char* data, size_t size)
                 {
-                    if (m_Type != Node::MapType || m_pImp == nullptr)
+                    m_Cached.store(CachedNone, std::memory_order_relaxed);
+                    if (size >= m_Capacity)
                     {
-                        if (m_pImp)
-                        {
-                            delete m_pImp;
-                        }
-                        m_pImp = new MapImp;
-                        m_Type = Node::MapType;
+                        if (m_Capacity)
+                            m_pArena->Free(m_Value, m_Capacity);
+                        m_Value = static_cast<char*>(m_pArena->Allocate(size + 1));
+                        m_Capacity = size + 1;
                     }
+                    memcpy(m_Value, data, size);
+                    m_Value[size] = 0;
+                    m_Size = size;
                 }
 
-                void InitScalar()
+                /// Refers to the value in memory which is kept while the tree is used (retained input buffer).
+                void SetView(const char* data, size_t size)
                 {
-                    if (m_Type != Node::ScalarType || m_pImp == nullptr)
-                    {
-                        if (m_pImp)
-                        {
-                            delete m_pImp;
-                        }
-                        m_pImp = new ScalarImp;
-                        m_Type = Node::ScalarType;
-                    }
-
+                    m_Cached.store(CachedNone, std::memory_order_relaxed);
+                    m_Value = const_cast<char*>(data); // It is never written: zero capacity makes SetValue() allocate.
+                    m_Capacity = 0;
+                    m_Size = size;
                 }
 
-                Node::eType    m_Type;  ///< Type of node.
-                TypeImp* m_pImp;  ///< Imp of type.
-            };
+                /// Keeps the name of the anchor which defines the node in parsed document (the first one), it is written back.
+                void SetAnchor(const char* name, size_t size)
+                {
+                    if (m_Anchor == nullptr && size)
+                        m_Anchor = m_pArena->Copy(name, size);
+                }
 
-            //-------------------------------------------------------------------------------------
+                size_t Size() const
+                {
+                    return m_Count;
+                }
 
-            class IteratorImp
-            {
+                Node& Item(size_t index) const;
 
-            public:
+                const char* Key(size_t index) const;
 
-                virtual ~IteratorImp()
-                {
-                }
+                size_t KeySize(size_t index) const;
 
-                virtual Node::eType GetType() const = 0;
-                virtual void InitBegin(SequenceImp* pSequenceImp) = 0;
-                virtual void InitEnd(SequenceImp* pSequenceImp) = 0;
-                virtual void InitBegin(MapImp* pMapImp) = 0;
-                virtual void InitEnd(MapImp* pMapImp) = 0;
+                const std::string& KeyString(size_t index) const;
 
-            };
+                Node* Insert(size_t index);
 
-            //-------------------------------------------------------------------------------------
+                /// Removes the element, its memory is released.
+                void Erase(size_t index);
 
-            class SequenceIteratorImp : public IteratorImp
-            {
+                /// Element refers to the implementation of another node (YAML alias).
+                bool IsShared(size_t index) const;
 
-            public:
+                /// Makes the element an alias of pShared, or restores its own implementation if pShared is nullptr.
+                void Share(size_t index, NodeImp* pShared);
 
-                virtual Node::eType GetType() const
-                {
-                    return Node::SequenceType;
-                }
+                /// Replaces merge key ("<<") at index by the missing keys of its map (or maps of its sequence).
+                /// Merged values are shared with the source maps.
+                void Merge(size_t index);
 
-                virtual void InitBegin(SequenceImp* pSequenceImp)
+                /// Converts scalar to number. The first conversion is cached until the value is changed. The cache is filled
+                /// once and published atomically: concurrent readers and conversions to other kinds use a local result.
+                template<typename T> bool Number(T& value) const
                 {
-                    m_Iterator = pSequenceImp->m_Sequence.begin();
+                    typedef typename std::conditional<std::is_floating_point<T>::value, double,
+                        typename std::conditional<std::is_signed<T>::value, int64_t, uint64_t>::type>::type Wide;
+                    const unsigned char kind = std::is_floating_point<T>::value ? CachedFloat : (std::is_signed<T>::value ? CachedSigned : CachedUnsigned);
+                    unsigned char cached = m_Cached.load(std::memory_order_acquire);
+                    Wide number = 0;
+                    bool valid;
+                    if ((cached & ~CachedFailed) == kind)
+                    {
+                        valid = (cached & CachedFailed) == 0;
+                        number = Cache((Wide*)nullptr);
+                    }
+                    else
+                    {
+                        valid = m_Type == Node::ScalarType && Cpl::ToVal(m_Value, m_Size, number);
+                        if (cached == CachedNone && m_Cached.compare_exchange_strong(cached, CachedBusy, std::memory_order_relaxed))
+                        {
+                            Cache((Wide*)nullptr) = number;
+                            m_Cached.store(kind | (valid ? 0 : CachedFailed), std::memory_order_release);
+                        }
+                    }
+                    if (valid == false)
+                        return false;
+                    if (std::is_integral<T>::value && (number < Wide(std::numeric_limits<T>::lowest()) || number > Wide(std::numeric_limits<T>::max())))
+                        return false;
+                    value = T(number);
+                    return true;
                 }
 
-                virtual void InitEnd(SequenceImp* pSequenceImp)
+                /// Returns index of the key or std::string::npos.
+                size_t Find(const char* key, size_t size) const
                 {
-                    m_Iterator = pSequenceImp->m_Sequence.end();
+                    if (m_IndexSize == 0)
+                    {
+                        for (size_t i = 0; i < m_Count; ++i)
+                        {
+                            if (KeySize(i) == size && memcmp(Key(i), key, size) == 0)
+                                return i;
+                        }
+                        return std::string::npos;
+                    }
+                    const size_t mask = m_IndexSize - 1;
+                    for (size_t h = Hash(key, size) & mask;; h = (h + 1) & mask)
+                    {
+                        const uint32_t i = m_Index[h];
+                        if (i == 0)
+                            return std::string::npos;
+                        if (KeySize(i - 1) == size && memcmp(Key(i - 1), key, size) == 0)
+                            return i - 1;
+                    }
                 }
 
-                virtual void InitBegin(MapImp* pMapImp)
-                {
-                }
+                /// Returns value of the key, a new value is added to the end if the key is missing.
+                /// A key of the view is not copied: it is in memory which is kept while the tree is used.
+                Node* Get(const char* key, size_t size, bool view = false);
 
-                virtual void InitEnd(MapImp* pMapImp)
+                void Erase(const char* key, size_t size)
                 {
+                    size_t index = Find(key, size);
+                    if (index == std::string::npos)
+                        return;
+                    Erase(index);
+                    if (m_IndexSize)
+                        Reindex(m_IndexSize);
                 }
 
-                void Copy(const SequenceIteratorImp& it)
+                static size_t Hash(const char* key, size_t size)
                 {
-                    m_Iterator = it.m_Iterator;
+                    size_t hash = 2166136261u;
+                    for (size_t i = 0; i < size; ++i)
+                        hash = (hash ^ (uint8_t)key[i]) * 16777619u;
+                    return hash;
                 }
 
-                std::map<size_t, Node*>::iterator m_Iterator;
+                Node::eType m_Type;     ///< Type of node.
+                bool m_Flow;            ///< Flow style of sequence or map.
+                bool m_Embedded;        ///< Implementation is a part of NodeHolder or Document.
+                bool m_Root;            ///< Root of the arena: Clear() releases the whole arena.
+                bool m_Shared;          ///< Node is referred from several places, it is never changed.
+                bool m_Anchored;        ///< Node is referred by alias or merge key of parsed document, it is written with anchor.
+                Arena* m_pArena;        ///< Arena of the tree.
+                NodeHolder* m_pOwner;   ///< Holder which owns the node (its references belong to its tree) or nullptr.
+                char* m_Anchor;         ///< Name of the anchor of parsed document (zero terminated) or nullptr.
+                char* m_Value;          ///< Value of scalar (zero terminated if it is not a view of input buffer).
+                size_t m_Size;          ///< Size of scalar value.
 
-            };
-
-            //-------------------------------------------------------------------------------------
+            private:
+                static const size_t INDEX_MIN = 8; ///< Maps with more keys use hash index.
 
-            class MapIteratorImp : public IteratorImp
-            {
+                enum Cached
+                {
+                    CachedNone,
+                    CachedBusy,
+                    CachedSigned,
+                    CachedUnsigned,
+                    CachedFloat,
+                    CachedFailed = 8
+                };
 
-            public:
+                int64_t& Cache(int64_t*) const { return m_Cache.i; }
+                uint64_t& Cache(uint64_t*) const { return m_Cache.u; }
+                double& Cache(double*) const { return m_Cache.f; }
 
-                virtual Node::eType GetType() const
+                void Reset()
                 {
-                    return Node::MapType;
+                    m_Flow = false;
+                    m_Cached.store(CachedNone, std::memory_order_relaxed);
+                    m_Value = nullptr;
+                    m_Size = 0;
+                    m_Capacity = 0;
+                    m_Items = nullptr;
+                    m_Count = 0;
+                    m_ItemsCapacity = 0;
+                    m_Index = nullptr;
+                    m_IndexSize = 0;
                 }
 
-                virtual void InitBegin(SequenceImp* pSequenceImp)
-                {
-                }
+                /// Removes the element without release of its memory: it stays in the arena.
+                void Remove(size_t index);
 
-                virtual void InitEnd(SequenceImp* pSequenceImp)
-                {
-                }
+                /// Frees the holder (if its node isn't shared) or adds its own node to the stack: the node and the holder
+                /// are freed after release of the subtree.
+                static void ReleaseHolder(NodeHolder* pHolder, std::vector<std::pair<NodeImp*, bool>>& stack);
 
-                virtual void InitBegin(MapImp* pMapImp)
-                {
-                    m_Iterator = pMapImp->m_Map.begin();
-                }
+                /// Releases the nodes of the stack (and whether their holders are freed) with their subtrees.
+                static void Release(std::vector<std::pair<NodeImp*, bool>>& stack);
 
-                virtual void InitEnd(MapImp* pMapImp)
+                void FreeBuffers()
                 {
-                    m_Iterator = pMapImp->m_Map.end();
+                    if (m_Anchor)
+                    {
+                        m_pArena->Free(m_Anchor, strlen(m_Anchor) + 1);
+                        m_Anchor = nullptr;
+                    }
+                    if (m_Capacity)
+                        m_pArena->Free(m_Value, m_Capacity);
+                    if (m_ItemsCapacity)
+                        m_pArena->Free(m_Items, m_ItemsCapacity * sizeof(NodeHolder*));
+                    if (m_IndexSize)
+                        m_pArena->Free(m_Index, m_IndexSize * sizeof(uint32_t));
                 }
 
-                void Copy(const MapIteratorImp& it)
+                void AddIndex(size_t index)
                 {
-                    m_Iterator = it.m_Iterator;
+                    const size_t mask = m_IndexSize - 1;
+                    size_t h = Hash(Key(index), KeySize(index)) & mask;
+                    while (m_Index[h])
+                        h = (h + 1) & mask;
+                    m_Index[h] = uint32_t(index + 1);
                 }
 
-                std::map<std::string, Node*>::iterator m_Iterator;
-
+                void Reindex(size_t size)
+                {
+                    if (size != m_IndexSize)
+                    {
+                        if (m_IndexSize)
+                            m_pArena->Free(m_Index, m_IndexSize * sizeof(uint32_t));
+                        m_Index = static_cast<uint32_t*>(m_pArena->Allocate(size * sizeof(uint32_t)));
+                        m_IndexSize = size;
+                    }
+                    memset(m_Index, 0, size * sizeof(uint32_t));
+                    for (size_t i = 0; i < m_Count; ++i)
+                        AddIndex(i);
+                }
+
+                size_t m_Capacity;          ///< Capacity of scalar value buffer.
+                NodeHolder** m_Items;       ///< Elements of sequence or values of map.
+                size_t m_Count;             ///< Number of elements.
+                size_t m_ItemsCapacity;
+                uint32_t* m_Index;          ///< Open addressing hash table of key indices (+1), empty for small maps.
+                size_t m_IndexSize;
+                mutable std::atomic<unsigned char> m_Cached; ///< Kind of the cached number (Cached enumeration, CachedFailed is a flag).
+                mutable union
+                {
+                    int64_t i;
+                    uint64_t u;
+                    double f;
+                } m_Cache;                  ///< Number converted from scalar value.
             };
 
             //-------------------------------------------------------------------------------------
 
-            class SequenceConstIteratorImp : public IteratorImp
+            /// Child node of sequence or map: the node, its implementation and its key in one arena allocation.
+            struct NodeHolder
             {
+                NodeImp imp;
+                Node node;
+                const char* key;
+                size_t keySize;
+                bool ownKey;        ///< The key is copied to the arena for this holder only, it is freed with the holder.
+                NodeImp* parent;    ///< Node which contains the holder.
+                Arena::Store* store; ///< Store of the holder memory.
+                std::atomic<Arena::KeyString*> keyString; ///< The key as std::string, it is created by iterators.
 
-            public:
-
-                virtual Node::eType GetType() const
-                {
-                    return Node::SequenceType;
-                }
-
-                virtual void InitBegin(SequenceImp* pSequenceImp)
-                {
-                    m_Iterator = pSequenceImp->m_Sequence.begin();
-                }
-
-                virtual void InitEnd(SequenceImp* pSequenceImp)
-                {
-                    m_Iterator = pSequenceImp->m_Sequence.end();
-                }
-
-                virtual void InitBegin(MapImp* pMapImp)
+                NodeHolder(Arena* pArena, NodeImp* pParent)
+                    : imp(pArena, false, true)
+                    , node(&imp)
+                    , key("")
+                    , keySize(0)
+                    , ownKey(false)
+                    , parent(pParent)
+                    , store(pArena->Owner())
+                    , keyString(nullptr)
                 {
+                    imp.m_pOwner = this;
+                    node.m_pHolder = this;
                 }
 
-                virtual void InitEnd(MapImp* pMapImp)
+                const std::string& KeyString()
                 {
+                    return Arena::Key(keyString, store, key, keySize);
                 }
 
-                void Copy(const SequenceConstIteratorImp& it)
+                void Free()
                 {
-                    m_Iterator = it.m_Iterator;
+                    Arena::DropKey(keyString, store);
+                    if (ownKey)
+                        imp.m_pArena->Free(const_cast<char*>(key), keySize + 1);
+                    imp.m_pArena->Free(this, sizeof(NodeHolder));
                 }
-
-                std::map<size_t, Node*>::const_iterator m_Iterator;
-
             };
 
             //-------------------------------------------------------------------------------------
 
-            class MapConstIteratorImp : public IteratorImp
+            inline Node& NodeImp::Item(size_t index) const
             {
+                return m_Items[index]->node;
+            }
 
-            public:
-
-                virtual Node::eType GetType() const
-                {
-                    return Node::MapType;
-                }
-
-                virtual void InitBegin(SequenceImp* pSequenceImp)
-                {
-                }
-
-                virtual void InitEnd(SequenceImp* pSequenceImp)
-                {
-                }
-
-                virtual void InitBegin(MapImp* pMapImp)
-                {
-                    m_Iterator = pMapImp->m_Map.begin();
-                }
-
-                virtual void InitEnd(MapImp* pMapImp)
-                {
-                    m_Iterator = pMapImp->m_Map.end();
-                }
-
-                void Copy(const MapConstIteratorImp& it)
-                {
-                    m_Iterator = it.m_Iterator;
-                }
+            inline const char* NodeImp::Key(size_t index) const
+            {
+                return m_Items[index]->key;
+            }
 
-                std::map<std::string, Node*>::const_iterator m_Iterator;
-            };
+            inline size_t NodeImp::KeySize(size_t index) const
+            {
+                return m_Items[index]->keySize;
+            }
 
-            CPL_INLINE String ErrorInvalidCharacter() { return "Invalid character found."; }
-            CPL_INLINE String ErrorKeyMissing() { return "Missing key."; }
-            CPL_INLINE String ErrorKeyIncorrect() { return "Incorrect key."; }
-            CPL_INLINE String ErrorValueIncorrect() { return "Incorrect value."; }
-            CPL_INLINE String ErrorTabInOffset() { return "Tab found in offset."; }
-            CPL_INLINE String ErrorBlockSequenceNotAllowed() { return "Sequence entries are not allowed in this context."; }
-            CPL_INLINE String ErrorUnexpectedDocumentEnd() { return "Unexpected document end."; }
-            CPL_INLINE String ErrorDiffEntryNotAllowed() { return "Different entry is not allowed in this context."; }
-            CPL_INLINE String ErrorIncorrectOffset() { return "Incorrect offset."; }
-            CPL_INLINE String ErrorSequenceError() { return "Error in sequence node."; }
-            CPL_INLINE String ErrorCannotOpenFile() { return "Cannot open file."; }
-            CPL_INLINE String ErrorIndentation() { return "Space indentation is less than 2."; }
-            CPL_INLINE String ErrorInvalidBlockScalar() { return "Invalid block scalar."; }
-            CPL_INLINE String ErrorInvalidQuote() { return "Invalid quote."; }
-        }
+            inline const std::string& NodeImp::KeyString(size_t index) const
+            {
+                return m_Items[index]->KeyString();
+            }
 
-        //-----------------------------------------------------------------------------------------
+            inline Node* NodeImp::Insert(size_t index)
+            {
+                if (m_Count == m_ItemsCapacity)
+                {
+                    size_t capacity = m_ItemsCapacity ? m_ItemsCapacity * 2 : 4;
+                    NodeHolder** items = static_cast<NodeHolder**>(m_pArena->Allocate(capacity * sizeof(NodeHolder*)));
+                    if (m_Count)
+                        memcpy(items, m_Items, m_Count * sizeof(NodeHolder*));
+                    if (m_ItemsCapacity)
+                        m_pArena->Free(m_Items, m_ItemsCapacity * sizeof(NodeHolder*));
+                    m_Items = items;
+                    m_ItemsCapacity = capacity;
+                }
+                index = std::min(index, m_Count);
+                if (index < m_Count)
+                    memmove(m_Items + index + 1, m_Items + index, (m_Count - index) * sizeof(NodeHolder*));
+                NodeHolder* pHolder = new (m_pArena->Allocate(sizeof(NodeHolder))) NodeHolder(m_pArena, this);
+                m_Items[index] = pHolder;
+                m_Count++;
+                return &pHolder->node;
+            }
 
-        class ReaderLine;
+            inline void NodeImp::Erase(size_t index)
+            {
+                std::vector<std::pair<NodeImp*, bool>> stack;
+                ReleaseHolder(m_Items[index], stack);
+                Remove(index);
+                Release(stack);
+            }
 
-        std::string ExceptionMessage(const std::string& message, ReaderLine& line);
-        std::string ExceptionMessage(const std::string& message, ReaderLine& line, const size_t errorPos);
-        std::string ExceptionMessage(const std::string& message, const size_t errorLine, const size_t errorPos);
-        std::string ExceptionMessage(const std::string& message, const size_t errorLine, const std::string& data);
+            inline void NodeImp::Remove(size_t index)
+            {
+                memmove(m_Items + index, m_Items + index + 1, (m_Count - index - 1) * sizeof(NodeHolder*));
+                m_Count--;
+            }
 
-        bool FindQuote(const std::string& input, size_t& start, size_t& end, size_t searchPos = 0);
-        size_t FindNotCited(const std::string& input, char token, size_t& preQuoteCount);
-        size_t FindNotCited(const std::string& input, char token);
-        bool ValidateQuote(const std::string& input);
-        void CopyNode(const Node& from, Node& to);
-        bool ShouldBeCited(const std::string& key);
-        void AddEscapeTokens(std::string& input, const std::string& tokens);
-        void RemoveAllEscapeTokens(std::string& input);
+            inline bool NodeImp::IsShared(size_t index) const
+            {
+                return m_Items[index]->node.m_pImp != &m_Items[index]->imp;
+            }
 
-        //-----------------------------------------------------------------------------------------
+            inline void NodeImp::Share(size_t index, NodeImp* pShared)
+            {
+                NodeHolder* pHolder = m_Items[index];
+                pHolder->node.m_pImp = pShared ? pShared : &pHolder->imp;
+                if (pShared)
+                    pShared->m_Shared = true;
+            }
 
-        inline Iterator::Iterator() :
-            m_Type(None),
-            m_pImp(nullptr)
-        {
-        }
+            inline void NodeImp::Release()
+            {
+                std::vector<std::pair<NodeImp*, bool>> stack;
+                for (size_t i = 0; i < m_Count; ++i)
+                    ReleaseHolder(m_Items[i], stack);
+                FreeBuffers();
+                Reset();
+                Release(stack);
+            }
 
-        inline Iterator::~Iterator()
-        {
-            if (m_pImp)
+            inline void NodeImp::ReleaseHolder(NodeHolder* pHolder, std::vector<std::pair<NodeImp*, bool>>& stack)
             {
-                switch (m_Type)
+                NodeImp* pImp = (NodeImp*)pHolder->node.m_pImp;
+                const bool free = pHolder->imp.m_Shared == false;
+                if (pImp->m_Shared == false && pImp->m_pOwner == pHolder)
                 {
-                case SequenceType:
-                    delete static_cast<Detail::SequenceIteratorImp*>(m_pImp);
-                    break;
-                case MapType:
-                    delete static_cast<Detail::MapIteratorImp*>(m_pImp);
-                    break;
-                default:
-                    break;
+                    stack.push_back(std::make_pair(pImp, free));
+                    return;
                 }
-
+                if (pImp->m_pOwner == pHolder)
+                    pImp->m_pOwner = nullptr;
+                if (free)
+                    pHolder->Free();
             }
-        }
 
-        inline Iterator::Iterator(const Iterator& it) :
-            m_Type(None),
-            m_pImp(nullptr)
-        {
-            *this = it;
-        }
+            inline void NodeImp::Release(std::vector<std::pair<NodeImp*, bool>>& stack)
+            {
+                while (stack.size())
+                {
+                    NodeImp* pImp = stack.back().first;
+                    const bool free = stack.back().second;
+                    stack.pop_back();
+                    for (size_t i = 0; i < pImp->m_Count; ++i)
+                        ReleaseHolder(pImp->m_Items[i], stack);
+                    pImp->FreeBuffers();
+                    NodeHolder* pHolder = pImp->m_pOwner;
+                    if (pImp != &pHolder->imp)
+                        pImp->m_pArena->Free(pImp, sizeof(NodeImp));
+                    if (free)
+                        pHolder->Free();
+                }
+            }
 
-        inline Iterator& Iterator::operator = (const Iterator& it)
-        {
-            if (m_pImp)
+            inline void NodeImp::Assign(const NodeImp& from)
             {
-                switch (m_Type)
+                Reset();
+                m_Type = from.m_Type;
+                m_Flow = from.m_Flow;
+                if (m_Type == Node::ScalarType)
                 {
-                case SequenceType:
-                    delete static_cast<Detail::SequenceIteratorImp*>(m_pImp);
-                    break;
-                case MapType:
-                    delete static_cast<Detail::MapIteratorImp*>(m_pImp);
-                    break;
-                default:
-                    break;
+                    // Value of a shared node is never changed, it is referred instead of copying.
+                    if (from.m_Shared)
+                    {
+                        m_Value = from.m_Value;
+                        m_Size = from.m_Size;
+                    }
+                    else
+                        SetValue(from.m_Value ? from.m_Value : "", from.m_Size);
+                    return;
+                }
+                if (from.m_Count == 0)
+                    return;
+                m_Items = static_cast<NodeHolder**>(m_pArena->Allocate(from.m_Count * sizeof(NodeHolder*)));
+                for (size_t i = 0; i < from.m_Count; ++i)
+                {
+                    NodeHolder* pFrom = from.m_Items[i];
+                    NodeHolder* pHolder = new (m_pArena->Allocate(sizeof(NodeHolder))) NodeHolder(m_pArena, this);
+                    pHolder->key = pFrom->key;
+                    pHolder->keySize = pFrom->keySize;
+                    pFrom->ownKey = false; // The key is referred by both holders.
+                    m_Items[i] = pHolder;
+                    Share(i, (NodeImp*)pFrom->node.m_pImp);
+                }
+                m_Count = from.m_Count;
+                m_ItemsCapacity = from.m_Count;
+                if (from.m_IndexSize)
+                {
+                    m_Index = static_cast<uint32_t*>(m_pArena->Allocate(from.m_IndexSize * sizeof(uint32_t)));
+                    memcpy(m_Index, from.m_Index, from.m_IndexSize * sizeof(uint32_t));
+                    m_IndexSize = from.m_IndexSize;
                 }
-                m_pImp = nullptr;
-                m_Type = None;
             }
 
-            Detail::IteratorImp* pNewImp = nullptr;
-
-            switch (it.m_Type)
+            inline void NodeImp::Take(NodeImp& from)
             {
-            case SequenceType:
-                m_Type = SequenceType;
-                pNewImp = new Detail::SequenceIteratorImp;
-                static_cast<Detail::SequenceIteratorImp*>(pNewImp)->m_Iterator = static_cast<Detail::SequenceIteratorImp*>(it.m_pImp)->m_Iterator;
-                break;
-            case MapType:
-                m_Type = MapType;
-                pNewImp = new Detail::MapIteratorImp;
-                static_cast<Detail::MapIteratorImp*>(pNewImp)->m_Iterator = static_cast<Detail::MapIteratorImp*>(it.m_pImp)->m_Iterator;
-                break;
-            default:
-                break;
+                m_Type = from.m_Type;
+                m_Flow = from.m_Flow;
+                m_Value = from.m_Value;
+                m_Size = from.m_Size;
+                m_Capacity = 0; // Value of a shared node can be referred by its copies: it is never written.
+                m_Items = from.m_Items;
+                m_Count = from.m_Count;
+                m_ItemsCapacity = from.m_ItemsCapacity;
+                m_Index = from.m_Index;
+                m_IndexSize = from.m_IndexSize;
+                m_Cached.store(CachedNone, std::memory_order_relaxed);
+                for (size_t i = 0; i < m_Count; ++i)
+                    m_Items[i]->parent = this;
+                from.Reset();
+                from.m_Type = Node::None;
             }
 
-            m_pImp = pNewImp;
-            return *this;
-        }
-
-        inline std::pair<const std::string&, Node&> Iterator::operator *()
-        {
-            switch (m_Type)
+            inline void NodeImp::Replace(const NodeImp& from)
             {
-            case SequenceType:
-                return { String(), *(static_cast<Detail::SequenceIteratorImp*>(m_pImp)->m_Iterator->second) };
-                break;
-            case MapType:
-                return { static_cast<Detail::MapIteratorImp*>(m_pImp)->m_Iterator->first,
-                        *(static_cast<Detail::MapIteratorImp*>(m_pImp)->m_Iterator->second) };
-                break;
-            default:
-                break;
+                NodeImp old(m_pArena, false, true);
+                const size_t capacity = m_Capacity;
+                old.Take(*this);
+                old.m_Capacity = capacity;
+                Assign(from);
+                old.Release();
             }
 
-            return { Detail::EmptyString(), Detail::EmptyNode() };
-        }
-
-        inline Iterator& Iterator::operator ++ (int dummy)
-        {
-            switch (m_Type)
+            inline void NodeImp::Unshare(NodeHolder* pHolder)
             {
-            case SequenceType:
-                static_cast<Detail::SequenceIteratorImp*>(m_pImp)->m_Iterator++;
-                break;
-            case MapType:
-                static_cast<Detail::MapIteratorImp*>(m_pImp)->m_Iterator++;
-                break;
-            default:
-                break;
+                NodeImp* pParent = pHolder->parent;
+                NodeHolder* pOwner = pParent->m_pOwner;
+                if (pOwner == nullptr || pOwner->node.m_pImp != pParent)
+                    return;
+                Unshare(pOwner);
+                if (pParent->m_Shared)
+                    pOwner->node.Detach(true);
             }
-            return *this;
-        }
 
-        inline Iterator& Iterator::operator -- (int dummy)
-        {
-            switch (m_Type)
+            inline bool NodeImp::Contains(const Node* pNode) const
             {
-            case SequenceType:
-                static_cast<Detail::SequenceIteratorImp*>(m_pImp)->m_Iterator--;
-                break;
-            case MapType:
-                static_cast<Detail::MapIteratorImp*>(m_pImp)->m_Iterator--;
-                break;
-            default:
-                break;
+                std::vector<const NodeImp*> stack(1, this);
+                while (stack.size())
+                {
+                    const NodeImp* pImp = stack.back();
+                    stack.pop_back();
+                    for (size_t i = 0; i < pImp->m_Count; ++i)
+                    {
+                        const Node& node = pImp->m_Items[i]->node;
+                        if (&node == pNode)
+                            return true;
+                        if (((NodeImp*)node.m_pImp)->m_Shared == false && ((NodeImp*)node.m_pImp)->m_Count)
+                            stack.push_back((NodeImp*)node.m_pImp);
+                    }
+                }
+                return false;
             }
-            return *this;
-        }
 
-        inline bool Iterator::operator == (const Iterator& it)
-        {
-            if (m_Type != it.m_Type)
+            inline void NodeImp::Merge(size_t index)
             {
-                return false;
+                const NodeImp* pValue = (const NodeImp*)Item(index).m_pImp;
+                const bool sequence = pValue->m_Type == Node::SequenceType;
+                for (size_t i = 0; sequence && i < pValue->Size(); ++i)
+                {
+                    if (((const NodeImp*)pValue->Item(i).m_pImp)->m_Type != Node::MapType)
+                        return;
+                }
+                if (sequence == false && pValue->m_Type != Node::MapType)
+                    return;
+                Remove(index);
+                if (m_IndexSize)
+                    Reindex(m_IndexSize);
+                const size_t count = m_Count;
+                for (size_t s = 0, n = sequence ? pValue->Size() : 1; s < n; ++s)
+                {
+                    const NodeImp* pSource = sequence ? (const NodeImp*)pValue->Item(s).m_pImp : pValue;
+                    for (size_t i = 0; i < pSource->Size(); ++i)
+                    {
+                        const size_t size = m_Count;
+                        Get(pSource->Key(i), pSource->KeySize(i));
+                        if (m_Count != size)
+                        {
+                            NodeImp* pShared = (NodeImp*)pSource->Item(i).m_pImp;
+                            pShared->m_Anchored = true;
+                            Share(m_Count - 1, pShared);
+                        }
+                    }
+                }
+                std::rotate(m_Items + index, m_Items + count, m_Items + m_Count);
+                if (m_IndexSize)
+                    Reindex(m_IndexSize);
             }
 
-            switch (m_Type)
+            inline Node* NodeImp::Get(const char* key, size_t size, bool view)
             {
-            case SequenceType:
-                return static_cast<Detail::SequenceIteratorImp*>(m_pImp)->m_Iterator == static_cast<Detail::SequenceIteratorImp*>(it.m_pImp)->m_Iterator;
-                break;
-            case MapType:
-                return static_cast<Detail::MapIteratorImp*>(m_pImp)->m_Iterator == static_cast<Detail::MapIteratorImp*>(it.m_pImp)->m_Iterator;
-                break;
-            default:
-                break;
+                size_t index = Find(key, size);
+                if (index != std::string::npos)
+                    return &Item(index);
+                Node* pNode = Insert(m_Count);
+                NodeHolder* pHolder = m_Items[m_Count - 1];
+                pHolder->key = view ? key : m_pArena->Copy(key, size);
+                pHolder->keySize = size;
+                pHolder->ownKey = !view;
+                if (m_Count > INDEX_MIN)
+                {
+                    if (m_Count * 2 > m_IndexSize)
+                    {
+                        size_t size = 16;
+                        while (size < m_Count * 4)
+                            size *= 2;
+                        Reindex(size);
+                    }
+                    else
+                        AddIndex(m_Count - 1);
+                }
+                return pNode;
             }
 
-            return false;
-        }
+            //-------------------------------------------------------------------------------------
 
-        inline bool Iterator::operator != (const Iterator& it)
-        {
-            return !(*this == it);
-        }
+            CPL_INLINE const char* ScalarData(const void* pImp, size_t& size)
+            {
+                const NodeImp* imp = (const NodeImp*)pImp;
+                size = imp->m_Size;
+                return imp->m_Type == Node::ScalarType ? (imp->m_Value ? imp->m_Value : "") : nullptr;
+            }
 
-        //-----------------------------------------------------------------------------------------
+            template<typename T, class Enable> struct ScalarConverter
+            {
+                static T Get(const void* pImp)
+                {
+                    size_t size;
+                    const char* data = ScalarData(pImp, size);
+                    return StringConverter<T>::Get(data ? std::string(data, size) : std::string());
+                }
 
-        inline ConstIterator::ConstIterator() :
-            m_Type(None),
-            m_pImp(nullptr)
-        {
-        }
+                static T Get(const void* pImp, const T& defaultValue)
+                {
+                    size_t size;
+                    const char* data = ScalarData(pImp, size);
+                    return StringConverter<T>::Get(data ? std::string(data, size) : std::string(), defaultValue);
+                }
+            };
 
-        inline ConstIterator::~ConstIterator()
-        {
-            if (m_pImp)
+            template<typename T> struct ScalarConverter<T, typename std::enable_if<std::is_arithmetic<T>::value && (sizeof(T) > 1) && !std::is_same<T, bool>::value>::type>
             {
-                switch (m_Type)
+                static T Get(const void* pImp)
                 {
-                case SequenceType:
-                    delete static_cast<Detail::SequenceConstIteratorImp*>(m_pImp);
-                    break;
-                case MapType:
-                    delete static_cast<Detail::MapConstIteratorImp*>(m_pImp);
-                    break;
-                default:
-                    break;
+                    T value = T();
+                    ((const NodeImp*)pImp)->Number(value);
+                    return value;
                 }
 
-            }
-        }
+                static T Get(const void* pImp, const T& defaultValue)
+                {
+                    T value;
+                    return ((const NodeImp*)pImp)->Number(value) ? value : defaultValue;
+                }
+            };
 
-        inline ConstIterator::ConstIterator(const ConstIterator& it) :
-            m_Type(None),
-            m_pImp(nullptr)
-        {
-            *this = it;
-        }
+            //-------------------------------------------------------------------------------------
 
-        inline ConstIterator& ConstIterator::operator = (const ConstIterator& it)
-        {
-            if (m_pImp)
+            /// Builds a node tree from parsing events. Aliases share the anchored nodes, merge keys are resolved at the end of map.
+            /// Scalars and keys which are in the retained input buffer are stored as views of it, others are copied to the arena.
+            class NodeBuilder : public Handler
             {
-                switch (m_Type)
+            public:
+                NodeBuilder(Node& root, const char* retained = nullptr, size_t retainedSize = 0)
+                    : m_pRoot((NodeImp*)root.m_pImp)
+                    , m_Index(0)
+                    , m_Retained(uintptr_t(retained))
+                    , m_RetainedSize(retained ? retainedSize : 0)
                 {
-                case SequenceType:
-                    delete static_cast<Detail::SequenceConstIteratorImp*>(m_pImp);
-                    break;
-                case MapType:
-                    delete static_cast<Detail::MapConstIteratorImp*>(m_pImp);
-                    break;
-                default:
-                    break;
                 }
-                m_pImp = nullptr;
-                m_Type = None;
-            }
 
-            Detail::IteratorImp* pNewImp = nullptr;
-
-            switch (it.m_Type)
-            {
-            case SequenceType:
-                m_Type = SequenceType;
-                pNewImp = new Detail::SequenceConstIteratorImp;
-                static_cast<Detail::SequenceConstIteratorImp*>(pNewImp)->m_Iterator = static_cast<Detail::SequenceConstIteratorImp*>(it.m_pImp)->m_Iterator;
-                break;
-            case MapType:
-                m_Type = MapType;
-                pNewImp = new Detail::MapConstIteratorImp;
-                static_cast<Detail::MapConstIteratorImp*>(pNewImp)->m_Iterator = static_cast<Detail::MapConstIteratorImp*>(it.m_pImp)->m_Iterator;
-                break;
-            default:
-                break;
-            }
+                bool MapStart() override
+                {
+                    Open(Node::MapType);
+                    return true;
+                }
 
-            m_pImp = pNewImp;
-            return *this;
-        }
+                void MapEnd() override
+                {
+                    while (m_Merges.size() && m_Merges.back() == m_Stack.size())
+                    {
+                        NodeImp* pTop = m_Stack.back();
+                        pTop->Merge(pTop->Find("<<", 2));
+                        m_Merges.pop_back();
+                    }
+                    Close();
+                }
 
-        inline std::pair<const std::string&, const Node&> ConstIterator::operator *()
-        {
-            switch (m_Type)
-            {
-            case SequenceType:
-                return { String(), *(static_cast<Detail::SequenceConstIteratorImp*>(m_pImp)->m_Iterator->second) };
-                break;
-            case MapType:
-                return { static_cast<Detail::MapConstIteratorImp*>(m_pImp)->m_Iterator->first,
-                        *(static_cast<Detail::MapConstIteratorImp*>(m_pImp)->m_Iterator->second) };
-                break;
-            default:
-                break;
-            }
+                bool SequenceStart() override
+                {
+                    Open(Node::SequenceType);
+                    return true;
+                }
 
-            return { Detail::EmptyString(), Detail::EmptyNode() };
-        }
+                void SequenceEnd() override
+                {
+                    Close();
+                }
 
-        inline ConstIterator& ConstIterator::operator ++ (int dummy)
+                bool FlowMapStart() override
+                {
+                    MapStart();
+                    m_Stack.back()->m_Flow = true;
+                    return true;
+                }
+
+                bool FlowSequenceStart() override
+                {
+                    SequenceStart();
+                    m_Stack.back()->m_Flow = true;
+                    return true;
+                }
+
+                bool Key(const char* data, size_t size) override
+                {
+                    NodeImp* pTop = m_Stack.back();
+                    const size_t count = pTop->Size();
+                    pTop->Get(data, size, Retained(data));
+                    m_Index = pTop->Size() != count ? count : pTop->Find(data, size);
+                    if (pTop->IsShared(m_Index))
+                    {
+                        pTop->Share(m_Index, nullptr);
+                    }
+                    if (size == 2 && data[0] == '<' && data[1] == '<')
+                    {
+                        m_Merges.push_back(m_Stack.size());
+                    }
+                    return true;
+                }
+
+                void Scalar(const char* data, size_t size) override
+                {
+                    NodeImp* pImp = Value();
+                    pImp->Init(Node::ScalarType, false);
+                    if (Retained(data))
+                        pImp->SetView(data, size);
+                    else
+                        pImp->SetValue(data, size);
+                    Define(pImp);
+                }
+
+                void Null() override
+                {
+                    Define(Value());
+                }
+
+                void Anchor(const char* data, size_t size) override
+                {
+                    m_Anchor.assign(data, size);
+                }
+
+                void Alias(const char* data, size_t size) override
+                {
+                    std::unordered_map<std::string, NodeImp*>::const_iterator it = m_Anchors.find(std::string(data, size));
+                    if (it == m_Anchors.end() || m_Stack.empty())
+                    {
+                        Null();
+                        return;
+                    }
+                    NodeImp* pTop = m_Stack.back();
+                    if (pTop->m_Type == Node::SequenceType)
+                    {
+                        pTop->Insert(pTop->Size());
+                        m_Index = pTop->Size() - 1;
+                    }
+                    it->second->m_Anchored = true;
+                    it->second->SetAnchor(data, size);
+                    pTop->Share(m_Index, it->second);
+                }
+
+            private:
+                bool Retained(const char* data) const
+                {
+                    return uintptr_t(data) - m_Retained < m_RetainedSize;
+                }
+
+                /// Node of the next value: root, new sequence element or value of the last key.
+                NodeImp* Value()
+                {
+                    if (m_Stack.empty())
+                        return m_pRoot;
+                    NodeImp* pTop = m_Stack.back();
+                    if (pTop->m_Type == Node::SequenceType)
+                        return (NodeImp*)pTop->Insert(pTop->Size())->m_pImp;
+                    return (NodeImp*)pTop->Item(m_Index).m_pImp;
+                }
+
+                void Open(Node::eType type)
+                {
+                    NodeImp* pImp = Value();
+                    pImp->Init(type, false);
+                    m_Stack.push_back(pImp);
+                    if (m_Anchor.size())
+                    {
+                        m_Open.push_back(std::make_pair(m_Stack.size(), m_Anchor));
+                        m_Anchor.clear();
+                    }
+                }
+
+                /// Anchor of collection is defined at its end, so it can't be aliased from inside.
+                void Close()
+                {
+                    if (m_Open.size() && m_Open.back().first == m_Stack.size())
+                    {
+                        m_Anchors[m_Open.back().second] = m_Stack.back();
+                        m_Open.pop_back();
+                    }
+                    m_Stack.pop_back();
+                }
+
+                void Define(NodeImp* pImp)
+                {
+                    if (m_Anchor.size())
+                    {
+                        m_Anchors[m_Anchor] = pImp;
+                        m_Anchor.clear();
+                    }
+                }
+
+                NodeImp* m_pRoot;
+                size_t m_Index;                     ///< Index of the value of the last key in current map.
+                uintptr_t m_Retained;               ///< Start of the retained input buffer.
+                size_t m_RetainedSize;
+                std::vector<NodeImp*> m_Stack;
+                std::vector<size_t> m_Merges;       ///< Stack depths of maps with merge keys.
+                std::string m_Anchor;               ///< Anchor of the next value.
+                std::vector<std::pair<size_t, std::string>> m_Open; ///< Anchors of unfinished collections.
+                std::unordered_map<std::string, NodeImp*> m_Anchors;
+            };
+
+            CPL_INLINE String ErrorInvalidCharacter() { return "Invalid character found."; }
+            CPL_INLINE String ErrorKeyMissing() { return "Missing key."; }
+            CPL_INLINE String ErrorKeyIncorrect() { return "Incorrect key."; }
+            CPL_INLINE String ErrorValueIncorrect() { return "Incorrect value."; }
+            CPL_INLINE String ErrorTabInOffset() { return "Tab found in offset."; }
+            CPL_INLINE String ErrorBlockSequenceNotAllowed() { return "Sequence entries are not allowed in this context."; }
+            CPL_INLINE String ErrorUnexpectedDocumentEnd() { return "Unexpected document end."; }
+            CPL_INLINE String ErrorDiffEntryNotAllowed() { return "Different entry is not allowed in this context."; }
+            CPL_INLINE String ErrorIncorrectOffset() { return "Incorrect offset."; }
+            CPL_INLINE String ErrorSequenceError() { return "Error in sequence node."; }
+            CPL_INLINE String ErrorCannotOpenFile() { return "Cannot open file."; }
+            CPL_INLINE String ErrorIndentation() { return "Space indentation is less than 2."; }
+            CPL_INLINE String ErrorInvalidBlockScalar() { return "Invalid block scalar."; }
+            CPL_INLINE String ErrorInvalidQuote() { return "Invalid quote."; }
+            CPL_INLINE String ErrorInvalidFlow() { return "Invalid flow collection."; }
+            CPL_INLINE String ErrorInvalidAnchor() { return "Invalid anchor or alias."; }
+            CPL_INLINE String ErrorUnknownAlias() { return "Unknown alias."; }
+            CPL_INLINE String ErrorInvalidPath() { return "Invalid path."; }
+            CPL_INLINE String ErrorBindingValue() { return "Invalid value."; }
+            CPL_INLINE String ErrorBindingMap() { return "Unexpected map."; }
+            CPL_INLINE String ErrorBindingSequence() { return "Unexpected sequence."; }
+            CPL_INLINE String ErrorBindingAlias() { return "Aliases are not supported."; }
+
+            //-------------------------------------------------------------------------------------
+
+            CPL_INLINE size_t FirstBit(int mask)
+            {
+#if defined(_MSC_VER)
+                unsigned long index;
+                _BitScanForward(&index, mask);
+                return index;
+#else
+                return __builtin_ctz(mask);
+#endif
+            }
+
+            /// Returns position of first character which is equal to a or b, or size if there are no such characters.
+            CPL_INLINE size_t FindFirstOf(const char* data, const size_t size, char a, char b)
+            {
+                size_t i = 0;
+#if defined(CPL_YAML_SSE2)
+                const __m128i _a = _mm_set1_epi8(a), _b = _mm_set1_epi8(b);
+                for (; i + 16 <= size; i += 16)
+                {
+                    __m128i value = _mm_loadu_si128((const __m128i*)(data + i));
+                    int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(value, _a), _mm_cmpeq_epi8(value, _b)));
+                    if (mask)
+                        return i + FirstBit(mask);
+                }
+#endif
+                for (; i < size; i++)
+                {
+                    if (data[i] == a || data[i] == b)
+                        return i;
+                }
+                return size;
+            }
+
+            /// Returns position of first flow indicator (one of ",:[]{}") or size.
+            CPL_INLINE size_t FindFlowIndicator(const char* data, const size_t size)
+            {
+                size_t i = 0;
+#if defined(CPL_YAML_SSE2)
+                const __m128i comma = _mm_set1_epi8(','), colon = _mm_set1_epi8(':');
+                const __m128i open = _mm_set1_epi8('['), close = _mm_set1_epi8(']'), fold = _mm_set1_epi8(~0x20);
+                for (; i + 16 <= size; i += 16)
+                {
+                    // '{' and '}' differ from '[' and ']' by bit 0x20 only.
+                    __m128i value = _mm_loadu_si128((const __m128i*)(data + i));
+                    __m128i folded = _mm_and_si128(value, fold);
+                    __m128i found = _mm_or_si128(_mm_cmpeq_epi8(value, comma), _mm_cmpeq_epi8(value, colon));
+                    found = _mm_or_si128(found, _mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)));
+                    int mask = _mm_movemask_epi8(found);
+                    if (mask)
+                        return i + FirstBit(mask);
+                }
+#endif
+                for (; i < size; i++)
+                {
+                    const char c = data[i];
+                    if (c == ',' || c == ':' || c == '[' || c == ']' || c == '{' || c == '}')
+                        return i;
+                }
+                return size;
+            }
+
+            /// Returns position of first character which is not allowed in a line (not tab and out of [32, 125]), or size.
+            CPL_INLINE size_t FindInvalidCharacter(const char* data, const size_t size)
+            {
+                size_t i = 0;
+#if defined(CPL_YAML_SSE2)
+                const __m128i tab = _mm_set1_epi8('\t'), min = _mm_set1_epi8(32), max = _mm_set1_epi8(125);
+                for (; i + 16 <= size; i += 16)
+                {
+                    __m128i value = _mm_loadu_si128((const __m128i*)(data + i));
+                    __m128i invalid = _mm_or_si128(_mm_andnot_si128(_mm_cmpeq_epi8(value, tab), _mm_cmplt_epi8(value, min)), _mm_cmpgt_epi8(value, max));
+                    int mask = _mm_movemask_epi8(invalid);
+                    if (mask)
+                        return i + FirstBit(mask);
+                }
+#endif
+                for (; i < size; i++)
+                {
+                    if (data[i] != '\t' && (data[i] < 32 || data[i] > 125))
+                        return i;
+                }
+                return size;
+            }
+
+            /*!
+            * \brief Tokens of a line found in one scanning pass, offsets of absent tokens are std::string::npos.
+            *
+            * Quotes are paired as in FindNotCited(): only not escaped '"' opens or closes a cited part, a not closed
+            * quote cites nothing. Tokens which follow the comment are ignored.
+            */
+            struct LineTokens
+            {
+                size_t Colon;           ///< First not cited ':'.
+                unsigned char Quotes;   ///< Number of cited parts before the colon, at most 2.
+                bool Quoted;            ///< Line has quotes ('"' or '\'').
+
+                LineTokens()
+                {
+                    Clear();
+                }
+
+                void Clear()
+                {
+                    Colon = std::string::npos;
+                    Quotes = 0;
+                    Quoted = false;
+                }
+
+                /// Scans the line, returns position of the first not cited '#' or std::string::npos.
+                /// Invalid is position of the first character which is not allowed in a line (see FindInvalidCharacter()).
+                size_t Scan(const char* data, const size_t size, size_t& invalid)
+                {
+                    const size_t none = std::string::npos;
+                    Clear();
+                    invalid = none;
+                    // Open quote and the first colon and comment inside it.
+                    size_t open = none, pendingColon = none, pendingQuotes = 0, pendingComment = none;
+                    size_t i = 0;
+#if defined(CPL_YAML_SSE2)
+                    const __m128i quote = _mm_set1_epi8('"'), apostrophe = _mm_set1_epi8('\''), hash = _mm_set1_epi8('#');
+                    const __m128i colon = _mm_set1_epi8(':');
+                    const __m128i tab = _mm_set1_epi8('\t'), min = _mm_set1_epi8(32), max = _mm_set1_epi8(125);
+                    for (; i + 16 <= size; i += 16)
+                    {
+                        __m128i value = _mm_loadu_si128((const __m128i*)(data + i));
+                        if (invalid == none)
+                        {
+                            __m128i bad = _mm_or_si128(_mm_andnot_si128(_mm_cmpeq_epi8(value, tab), _mm_cmplt_epi8(value, min)), _mm_cmpgt_epi8(value, max));
+                            int mask = _mm_movemask_epi8(bad);
+                            if (mask)
+                                invalid = i + FirstBit(mask);
+                        }
+                        __m128i found = _mm_or_si128(_mm_cmpeq_epi8(value, quote), _mm_cmpeq_epi8(value, apostrophe));
+                        found = _mm_or_si128(found, _mm_or_si128(_mm_cmpeq_epi8(value, hash), _mm_cmpeq_epi8(value, colon)));
+                        for (int mask = _mm_movemask_epi8(found); mask; mask &= mask - 1)
+                        {
+                            const size_t pos = i + FirstBit(mask);
+                            if (Token(data, pos, open, pendingColon, pendingQuotes, pendingComment))
+                                return pos;
+                        }
+                    }
+#endif
+                    for (; i < size; i++)
+                    {
+                        const char c = data[i];
+                        if (invalid == none && c != '\t' && (c < 32 || c > 125))
+                            invalid = i;
+                        if ((c == '"' || c == '\'' || c == '#' || c == ':') &&
+                            Token(data, i, open, pendingColon, pendingQuotes, pendingComment))
+                            return i;
+                    }
+                    if (open == none)
+                        return none;
+
+                    // The quote is not closed and cites nothing.
+                    if (pendingComment != none)
+                    {
+                        Scan(data, pendingComment, invalid);
+                        return pendingComment;
+                    }
+                    if (Colon == none)
+                    {
+                        Colon = pendingColon;
+                        Quotes = (unsigned char)pendingQuotes;
+                    }
+                    return none;
+                }
+
+                /// Moves tokens to the rest of the line after offset, rescans it if there are tokens before offset.
+                void Shift(const char* data, const size_t size, const size_t offset)
+                {
+                    const size_t none = std::string::npos;
+                    if (Colon < offset || (Quoted && FindFirstOf(data, offset, '"', '\'') < offset))
+                    {
+                        size_t invalid;
+                        Scan(data + offset, size - offset, invalid);
+                        return;
+                    }
+                    Colon = Colon == none ? none : Colon - offset;
+                }
+
+            private:
+                /// Handles a token at pos, returns true at the comment.
+                bool Token(const char* data, const size_t pos, size_t& open, size_t& pendingColon, size_t& pendingQuotes, size_t& pendingComment)
+                {
+                    const size_t none = std::string::npos;
+                    switch (data[pos])
+                    {
+                    case '#':
+                        if (open == none)
+                            return true;
+                        if (pendingComment == none)
+                            pendingComment = pos;
+                        break;
+                    case ':':
+                        if (Colon != none)
+                            break;
+                        if (open == none)
+                            Colon = pos;
+                        else if (pendingColon == none)
+                        {
+                            pendingColon = pos;
+                            pendingQuotes = Quotes;
+                        }
+                        break;
+                    default:
+                        Quoted = true;
+                        if (data[pos] == '"' && (pos == 0 || data[pos - 1] != '\\'))
+                        {
+                            if (open == none)
+                                open = pos;
+                            else
+                            {
+                                open = pendingColon = pendingComment = none;
+                                if (Colon == none && Quotes < 2)
+                                    Quotes++;
+                            }
+                        }
+                        break;
+                    }
+                    return false;
+                }
+            };
+        }
+
+        //-----------------------------------------------------------------------------------------
+
+        /*!
+        * \brief YAML document: the node tree of a document and the arena which owns all its nodes and strings.
+        *
+        * Root() is a view of the tree with the usual Node interface. Clear() and reparsing release the whole tree
+        * at once and reuse the largest memory block of the arena. Nodes copied out of the document share its
+        * subtrees copy-on-write and keep the memory of this parse alive after clearing or reparsing of the document.
+        */
+        class Document
+        {
+        public:
+            Document();
+
+            Node& Root();
+            const Node& Root() const;
+
+            void Parse(const char* buffer, const size_t size);
+            void Parse(const std::string& string);
+            void Parse(std::istream& stream);
+
+            /// The file is mapped to memory (read if it can't be mapped) for the lifetime of the tree,
+            /// scalars and keys refer to it instead of copying. The file must not be changed while the tree is used.
+            void Parse(const char* filename);
+
+            /// Parses the buffer which is kept unchanged by the caller while the tree and its copies are used:
+            /// single line scalars and keys refer to it instead of copying.
+            void ParseInPlace(const char* buffer, const size_t size);
+
+            /// Parses a root block map or sequence by chunks of its entries in several threads (the number of hardware
+            /// threads if it is 0). Chunks are parsed to own arenas, their nodes are shared by the root (copy-on-write).
+            /// The tree is the same as after Parse(): inputs which can't be split exactly are parsed serially.
+            void ParseParallel(const char* buffer, const size_t size, size_t threads = 0);
+
+            /// Parsing which doesn't throw exceptions: the error is returned (the document is cleared if the input is invalid).
+            Status TryParse(const char* buffer, const size_t size);
+            Status TryParse(const std::string& string);
+            Status TryParse(std::istream& stream);
+            Status TryParse(const char* filename);
+
+            void Clear();
+
+            /// Size of memory reserved by the arena.
+            size_t Reserved() const;
+
+        private:
+            friend class IncrementalDocument;
+
+            static const size_t PARALLEL_CHUNK_MIN = 256 * 1024; ///< Minimal size of chunk for automatic number of threads.
+
+            Document(const Document&);
+            Document& operator = (const Document&);
+
+            bool Merge(const std::vector<const Node*>& chunks, Node::eType type);
+
+            Detail::Arena m_Arena;
+            Detail::NodeImp m_Imp;
+            Node m_Root;
+        };
+
+        //-----------------------------------------------------------------------------------------
+
+        /*!
+        * \brief Compiled path of nodes, like "a.b[3].c": map keys are separated by '.', sequence indices are in brackets,
+        * keys with special characters are quoted in brackets (["a.b"]). Wildcard '*' (or [*]) matches all elements.
+        *
+        * Resolving doesn't change the tree. Found nodes are stable handles: they stay valid until the node or its ancestor
+        * is erased, cleared or assigned, also after copy-on-write changes of the tree.
+        */
+        class Path
+        {
+        public:
+            /// Empty path, it matches the root.
+            Path();
+
+            /// Throws OperationException if the path is invalid (aborts if exceptions are disabled, use TryCompile()).
+            Path(const std::string& path);
+
+            /// Replaces the path, an invalid path is reported by the status (the error column is set) and leaves it empty.
+            Status TryCompile(const std::string& path);
+
+            /// The first matching node or nullptr.
+            const Node* Find(const Node& root) const;
+
+            /// The first matching node which can be changed (shared nodes on its path are copied) or nullptr.
+            Node* Find(Node& root) const;
+
+            /// Appends all matching nodes in the document order.
+            void Select(const Node& root, std::vector<const Node*>& nodes) const;
+
+        private:
+            friend class PathSet;
+
+            struct Step
+            {
+                enum Kind
+                {
+                    Key,
+                    Index,
+                    Any
+                } kind;
+                std::string key;
+                size_t index;
+
+                bool operator == (const Step& step) const
+                {
+                    return kind == step.kind && index == step.index && key == step.key;
+                }
+            };
+
+            /// Range of element indices which match the step.
+            static void Range(const Detail::NodeImp* pImp, const Step& step, size_t& begin, size_t& end);
+
+            void Select(const Node& node, size_t step, std::vector<const Node*>* pNodes, const Node** ppFirst) const;
+
+            /// Finds the first matching node, indices of elements on its path are appended.
+            bool Find(const Node& node, size_t step, std::vector<size_t>& indices) const;
+
+            std::vector<Step> m_Steps;
+        };
+
+        /// Set of paths which are resolved in one traversal of the tree, common prefixes of paths are resolved once.
+        class PathSet
+        {
+        public:
+            PathSet();
+
+            /// Returns index of the path in results of Select().
+            size_t Add(const Path& path);
+
+            /// Finds nodes of all paths: results[i] are nodes of the i-th path in the document order.
+            void Select(const Node& root, std::vector<std::vector<const Node*>>& results) const;
+
+        private:
+            /// Step of the prefix tree of paths.
+            struct Entry
+            {
+                Path::Step step;
+                std::vector<size_t> children;
+                std::vector<size_t> paths;  ///< Paths which end at this step.
+            };
+
+            void Select(const Node& node, const Entry& entry, std::vector<std::vector<const Node*>>& results) const;
+
+            std::vector<Entry> m_Entries;
+            size_t m_Count;
+        };
+
+        //-----------------------------------------------------------------------------------------
+
+        class ReaderLine;
+
+        std::string ExceptionMessage(const std::string& message, const ReaderLine& line);
+        std::string ExceptionMessage(const std::string& message, const ReaderLine& line, const size_t errorPos);
+        std::string ExceptionMessage(const std::string& message, const size_t errorLine, const size_t errorPos);
+        std::string ExceptionMessage(const std::string& message, const size_t errorLine, const std::string& data);
+
+        bool FindQuote(const char* input, const size_t size, size_t& start, size_t& end, size_t searchPos = 0);
+        bool FindQuote(const std::string& input, size_t& start, size_t& end, size_t searchPos = 0);
+        size_t FindNotCited(const char* input, const size_t size, char token, size_t& preQuoteCount);
+        size_t FindNotCited(const char* input, const size_t size, char token);
+        size_t FindNotCited(const std::string& input, char token, size_t& preQuoteCount);
+        size_t FindNotCited(const std::string& input, char token);
+        bool ValidateQuote(const char* input, const size_t size);
+        bool ValidateQuote(const std::string& input);
+        void CopyNode(const Node& from, Node& to);
+        bool ShouldBeCited(const std::string& key);
+        void AddEscapeTokens(std::string& input, const std::string& tokens);
+        void RemoveAllEscapeTokens(std::string& input);
+
+        //-----------------------------------------------------------------------------------------
+
+        inline Iterator::Iterator() :
+            m_Type(None),
+            m_pImp(nullptr),
+            m_Index(0)
+        {
+        }
+
+        inline Iterator::~Iterator()
+        {
+        }
+
+        inline Iterator::Iterator(const Iterator& it) :
+            m_Type(it.m_Type),
+            m_pImp(it.m_pImp),
+            m_Index(it.m_Index)
+        {
+        }
+
+        inline Iterator& Iterator::operator = (const Iterator& it)
+        {
+            m_Type = it.m_Type;
+            m_pImp = it.m_pImp;
+            m_Index = it.m_Index;
+            return *this;
+        }
+
+        inline std::pair<const std::string&, Node&> Iterator::operator *()
         {
+            const Detail::NodeImp* pImp = static_cast<const Detail::NodeImp*>(m_pImp);
             switch (m_Type)
             {
             case SequenceType:
-                static_cast<Detail::SequenceConstIteratorImp*>(m_pImp)->m_Iterator++;
-                break;
+                return { Detail::EmptyString(), pImp->Item(m_Index) };
             case MapType:
-                static_cast<Detail::MapConstIteratorImp*>(m_pImp)->m_Iterator++;
-                break;
+                return { pImp->KeyString(m_Index), pImp->Item(m_Index) };
             default:
                 break;
             }
+
+            return { Detail::EmptyString(), Detail::EmptyNode() };
+        }
+
+        inline Iterator& Iterator::operator ++ (int dummy)
+        {
+            if (m_Type != None)
+                m_Index++;
+            return *this;
+        }
+
+        inline Iterator& Iterator::operator -- (int dummy)
+        {
+            if (m_Type != None)
+                m_Index--;
             return *this;
         }
 
-        inline ConstIterator& ConstIterator::operator -- (int dummy)
+        inline bool Iterator::operator == (const Iterator& it)
+        {
+            if (m_Type != it.m_Type)
+            {
+                return false;
+            }
+
+            return m_pImp == it.m_pImp && m_Index == it.m_Index;
+        }
+
+        inline bool Iterator::operator != (const Iterator& it)
+        {
+            return !(*this == it);
+        }
+
+        //-----------------------------------------------------------------------------------------
+
+        inline ConstIterator::ConstIterator() :
+            m_Type(None),
+            m_pImp(nullptr),
+            m_Index(0)
+        {
+        }
+
+        inline ConstIterator::~ConstIterator()
+        {
+        }
+
+        inline ConstIterator::ConstIterator(const ConstIterator& it) :
+            m_Type(it.m_Type),
+            m_pImp(it.m_pImp),
+            m_Index(it.m_Index)
+        {
+        }
+
+        inline ConstIterator& ConstIterator::operator = (const ConstIterator& it)
+        {
+            m_Type = it.m_Type;
+            m_pImp = it.m_pImp;
+            m_Index = it.m_Index;
+            return *this;
+        }
+
+        inline std::pair<const std::string&, const Node&> ConstIterator::operator *()
+        {
+            const Detail::NodeImp* pImp = static_cast<const Detail::NodeImp*>(m_pImp);
+            switch (m_Type)
+            {
+            case SequenceType:
+                return { Detail::EmptyString(), pImp->Item(m_Index) };
+            case MapType:
+                return { pImp->KeyString(m_Index), pImp->Item(m_Index) };
+            default:
+                break;
+            }
+
+            return { Detail::EmptyString(), Detail::EmptyNode() };
+        }
+
+        inline ConstIterator& ConstIterator::operator ++ (int dummy)
+        {
+            if (m_Type != None)
+                m_Index++;
+            return *this;
+        }
+
+        inline ConstIterator& ConstIterator::operator -- (int dummy)
+        {
+            if (m_Type != None)
+                m_Index--;
+            return *this;
+        }
+
+        inline bool ConstIterator::operator == (const ConstIterator& it)
+        {
+            if (m_Type != it.m_Type)
+            {
+                return false;
+            }
+
+            return m_pImp == it.m_pImp && m_Index == it.m_Index;
+        }
+
+        inline bool ConstIterator::operator != (const ConstIterator& it)
+        {
+            return !(*this == it);
+        }
+
+        //-----------------------------------------------------------------------------------------
+
+        inline Node::Node(bool none) 
+            : m_pImp(new Detail::NodeImp(new Detail::Arena(), true, false))
+            , m_pArena(((Detail::NodeImp*)m_pImp)->m_pArena)
+            , m_pHolder(nullptr)
+        {
+            if (none)
+                Clear();
+        }
+
+        inline Node::Node(Detail::NodeImp* pImp)
+            : m_pImp(pImp)
+            , m_pArena(pImp->m_pArena)
+            , m_pHolder(nullptr)
+        {
+        }
+
+        inline Node::Node(const Node& node)
+            : Node()
+        {
+            *this = node;
+        }
+
+        inline Node::Node(const std::string& value) :
+            Node()
+        {
+            *this = value;
+        }
+
+        inline Node::Node(const char* value) :
+            Node()
+        {
+            *this = value;
+        }
+
+        inline Node::~Node()
+        {
+            if (((Detail::NodeImp*)m_pImp)->m_Embedded == false)
+            {
+                delete m_pArena;
+                delete ((Detail::NodeImp*)m_pImp);
+            }
+        }
+
+        inline Detail::NodeImp* Node::Mutable(bool copy)
+        {
+            if (m_pHolder)
+                Detail::NodeImp::Unshare(m_pHolder);
+            return Detach(copy);
+        }
+
+        inline Detail::NodeImp* Node::Detach(bool copy)
+        {
+            Detail::NodeImp* pImp = (Detail::NodeImp*)m_pImp;
+            if (pImp->m_Shared == false)
+                return pImp;
+            Detail::NodeImp* pCopy = new (m_pArena->Allocate(sizeof(Detail::NodeImp))) Detail::NodeImp(m_pArena, false, true);
+            pCopy->m_pOwner = m_pHolder;
+            if (m_pHolder && pImp->m_pOwner == m_pHolder)
+            {
+                // References to the children belong to this tree (also when they are replaced): the children
+                // are moved to the copy and the shared node gets their copy-on-write snapshot.
+                pCopy->Take(*pImp);
+                pImp->Assign(*pCopy);
+                pImp->m_pOwner = nullptr;
+            }
+            else if (copy)
+                pCopy->Assign(*pImp);
+            m_pImp = pCopy;
+            return pCopy;
+        }
+
+        inline Node::eType Node::Type() const
+        {
+            return ((Detail::NodeImp*)m_pImp)->m_Type;
+        }
+
+        inline bool Node::IsNone() const
+        {
+            return ((Detail::NodeImp*)m_pImp)->m_Type == Node::None;
+        }
+
+        inline bool Node::IsSequence() const
+        {
+            return ((Detail::NodeImp*)m_pImp)->m_Type == Node::SequenceType;
+        }
+
+        inline bool Node::IsMap() const
+        {
+            return ((Detail::NodeImp*)m_pImp)->m_Type == Node::MapType;
+        }
+
+        inline bool Node::IsScalar() const
+        {
+            return ((Detail::NodeImp*)m_pImp)->m_Type == Node::ScalarType;
+        }
+
+        inline bool Node::IsFlow() const
+        {
+            return ((Detail::NodeImp*)m_pImp)->m_Flow;
+        }
+
+        inline void Node::SetFlow(bool flow)
+        {
+            Mutable(true)->m_Flow = flow;
+        }
+
+        inline void Node::Clear()
+        {
+            Mutable(false)->Clear();
+        }
+
+        inline size_t Node::Size() const
+        {
+            return ((Detail::NodeImp*)m_pImp)->Size();
+        }
+
+        inline Node& Node::Insert(const size_t index)
+        {
+            Detail::NodeImp* pImp = Mutable(true);
+            pImp->Init(Node::SequenceType);
+            return *pImp->Insert(index);
+        }
+
+        inline Node& Node::PushFront()
+        {
+            Detail::NodeImp* pImp = Mutable(true);
+            pImp->Init(Node::SequenceType);
+            return *pImp->Insert(0);
+        }
+
+        inline Node& Node::PushBack()
+        {
+            Detail::NodeImp* pImp = Mutable(true);
+            pImp->Init(Node::SequenceType);
+            return *pImp->Insert(pImp->Size());
+        }
+
+        inline const Node& Node::operator[](const size_t index) const
+        {
+            const Detail::NodeImp* pImp = (Detail::NodeImp*)m_pImp;
+            if (pImp->m_Type != Node::SequenceType || index >= pImp->Size())
+                return Detail::EmptyNode();
+            return pImp->Item(index);
+        }
+
+        inline const Node& Node::operator[](const std::string& key) const
+        {
+            const Node* pNode = Find(key);
+            return pNode ? *pNode : Detail::EmptyNode();
+        }
+
+        inline Node* Node::Find(const std::string& key)
+        {
+            Mutable(true);
+            return const_cast<Node*>(static_cast<const Node*>(this)->Find(key));
+        }
+
+        inline const Node* Node::Find(const std::string& key) const
+        {
+            const Detail::NodeImp* pImp = (Detail::NodeImp*)m_pImp;
+            if (pImp->m_Type != Node::MapType)
+                return nullptr;
+            const size_t index = pImp->Find(key.data(), key.size());
+            return index == std::string::npos ? nullptr : &pImp->Item(index);
+        }
+
+        inline Node& Node::operator[](const size_t index)
+        {
+            Detail::NodeImp* pImp = Mutable(true);
+            pImp->Init(Node::SequenceType);
+            if (index >= pImp->Size())
+                return Detail::EmptyNode();
+            return pImp->Item(index);
+        }
+
+        inline Node& Node::operator[](const std::string& key)
+        {
+            Detail::NodeImp* pImp = Mutable(true);
+            pImp->Init(Node::MapType);
+            return *pImp->Get(key.data(), key.size());
+        }
+
+        inline void Node::Erase(const size_t index)
+        {
+            if (((Detail::NodeImp*)m_pImp)->m_Type != Node::SequenceType || index >= Size())
+                return;
+            Mutable(true)->Erase(index);
+        }
+
+        inline void Node::Erase(const std::string& key)
+        {
+            if (((Detail::NodeImp*)m_pImp)->m_Type != Node::MapType)
+                return;
+            Mutable(true)->Erase(key.data(), key.size());
+        }
+
+        inline Node& Node::operator = (const Node& node)
+        {
+            Detail::NodeImp* pFrom = (Detail::NodeImp*)node.m_pImp;
+            if (this == &node || pFrom == m_pImp)
+                return *this;
+            if (node.m_pArena == m_pArena)
+            {
+                // Old subtree stays in the arena, so the source can be a part of it. The node can't share its own ancestor.
+                if (pFrom->Contains(this))
+                {
+                    Node copy;
+                    CopyNode(node, copy);
+                    return *this = copy;
+                }
+                Mutable(false)->Replace(*pFrom);
+                return *this;
+            }
+            Detail::NodeImp* pImp = Mutable(false);
+            pImp->Clear();
+            if (pFrom->Size() || pFrom->m_Shared)
+            {
+                // Nodes of other tree are shared, its memory is borrowed. Mutual borrowing would never be released.
+                if (node.m_pArena->Borrows(*m_pArena))
+                {
+                    CopyNode(node, *this);
+                    return *this;
+                }
+                m_pArena->Borrow(*node.m_pArena);
+            }
+            pImp->Assign(*pFrom);
+            return *this;
+        }
+
+        inline Node& Node::operator = (const std::string& value)
+        {
+            Detail::NodeImp* pImp = Mutable(false);
+            pImp->Init(Node::ScalarType);
+            pImp->SetValue(value.data(), value.size());
+            return *this;
+        }
+
+        inline Node& Node::operator = (const char* value)
+        {
+            Detail::NodeImp* pImp = Mutable(false);
+            pImp->Init(Node::ScalarType);
+            pImp->SetValue(value ? value : "", value ? strlen(value) : 0);
+            return *this;
+        }
+
+        inline Iterator Node::Begin()
+        {
+            Mutable(true);
+            Iterator it;
+            switch (((Detail::NodeImp*)m_pImp)->m_Type)
+            {
+            case Node::SequenceType:
+                it.m_Type = Iterator::SequenceType;
+                it.m_pImp = m_pImp;
+                break;
+            case Node::MapType:
+                it.m_Type = Iterator::MapType;
+                it.m_pImp = m_pImp;
+                break;
+            default:
+                break;
+            }
+            return it;
+        }
+
+        inline ConstIterator Node::Begin() const
+        {
+            ConstIterator it;
+            switch (((Detail::NodeImp*)m_pImp)->m_Type)
+            {
+            case Node::SequenceType:
+                it.m_Type = ConstIterator::SequenceType;
+                it.m_pImp = m_pImp;
+                break;
+            case Node::MapType:
+                it.m_Type = ConstIterator::MapType;
+                it.m_pImp = m_pImp;
+                break;
+            default:
+                break;
+            }
+            return it;
+        }
+
+        inline Iterator Node::End()
+        {
+            Iterator it = Begin();
+            it.m_Index = Size();
+            return it;
+        }
+
+        inline ConstIterator Node::End() const
+        {
+            ConstIterator it = Begin();
+            it.m_Index = Size();
+            return it;
+        }
+
+        //-----------------------------------------------------------------------------------------
+
+        class ReaderLine
+        {
+        public:
+            ReaderLine(const char* data = nullptr, const size_t size = 0, const size_t no = 0,
+                const size_t offset = 0, const Node::eType type = Node::None,
+                const unsigned char flags = 0) 
+                : Data(data)
+                , Size(size)
+                , No(no)
+                , Offset(offset)
+                , Type(type)
+                , Flags(flags)
+                , Quotes(0)
+                , Quoted(false)
+                , Anchor(nullptr)
+                , AnchorSize(0)
+                , Colon(std::string::npos)
+            {
+            }
+
+            enum eFlag
+            {
+                LiteralScalarFlag,
+                FoldedScalarFlag,
+                ScalarNewlineFlag
+            };
+
+            void SetFlag(const eFlag flag)
+            {
+                Flags |= FlagMask(static_cast<size_t>(flag));
+            }
+
+            void SetFlags(const unsigned char flags)
+            {
+                Flags |= flags;
+            }
+
+            void UnsetFlag(const eFlag flag)
+            {
+                Flags &= ~FlagMask(static_cast<size_t>(flag));
+            }
+
+            void UnsetFlags(const unsigned char flags)
+            {
+                Flags &= ~flags;
+            }
+
+            bool GetFlag(const eFlag flag) const
+            {
+                return (Flags & FlagMask(static_cast<size_t>(flag))) != 0;
+            }
+
+            void CopyScalarFlags(const ReaderLine* from)
+            {
+                if (from == nullptr)
+                {
+                    return;
+                }
+                unsigned char newFlags = from->Flags & (FlagMask(0) | FlagMask(1) | FlagMask(2));
+                Flags |= newFlags;
+            }
+
+            std::string Str() const
+            {
+                return std::string(Data, Size);
+            }
+
+            /// Tokens of line content are found once by ReadLines() and kept in the line.
+            Detail::LineTokens Tokens() const
+            {
+                Detail::LineTokens tokens;
+                tokens.Colon = Colon;
+                tokens.Quotes = Quotes;
+                tokens.Quoted = Quoted;
+                return tokens;
+            }
+
+            void SetTokens(const Detail::LineTokens& tokens)
+            {
+                Colon = tokens.Colon;
+                Quotes = tokens.Quotes;
+                Quoted = tokens.Quoted;
+            }
+
+            static CPL_INLINE const unsigned char FlagMask(size_t index)
+            {
+                static const unsigned char flagMask[3] = { 0x01, 0x02, 0x04 };
+                return flagMask[index];
+            }
+
+            const char* Data;   ///< Line content (without indentation), points to parsed buffer.
+            size_t Size;        ///< Size of line content.
+            size_t No;
+            size_t Offset;
+            Node::eType Type;
+            unsigned char Flags;
+            unsigned char Quotes; ///< Number of cited parts before the colon, at most 2.
+            bool Quoted;        ///< Line content has quotes.
+            const char* Anchor; ///< Anchor of the value of map key or sequence entry.
+            size_t AnchorSize;
+            size_t Colon;       ///< First not cited ':' of line content.
+        };
+
+        //-----------------------------------------------------------------------------------------
+
+        class ParseImp
+        {
+        public:
+            ParseImp()
+                : m_Next(0)
+            {
+            }
+
+            /// A retained buffer is kept by the owner of the (already cleared) root while the tree is used:
+            /// single line scalars and keys refer to it.
+            void Parse(Node& root, const char* buffer, const size_t size, bool retained = false)
+            {
+                if (TryParse(root, buffer, size, retained) == false)
+                {
+                    Detail::Throw(m_Status);
+                }
+            }
+
+            void Parse(Handler& handler, const char* buffer, const size_t size)
+            {
+                if (TryParse(handler, buffer, size) == false)
+                {
+                    Detail::Throw(m_Status);
+                }
+            }
+
+            /// Parsing without exceptions, the error is given by LastStatus(). The root is cleared on error.
+            bool TryParse(Node& root, const char* buffer, const size_t size, bool retained = false)
+            {
+                if (retained == false)
+                {
+                    root.Clear();
+                }
+                Detail::NodeBuilder builder(root, retained ? buffer : nullptr, size);
+                if (TryParse(builder, buffer, size) == false)
+                {
+                    root.Clear();
+                    return false;
+                }
+                return true;
+            }
+
+            /// If continued is true, anchors of previously parsed buffers are kept: the buffer continues them.
+            bool TryParse(Handler& handler, const char* buffer, const size_t size, bool continued = false)
+            {
+                m_Status = Status();
+                if (ReadLines(buffer, size) == false || PostProcessLines() == false)
+                {
+                    return false;
+                }
+                //Print();
+                if (continued == false)
+                {
+                    m_Anchors.clear();
+                }
+                return ParseRoot(handler);
+            }
+
+            const Status& LastStatus() const
+            {
+                return m_Status;
+            }
+
+            /// Offset of the first byte after the parsed document (start of next document).
+            size_t Next() const
+            {
+                return m_Next;
+            }
+
+            /// Finds the end of the first document of a stream in the buffer, without parsing. Unlike Parse(), which skips
+            /// lines before the first "---", content before it is a document of the stream: the marker ends it.
+            /// Returns std::string::npos if the document is not terminated in complete lines of the buffer.
+            static size_t FindDocumentEnd(const char* buffer, const size_t size)
+            {
+                bool documentStartFound = false, contentFound = false;
+                for (size_t pos = 0; pos < size;)
+                {
+                    const char* line = buffer + pos;
+                    const char* lineEnd = static_cast<const char*>(memchr(line, '\n', size - pos));
+                    if (lineEnd == nullptr)
+                        break;
+                    size_t lineSize = lineEnd - line;
+                    const size_t commentPos = FindNotCited(line, lineSize, '#');
+                    if (commentPos != std::string::npos)
+                        lineSize = commentPos;
+                    if (documentStartFound == false && IsMarker(line, lineSize, '-'))
+                    {
+                        if (contentFound)
+                            return pos;
+                        documentStartFound = true;
+                    }
+                    else if (IsMarker(line, lineSize, '.'))
+                        return lineEnd + 1 - buffer;
+                    else if (IsMarker(line, lineSize, '-'))
+                        return pos;
+                    else if (documentStartFound == false && contentFound == false)
+                    {
+                        // Directives ("%YAML") belong to the next document.
+                        const size_t first = FindNotSpace(line, lineSize, 0);
+                        contentFound = first != std::string::npos && line[first] != '\r' && line[first] != '%';
+                    }
+                    pos = lineEnd + 1 - buffer;
+                }
+                return std::string::npos;
+            }
+
+            /// Splits the buffer to at most count chunks of top-level entries (lines without indentation) of the root block
+            /// map or sequence. Returns offsets of chunks (the first is 0, the last is size) or nothing if it can't be split.
+            static std::vector<size_t> SplitTopLevel(const char* buffer, const size_t size, const size_t count, Node::eType& type)
+            {
+                std::vector<size_t> bounds;
+
+                // Type of the root is given by its first line which must be not indented.
+                const char* end = buffer + size;
+                const char* line = buffer;
+                for (; line < end; line = NextLine(line, end))
+                {
+                    const size_t lineSize = LineSize(line, end);
+                    const size_t first = FindNotSpace(line, lineSize, 0);
+                    if (first != std::string::npos && line[first] != '#')
+                    {
+                        break;
+                    }
+                }
+                if (line == end)
+                {
+                    return bounds;
+                }
+                const size_t lineSize = LineSize(line, end);
+                if (IsMarker(line, std::min<size_t>(lineSize, 3), '-'))
+                {
+                    return bounds;
+                }
+                if (IsTopLevelEntry(line, lineSize, Node::SequenceType))
+                {
+                    type = Node::SequenceType;
+                }
+                else if (IsTopLevelEntry(line, lineSize, Node::MapType))
+                {
+                    type = Node::MapType;
+                }
+                else
+                {
+                    return bounds;
+                }
+
+                // Chunks start at the first entry after the equal parts of the buffer.
+                bounds.push_back(0);
+                for (size_t i = 1; i < count; ++i)
+                {
+                    for (line = NextLine(buffer + std::max(i * size / count, bounds.back()), end); line < end; line = NextLine(line, end))
+                    {
+                        if (IsTopLevelEntry(line, LineSize(line, end), type) && IsContinued(buffer, line) == false)
+                        {
+                            bounds.push_back(line - buffer);
+                            break;
+                        }
+                    }
+                }
+                bounds.push_back(size);
+                return bounds;
+            }
+
+            /// Chunk of top-level entries can be parsed separately: it has no document markers and merge keys of the root.
+            /// Not indented lines which are not entries and empty sequence entries take the next lines (also of the next
+            /// chunks) as their value, so they aren't allowed too.
+            static bool IsSplittable(const char* data, const size_t size, Node::eType type)
+            {
+                const char* end = data + size;
+                size_t open = std::string::npos;
+                for (const char* line = data; line < end; line = NextLine(line, end))
+                {
+                    const size_t lineSize = LineSize(line, end);
+                    if (lineSize >= 3 && (IsMarker(line, 3, '-') || IsMarker(line, 3, '.')))
+                    {
+                        return false;
+                    }
+                    if (type == Node::MapType && ((lineSize >= 2 && line[0] == '<' && line[1] == '<') || IsSequenceStart(line, lineSize)))
+                    {
+                        return false;
+                    }
+                    const size_t indent = FindNotSpace(line, lineSize, 0);
+                    if (indent == std::string::npos || line[indent] == '#')
+                    {
+                        continue;
+                    }
+                    if ((open != std::string::npos && indent <= open) || (indent == 0 && IsTopLevelEntry(line, lineSize, type) == false))
+                    {
+                        return false;
+                    }
+                    open = line[indent] == '-' && IsEmptyEntry(line + indent, lineSize - indent) ? indent : std::string::npos;
+                }
+                return true;
+            }
+
+            /// The last line with content before the line depends on the next lines regardless of their indentation:
+            /// it ends by an empty value, a sequence entry, an anchor, a tag or a block scalar indicator.
+            static bool IsContinued(const char* buffer, const char* line)
+            {
+                while (line > buffer)
+                {
+                    const char* lineEnd = line - 1;
+                    line = lineEnd;
+                    while (line > buffer && line[-1] != '\n')
+                        line--;
+                    size_t size = lineEnd - line;
+                    size = std::min(size, FindNotCited(line, size, '#'));
+                    while (size && (line[size - 1] == ' ' || line[size - 1] == '\t' || line[size - 1] == '\r'))
+                        size--;
+                    if (size == 0)
+                        continue;
+                    size_t token = size;
+                    while (token && line[token - 1] != ' ' && line[token - 1] != '\t')
+                        token--;
+                    return (size - token == 1 && line[token] == '-') || strchr("|>&!", line[token]) != nullptr || line[size - 1] == ':';
+                }
+                return false;
+            }
+
+        private:
+
+            ParseImp(const ParseImp& copy)
+            {
+            }
+
+            static bool IsMarker(const char* data, const size_t size, char token)
+            {
+                return size == 3 && data[0] == token && data[1] == token && data[2] == token;
+            }
+
+            static const char* NextLine(const char* line, const char* end)
+            {
+                const char* lineEnd = static_cast<const char*>(memchr(line, '\n', end - line));
+                return lineEnd ? lineEnd + 1 : end;
+            }
+
+            /// Size of the line without end of line.
+            static size_t LineSize(const char* line, const char* end)
+            {
+                const char* lineEnd = static_cast<const char*>(memchr(line, '\n', end - line));
+                size_t size = (lineEnd ? lineEnd : end) - line;
+                return size && line[size - 1] == '\r' ? size - 1 : size;
+            }
+
+            /// Sequence entry without a value or with an anchor only (the line starts with '-').
+            static bool IsEmptyEntry(const char* line, size_t size)
+            {
+                size = std::min(size, FindNotCited(line, size, '#'));
+                if (size > 1 && line[1] != ' ' && line[1] != '\t')
+                {
+                    return false;
+                }
+                const size_t value = FindNotSpace(line, size, 1);
+                if (value == std::string::npos)
+                {
+                    return true;
+                }
+                const size_t valueEnd = FindLastNotSpace(line, size);
+                return line[value] == '&' && memchr(line + value, ' ', valueEnd - value) == nullptr && memchr(line + value, '\t', valueEnd - value) == nullptr;
+            }
+
+            /// Not indented line which starts an entry of the root map or sequence.
+            static bool IsTopLevelEntry(const char* line, const size_t size, Node::eType type)
+            {
+                if (size == 0 || line[0] == ' ' || line[0] == '\t' || line[0] == '#')
+                {
+                    return false;
+                }
+                if (type == Node::SequenceType)
+                {
+                    return IsSequenceStart(line, size);
+                }
+                return IsSequenceStart(line, size) == false && strchr("[{&*!|>%@`?", line[0]) == nullptr &&
+                    FindNotCited(line, size, ':') != std::string::npos;
+            }
+
+            bool ReadLines(const char* buffer, const size_t size)
+            {
+                const char*     end = buffer + size;
+                const char*     next = nullptr;
+                size_t          lineNo = 0;
+                bool            documentStartFound = false;
+                bool            foundFirstNotEmpty = false;
+
+                m_Raw.clear();
+                m_Next = size;
+
+                // Split buffer to lines, the last line is the rest after the last '\n'.
+                for (const char* line = buffer; line != nullptr; line = next)
+                {
+                    const char* lineEnd = static_cast<const char*>(memchr(line, '\n', end - line));
+                    if (lineEnd == nullptr)
+                    {
+                        lineEnd = end;
+                        next = nullptr;
+                    }
+                    else
+                    {
+                        next = lineEnd + 1;
+                    }
+                    size_t lineSize = lineEnd - line;
+                    lineNo++;
+
+                    // Find all tokens and remove comment.
+                    Detail::LineTokens tokens;
+                    size_t invalidPos;
+                    const size_t commentPos = tokens.Scan(line, lineSize, invalidPos);
+                    if (commentPos != std::string::npos)
+                    {
+                        lineSize = commentPos;
+                    }
+
+                    // Start of document.
+                    if (documentStartFound == false && IsMarker(line, lineSize, '-'))
+                    {
+                        // Erase all lines before this line.
+                        m_Raw.clear();
+                        documentStartFound = true;
+                        continue;
+                    }
+
+                    // End of document.
+                    if (IsMarker(line, lineSize, '.'))
+                    {
+                        m_Next = next ? next - buffer : size;
+                        break;
+                    }
+                    else if (IsMarker(line, lineSize, '-'))
+                    {
+                        m_Next = line - buffer;
+                        break;
+                    }
+
+                    // Remove trailing return.
+                    if (lineSize && line[lineSize - 1] == '\r')
+                    {
+                        lineSize--;
+                    }
+
+                    // Validate characters.
+                    if (invalidPos < lineSize)
+                    {
+                        return Error(Exception::ParsingError, ExceptionMessage(Detail::ErrorInvalidCharacter(), lineNo, invalidPos + 1), lineNo, invalidPos + 1);
+                    }
+
+                    // Make sure no tabs are in the very front and remove front spaces.
+                    size_t startOffset = 0, firstTabPos = std::string::npos;
+                    for (; startOffset < lineSize && (line[startOffset] == ' ' || line[startOffset] == '\t'); startOffset++)
+                    {
+                        if (line[startOffset] == '\t' && firstTabPos == std::string::npos)
+                        {
+                            firstTabPos = startOffset;
+                        }
+                    }
+                    if (startOffset < lineSize)
+                    {
+                        if (firstTabPos != std::string::npos)
+                        {
+                            return Error(Exception::ParsingError, ExceptionMessage(Detail::ErrorTabInOffset(), lineNo, firstTabPos), lineNo, firstTabPos + 1);
+                        }
+                    }
+                    else
+                    {
+                        startOffset = 0;
+                        lineSize = 0;
+                    }
+
+                    // Add line.
+                    if (foundFirstNotEmpty == false)
+                    {
+                        if (lineSize)
+                        {
+                            foundFirstNotEmpty = true;
+                        }
+                        else
+                        {
+                            continue;
+                        }
+                    }
+
+                    m_Raw.push_back(ReaderLine(line + startOffset, lineSize - startOffset, lineNo, startOffset));
+                    if (lineSize)
+                    {
+                        tokens.Shift(line, lineSize, startOffset);
+                        m_Raw.back().SetTokens(tokens);
+                    }
+                }
+                return true;
+            }
+
+            bool PostProcessLines()
+            {
+                m_Lines.clear();
+                m_Lines.reserve(m_Raw.size() + m_Raw.size() / 2);
+                for (size_t i = 0; i < m_Raw.size() && m_Status.Failed == false;)
+                {
+                    ReaderLine line = m_Raw[i++];
+                    if (PostProcessSequenceLine(line, i))
+                        continue;
+                    if (IsFlowStart(line.Data, line.Size) == false && PostProcessMappingLine(line, i))
+                        continue;
+                    PostProcessScalarLine(line, i);
+                }
+                if (m_Status.Failed)
+                {
+                    return false;
+                }
+
+                if (m_Lines.size())
+                {
+                    if (m_Lines.back().Type != Node::ScalarType)
+                        return Error(Detail::ErrorUnexpectedDocumentEnd(), m_Lines.back());
+                }
+                return true;
+            }
+
+            /// Returns true if the line is handled (also on error).
+            bool PostProcessSequenceLine(ReaderLine& line, size_t& next)
+            {
+                // Sequence split
+                if (IsSequenceStart(line.Data, line.Size) == false)
+                {
+                    return false;
+                }
+
+                line.Type = Node::SequenceType;
+
+                SkipEmptyLines(next);
+
+                const size_t entryStart = FindNotSpace(line.Data, line.Size, 1);
+                const size_t valueStart = entryStart == std::string::npos ? entryStart : ReadAnchor(line, entryStart);
+                if (valueStart == std::string::npos)
+                {
+                    m_Lines.push_back(line);
+                    return true;
+                }
+
+                // Split value to new line, the anchor doesn't change offset of the value.
+                ReaderLine value(line.Data + valueStart, line.Size - valueStart, line.No, line.Offset + entryStart);
+                Detail::LineTokens tokens = line.Tokens();
+                tokens.Shift(line.Data, line.Size, valueStart);
+                value.SetTokens(tokens);
+                line.Size = 0;
+                m_Lines.push_back(line);
+                line = value;
+
+                return false;
+            }
+
+            /// Returns true if the line is handled (also on error).
+            bool PostProcessMappingLine(ReaderLine& line, size_t& next)
+            {
+                // Find map key.
+                const size_t preKeyQuotes = line.Quotes;
+                const size_t tokenPos = line.Colon;
+                if (tokenPos == std::string::npos)
+                {
+                    return false;
+                }
+                if (preKeyQuotes > 1)
+                {
+                    return Error(Detail::ErrorKeyIncorrect(), line) == false;
+                }
+
+                line.Type = Node::MapType;
+
+                // Get key
+                const char* key = line.Data;
+                const size_t keyEnd = FindLastNotSpace(key, tokenPos);
+                if (keyEnd == std::string::npos)
+                {
+                    return Error(Detail::ErrorKeyMissing(), line) == false;
+                }
+                size_t keySize = keyEnd + 1;
+
+                // Handle cited key. Escape tokens are removed when the key is inserted into the node.
+                if (preKeyQuotes == 1)
+                {
+                    if (key[0] != '"' || key[keySize - 1] != '"')
+                    {
+                        return Error(Detail::ErrorKeyIncorrect(), line) == false;
+                    }
+
+                    key += 1;
+                    keySize = keySize > 2 ? keySize - 2 : 0;
+                }
+
+                // Get value
+                const char* value = line.Data + line.Size;
+                size_t valueSize = 0;
+                size_t valueStart = std::string::npos;
+                if (tokenPos + 1 != line.Size)
+                {
+                    valueStart = FindNotSpace(line.Data, line.Size, tokenPos + 1);
+                    if (valueStart != std::string::npos)
+                    {
+                        valueStart = ReadAnchor(line, valueStart);
+                        if (m_Status.Failed)
+                        {
+                            return true;
+                        }
+                    }
+                    if (valueStart != std::string::npos)
+                    {
+                        value = line.Data + valueStart;
+                        valueSize = line.Size - valueStart;
+                    }
+                }
+
+                // Make sure the value is not a sequence start.
+                if (IsSequenceStart(value, valueSize) == true)
+                {
+                    return Error(Detail::ErrorBlockSequenceNotAllowed(), line, valueStart) == false;
+                }
+
+                line.Data = key;
+                line.Size = keySize;
+                m_Lines.push_back(line);
+
+                // Remove all empty lines after map key.
+                SkipEmptyLines(next);
+
+                // Add new empty line?
+                size_t newLineOffset = valueStart;
+                if (newLineOffset == std::string::npos)
+                {
+                    if (next < m_Raw.size() && m_Raw[next].Offset > line.Offset)
+                    {
+                        return true;
+                    }
+
+                    newLineOffset = tokenPos + 2;
+                }
+                else
+                {
+                    newLineOffset += line.Offset;
+                }
+
+                // Add new line with value.
+                unsigned char blockFlags = 0;
+                if (ReadBlockFlags(value, valueSize, line.No, newLineOffset + 1, blockFlags) == false)
+                {
+                    return true;
+                }
+                if (blockFlags)
+                {
+                    newLineOffset = line.Offset;
+                }
+                const bool quoted = line.Quoted && Detail::FindFirstOf(value, valueSize, '"', '\'') < valueSize;
+                line = ReaderLine(value, valueSize, line.No, newLineOffset, Node::ScalarType);
+                line.Quoted = quoted;
+
+                // Return false in order to handle next line(scalar value).
+                return false;
+            }
+
+            void PostProcessScalarLine(ReaderLine& line, size_t& next)
+            {
+                line.Type = Node::ScalarType;
+
+                const size_t parentOffset = m_Lines.empty() ? line.Offset : m_Lines.back().Offset;
+                m_Lines.push_back(line);
+                size_t lastNotEmpty = m_Lines.size();
+
+                // Unclosed flow collection takes following lines with any offset.
+                if (IsFlowStart(line.Data, line.Size))
+                {
+                    for (ptrdiff_t depth = FlowDepth(line.Data, line.Size); depth > 0 && next < m_Raw.size(); next++)
+                    {
+                        const ReaderLine& raw = m_Raw[next];
+                        depth += FlowDepth(raw.Data, raw.Size);
+                        m_Lines.push_back(raw);
+                        m_Lines.back().Type = Node::ScalarType;
+                        if (raw.Size)
+                        {
+                            lastNotEmpty = m_Lines.size();
+                        }
+                    }
+                }
+
+                // Take following lines which are deeper than parent, drop trailing empty lines.
+                for (; next < m_Raw.size(); next++)
+                {
+                    const ReaderLine& raw = m_Raw[next];
+                    if (raw.Size && raw.Offset <= parentOffset)
+                    {
+                        break;
+                    }
+                    m_Lines.push_back(raw);
+                    m_Lines.back().Type = Node::ScalarType;
+                    if (raw.Size)
+                    {
+                        lastNotEmpty = m_Lines.size();
+                    }
+                }
+
+                m_Lines.resize(lastNotEmpty);
+            }
+
+            bool ParseRoot(Handler& handler)
+            {
+                // Get first line and start type.
+                size_t it = 0;
+                if (it == m_Lines.size())
+                {
+                    return true;
+                }
+                const ReaderLine& line = m_Lines[it];
+
+                // Handle next line.
+                if (ParseValue(&handler, it) == false)
+                {
+                    return false;
+                }
+
+                if (it != m_Lines.size())
+                {
+                    return InternalError(Detail::ErrorUnexpectedDocumentEnd(), line);
+                }
+                return true;
+            }
+
+            /// Parses value at current line, a null handler skips it.
+            bool ParseValue(Handler* pHandler, size_t& it)
+            {
+                switch (m_Lines[it].Type)
+                {
+                case Node::SequenceType:
+                    return ParseSequence(pHandler, it);
+                case Node::MapType:
+                    return ParseMap(pHandler, it);
+                case Node::ScalarType:
+                    return ParseScalar(pHandler, it);
+                default:
+                    return true;
+                }
+            }
+
+            /// Parses value of map key or sequence entry with anchor of the line.
+            bool ParseAnchoredValue(Handler* pHandler, size_t& it, const ReaderLine& line)
+            {
+                if (line.AnchorSize == 0)
+                {
+                    return ParseValue(pHandler, it);
+                }
+                if (pHandler)
+                {
+                    pHandler->Anchor(line.Anchor, line.AnchorSize);
+                }
+                if (ParseValue(pHandler, it) == false)
+                {
+                    return false;
+                }
+                m_Anchors.insert(std::string(line.Anchor, line.AnchorSize));
+                return true;
+            }
+
+            /// Reads anchor (&name) at position of the line value, returns position of the rest of value or std::string::npos
+            /// (also on error).
+            size_t ReadAnchor(ReaderLine& line, size_t pos)
+            {
+                if (line.Data[pos] != '&')
+                {
+                    return pos;
+                }
+                const char* space = (const char*)memchr(line.Data + pos, ' ', line.Size - pos);
+                const size_t end = space ? space - line.Data : line.Size;
+                if (end == pos + 1)
+                {
+                    Error(Detail::ErrorInvalidAnchor(), line, pos + 1);
+                    return std::string::npos;
+                }
+                line.Anchor = line.Data + pos + 1;
+                line.AnchorSize = end - pos - 1;
+                return end == line.Size ? std::string::npos : FindNotSpace(line.Data, line.Size, end);
+            }
+
+            bool ParseSequence(Handler* pHandler, size_t& it)
+            {
+                if (pHandler && pHandler->SequenceStart() == false)
+                {
+                    pHandler = nullptr;
+                }
+                while (it < m_Lines.size())
+                {
+                    const ReaderLine& line = m_Lines[it];
+
+                    // Move to next line, error check.
+                    ++it;
+                    if (it == m_Lines.size())
+                    {
+                        return InternalError(Detail::ErrorUnexpectedDocumentEnd(), line);
+                    }
+
+                    // Handle value of sequence element
+                    if (ParseAnchoredValue(pHandler, it, line) == false)
+                    {
+                        return false;
+                    }
+
+                    if (it == m_Lines.size() || m_Lines[it].Offset < line.Offset)
+                    {
+                        break;
+                    }
+                    const ReaderLine& nextLine = m_Lines[it];
+                    if (nextLine.Offset > line.Offset)
+                    {
+                        return Error(Detail::ErrorIncorrectOffset(), nextLine);
+                    }
+                    if (nextLine.Type != Node::SequenceType)
+                    {
+                        return InternalError(Detail::ErrorDiffEntryNotAllowed(), nextLine);
+                    }
+                }
+                if (pHandler)
+                {
+                    pHandler->SequenceEnd();
+                }
+                return true;
+            }
+
+            bool ParseMap(Handler* pHandler, size_t& it)
+            {
+                if (pHandler && pHandler->MapStart() == false)
+                {
+                    pHandler = nullptr;
+                }
+                while (it < m_Lines.size())
+                {
+                    const ReaderLine& line = m_Lines[it];
+                    Handler* pChildHandler = pHandler;
+                    if (pHandler)
+                    {
+                        // Only a key with escape tokens is copied.
+                        const char* key = line.Data;
+                        size_t keySize = line.Size;
+                        if (memchr(key, '\\', keySize))
+                        {
+                            m_Key.assign(key, keySize);
+                            RemoveAllEscapeTokens(m_Key);
+                            key = m_Key.data();
+                            keySize = m_Key.size();
+                        }
+                        if (pHandler->Key(key, keySize) == false)
+                        {
+                            pChildHandler = nullptr;
+                        }
+                    }
+
+                    // Move to next line, error check.
+                    ++it;
+                    if (it == m_Lines.size())
+                    {
+                        return InternalError(Detail::ErrorUnexpectedDocumentEnd(), line);
+                    }
+
+                    // Handle value of map
+                    if (ParseAnchoredValue(pChildHandler, it, line) == false)
+                    {
+                        return false;
+                    }
+
+                    if (it == m_Lines.size() || m_Lines[it].Offset < line.Offset)
+                    {
+                        break;
+                    }
+                    const ReaderLine& nextLine = m_Lines[it];
+                    if (nextLine.Offset > line.Offset)
+                    {
+                        return Error(Detail::ErrorIncorrectOffset(), nextLine);
+                    }
+                    if (nextLine.Type != line.Type)
+                    {
+                        return InternalError(Detail::ErrorDiffEntryNotAllowed(), nextLine);
+                    }
+                }
+                if (pHandler)
+                {
+                    pHandler->MapEnd();
+                }
+                return true;
+            }
+
+            bool ParseScalar(Handler* pHandler, size_t& it)
+            {
+                // Skipped scalar: plain and block scalars are sequences of scalar lines.
+                if (pHandler == nullptr)
+                {
+                    do
+                    {
+                        ++it;
+                    } while (it < m_Lines.size() && m_Lines[it].Type == Node::ScalarType);
+                    return true;
+                }
+
+                std::string& data = m_Scalar;
+                data.clear();
+                const char* value = nullptr;
+                size_t valueSize = 0;
+                const ReaderLine* pFirstLine = &m_Lines[it];
+                const ReaderLine* pLine = pFirstLine;
+
+                if (pFirstLine->Size && pFirstLine->Data[0] == '*')
+                {
+                    return ParseAlias(*pHandler, it);
+                }
+
+                // Check if current line is a block scalar.
+                unsigned char blockFlags = 0;
+                if (ReadBlockFlags(pLine->Data, pLine->Size, pLine->No, pLine->Offset + 1, blockFlags) == false)
+                {
+                    return false;
+                }
+                const bool isBlockScalar = blockFlags != 0;
+                const bool newLineFlag = static_cast<bool>(blockFlags & ReaderLine::FlagMask(static_cast<size_t>(ReaderLine::ScalarNewlineFlag)));
+                const bool foldedFlag = static_cast<bool>(blockFlags & ReaderLine::FlagMask(static_cast<size_t>(ReaderLine::FoldedScalarFlag)));
+                const bool literalFlag = static_cast<bool>(blockFlags & ReaderLine::FlagMask(static_cast<size_t>(ReaderLine::LiteralScalarFlag)));
+                size_t parentOffset = 0;
+
+                // Find parent offset
+                if (it != 0)
+                {
+                    parentOffset = m_Lines[it - 1].Offset;
+                }
+
+                // Move to next iterator/line if current line is a block scalar.
+                if (isBlockScalar)
+                {
+                    ++it;
+                    if (it == m_Lines.size() || m_Lines[it].Type != Node::ScalarType)
+                    {
+                        pHandler->Null();
+                        return true;
+                    }
+                }
+
+                // Not a block scalar, cut end spaces/tabs
+                if (isBlockScalar == false)
+                {
+                    const bool flow = IsFlowStart(pFirstLine->Data, pFirstLine->Size);
+                    bool quoted = false;
+                    while (1)
+                    {
+                        pLine = &m_Lines[it];
+                        quoted = quoted || pLine->Quoted;
+
+                        if (parentOffset != 0 && pLine->Offset <= parentOffset && (flow == false || pLine == pFirstLine))
+                        {
+                            return Error(Detail::ErrorIncorrectOffset(), *pLine);
+                        }
+
+                        const size_t endOffset = FindLastNotSpace(pLine->Data, pLine->Size);
+
+                        // Move to next line
+                        ++it;
+                        const bool lastLine = it == m_Lines.size() || m_Lines[it].Type != Node::ScalarType;
+
+                        // Single line scalar is not copied.
+                        if (lastLine && pLine == pFirstLine && endOffset != std::string::npos)
+                        {
+                            value = pLine->Data;
+                            valueSize = endOffset + 1;
+                            break;
+                        }
+
+                        if (endOffset == std::string::npos)
+                        {
+                            data += "\n";
+                        }
+                        else
+                        {
+                            data.append(pLine->Data, endOffset + 1);
+                        }
+
+                        if (lastLine)
+                        {
+                            break;
+                        }
+
+                        data += " ";
+                    }
+
+                    if (value == nullptr)
+                    {
+                        value = data.data();
+                        valueSize = data.size();
+                    }
+
+                    if (flow)
+                    {
+                        return ParseFlow(*pHandler, value, valueSize, *pFirstLine);
+                    }
+
+                    if (quoted && ValidateQuote(value, valueSize) == false)
+                    {
+                        return Error(Detail::ErrorInvalidQuote(), *pFirstLine);
+                    }
+                }
+                // Block scalar
+                else
+                {
+                    pLine = &m_Lines[it];
+                    size_t blockOffset = pLine->Offset;
+                    if (blockOffset <= parentOffset)
+                    {
+                        return Error(Detail::ErrorIncorrectOffset(), *pLine);
+                    }
+
+                    bool addedSpace = false;
+                    while (it < m_Lines.size() && m_Lines[it].Type == Node::ScalarType)
+                    {
+                        pLine = &m_Lines[it];
+
+                        const size_t endOffset = FindLastNotSpace(pLine->Data, pLine->Size);
+                        if (endOffset != std::string::npos && pLine->Offset < blockOffset)
+                        {
+                            return Error(Detail::ErrorIncorrectOffset(), *pLine);
+                        }
+
+                        if (endOffset == std::string::npos)
+                        {
+                            if (addedSpace)
+                            {
+                                data[data.size() - 1] = '\n';
+                                addedSpace = false;
+                            }
+                            else
+                            {
+                                data += "\n";
+                            }
+
+                            ++it;
+                            continue;
+                        }
+                        else
+                        {
+                            if (blockOffset != pLine->Offset && foldedFlag)
+                            {
+                                if (addedSpace)
+                                {
+                                    data[data.size() - 1] = '\n';
+                                    addedSpace = false;
+                                }
+                                else
+                                {
+                                    data += "\n";
+                                }
+                            }
+                            data.append(pLine->Offset - blockOffset, ' ');
+                            data.append(pLine->Data, pLine->Size);
+                        }
+
+                        // Move to next line
+                        ++it;
+                        if (it == m_Lines.size() || m_Lines[it].Type != Node::ScalarType)
+                        {
+                            if (newLineFlag)
+                            {
+                                data += "\n";
+                            }
+                            break;
+                        }
+
+                        if (foldedFlag)
+                        {
+                            data += " ";
+                            addedSpace = true;
+                        }
+                        else if (literalFlag && endOffset != std::string::npos)
+                        {
+                            data += "\n";
+                        }
+                    }
+                }
+
+                if (value == nullptr)
+                {
+                    value = data.data();
+                    valueSize = data.size();
+                }
+                if (valueSize && (value[0] == '"' || value[0] == '\''))
+                {
+                    pHandler->Scalar(value + 1, valueSize > 1 ? valueSize - 2 : 0);
+                }
+                else
+                {
+                    pHandler->Scalar(value, valueSize);
+                }
+                return true;
+            }
+
+            /// Alias (*name) takes the whole value.
+            bool ParseAlias(Handler& handler, size_t& it)
+            {
+                const ReaderLine& line = m_Lines[it];
+                const size_t end = FindLastNotSpace(line.Data, line.Size) + 1;
+                ++it;
+                if (end == 1 || memchr(line.Data, ' ', end) || (it < m_Lines.size() && m_Lines[it].Type == Node::ScalarType))
+                {
+                    return Error(Detail::ErrorInvalidAnchor(), line);
+                }
+                if (m_Anchors.find(std::string(line.Data + 1, end - 1)) == m_Anchors.end())
+                {
+                    return Error(Detail::ErrorUnknownAlias(), line);
+                }
+                handler.Alias(line.Data + 1, end - 1);
+                return true;
+            }
+
+            static bool IsFlowStart(const char* data, const size_t size)
+            {
+                return size && (data[0] == '[' || data[0] == '{');
+            }
+
+            /// Balance of flow brackets in the line, quoted parts are skipped.
+            static ptrdiff_t FlowDepth(const char* data, const size_t size)
+            {
+                ptrdiff_t depth = 0;
+                for (size_t i = 0; i < size; ++i)
+                {
+                    const char c = data[i];
+                    if (c == '"' || c == '\'')
+                    {
+                        const void* end = memchr(data + i + 1, c, size - i - 1);
+                        if (end == nullptr)
+                            break;
+                        i = (const char*)end - data;
+                    }
+                    else if (c == '[' || c == '{')
+                        depth++;
+                    else if (c == ']' || c == '}')
+                        depth--;
+                }
+                return depth;
+            }
+
+            static bool IsFlowSpace(char c)
+            {
+                return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+            }
+
+            static void SkipFlowSpaces(const char*& pos, const char* end)
+            {
+                while (pos < end && IsFlowSpace(*pos))
+                    ++pos;
+            }
+
+            /// Parses flow collection from joined lines of the scalar.
+            bool ParseFlow(Handler& handler, const char* data, const size_t size, const ReaderLine& line)
+            {
+                const char* pos = data, *end = data + size;
+                if (ParseFlowValue(&handler, pos, end, line) == false)
+                {
+                    return false;
+                }
+                SkipFlowSpaces(pos, end);
+                if (pos != end)
+                {
+                    return Error(Detail::ErrorInvalidFlow(), line);
+                }
+                return true;
+            }
+
+            bool ParseFlowValue(Handler* pHandler, const char*& pos, const char* end, const ReaderLine& line)
+            {
+                SkipFlowSpaces(pos, end);
+                if (pos < end && (*pos == '&' || *pos == '*'))
+                {
+                    const bool alias = *pos == '*';
+                    const char* name = ++pos;
+                    while (pos < end && IsFlowSpace(*pos) == false && *pos != ',' && *pos != ']' && *pos != '}')
+                    {
+                        ++pos;
+                    }
+                    if (pos == name)
+                    {
+                        return Error(Detail::ErrorInvalidAnchor(), line);
+                    }
+                    const std::string key(name, pos - name);
+                    if (alias)
+                    {
+                        if (m_Anchors.find(key) == m_Anchors.end())
+                        {
+                            return Error(Detail::ErrorUnknownAlias(), line);
+                        }
+                        if (pHandler)
+                        {
+                            pHandler->Alias(name, pos - name);
+                        }
+                        return true;
+                    }
+                    if (pHandler)
+                    {
+                        pHandler->Anchor(name, pos - name);
+                    }
+                    if (ParseFlowValue(pHandler, pos, end, line) == false)
+                    {
+                        return false;
+                    }
+                    m_Anchors.insert(key);
+                    return true;
+                }
+                if (pos < end && *pos == '[')
+                {
+                    return ParseFlowSequence(pHandler, pos, end, line);
+                }
+                else if (pos < end && *pos == '{')
+                {
+                    return ParseFlowMap(pHandler, pos, end, line);
+                }
+                else
+                {
+                    const char* data;
+                    size_t size;
+                    if (ReadFlowScalar(pos, end, data, size, line) == false)
+                    {
+                        return false;
+                    }
+                    if (pHandler)
+                    {
+                        pHandler->Scalar(data, size);
+                    }
+                }
+                return true;
+            }
+
+            /// Parses value after ':' in flow collection, it can be omitted.
+            bool ParseFlowMapValue(Handler* pHandler, const char*& pos, const char* end, const ReaderLine& line)
+            {
+                SkipFlowSpaces(pos, end);
+                if (pos < end && (*pos == ',' || *pos == ']' || *pos == '}'))
+                {
+                    if (pHandler)
+                    {
+                        pHandler->Null();
+                    }
+                    return true;
+                }
+                return ParseFlowValue(pHandler, pos, end, line);
+            }
+
+            /// Moves to the next entry, next is false at the end of collection.
+            bool NextFlowEntry(const char*& pos, const char* end, char close, const ReaderLine& line, bool& next)
+            {
+                SkipFlowSpaces(pos, end);
+                if (pos < end && *pos == ',')
+                {
+                    ++pos;
+                    SkipFlowSpaces(pos, end);
+                }
+                else if (pos == end || *pos != close)
+                {
+                    return Error(Detail::ErrorInvalidFlow(), line);
+                }
+                next = true;
+                if (pos < end && *pos == close)
+                {
+                    ++pos;
+                    next = false;
+                }
+                return true;
+            }
+
+            bool ParseFlowSequence(Handler* pHandler, const char*& pos, const char* end, const ReaderLine& line)
+            {
+                if (pHandler && pHandler->FlowSequenceStart() == false)
+                {
+                    pHandler = nullptr;
+                }
+                ++pos;
+                SkipFlowSpaces(pos, end);
+                bool next = true;
+                if (pos < end && *pos == ']')
+                {
+                    ++pos;
+                    next = false;
+                }
+                while (next)
+                {
+                    if (pos < end && (*pos == '[' || *pos == '{' || *pos == '&' || *pos == '*'))
+                    {
+                        if (ParseFlowValue(pHandler, pos, end, line) == false)
+                        {
+                            return false;
+                        }
+                    }
+                    else
+                    {
+                        const char* data;
+                        size_t size;
+                        if (ReadFlowScalar(pos, end, data, size, line) == false)
+                        {
+                            return false;
+                        }
+                        SkipFlowSpaces(pos, end);
+                        if (pos < end && *pos == ':')
+                        {
+                            // Single pair map.
+                            ++pos;
+                            Handler* pMapHandler = pHandler && pHandler->FlowMapStart() ? pHandler : nullptr;
+                            if (ParseFlowMapValue(pMapHandler && FlowKey(*pMapHandler, data, size) ? pMapHandler : nullptr, pos, end, line) == false)
+                            {
+                                return false;
+                            }
+                            if (pMapHandler)
+                            {
+                                pMapHandler->MapEnd();
+                            }
+                        }
+                        else if (pHandler)
+                        {
+                            pHandler->Scalar(data, size);
+                        }
+                    }
+                    if (NextFlowEntry(pos, end, ']', line, next) == false)
+                    {
+                        return false;
+                    }
+                }
+                if (pHandler)
+                {
+                    pHandler->SequenceEnd();
+                }
+                return true;
+            }
+
+            bool ParseFlowMap(Handler* pHandler, const char*& pos, const char* end, const ReaderLine& line)
+            {
+                if (pHandler && pHandler->FlowMapStart() == false)
+                {
+                    pHandler = nullptr;
+                }
+                ++pos;
+                SkipFlowSpaces(pos, end);
+                bool next = true;
+                if (pos < end && *pos == '}')
+                {
+                    ++pos;
+                    next = false;
+                }
+                while (next)
+                {
+                    const char* key;
+                    size_t keySize;
+                    if (ReadFlowScalar(pos, end, key, keySize, line) == false)
+                    {
+                        return false;
+                    }
+                    Handler* pValueHandler = pHandler && FlowKey(*pHandler, key, keySize) ? pHandler : nullptr;
+                    SkipFlowSpaces(pos, end);
+                    if (pos < end && *pos == ':')
+                    {
+                        ++pos;
+                        if (ParseFlowMapValue(pValueHandler, pos, end, line) == false)
+                        {
+                            return false;
+                        }
+                    }
+                    else if (pValueHandler)
+                    {
+                        pValueHandler->Null();
+                    }
+                    if (NextFlowEntry(pos, end, '}', line, next) == false)
+                    {
+                        return false;
+                    }
+                }
+                if (pHandler)
+                {
+                    pHandler->MapEnd();
+                }
+                return true;
+            }
+
+            /// Passes key of flow map to handler, escape tokens are removed as in block maps.
+            bool FlowKey(Handler& handler, const char* key, size_t size)
+            {
+                if (memchr(key, '\\', size) == nullptr)
+                {
+                    return handler.Key(key, size);
+                }
+                m_Key.assign(key, size);
+                RemoveAllEscapeTokens(m_Key);
+                return handler.Key(m_Key.data(), m_Key.size());
+            }
+
+            /// Reads quoted or plain scalar of flow collection.
+            bool ReadFlowScalar(const char*& pos, const char* end, const char*& data, size_t& size, const ReaderLine& line)
+            {
+                if (pos < end && (*pos == '"' || *pos == '\''))
+                {
+                    const char* close = (const char*)memchr(pos + 1, *pos, end - pos - 1);
+                    while (close && *pos == '"' && close[-1] == '\\')
+                    {
+                        close = (const char*)memchr(close + 1, *pos, end - close - 1);
+                    }
+                    if (close == nullptr)
+                    {
+                        return Error(Detail::ErrorInvalidQuote(), line);
+                    }
+                    data = pos + 1;
+                    size = close - data;
+                    pos = close + 1;
+                    return true;
+                }
+
+                // Plain scalar ends at ",]}" or at ':' followed by space or by end of entry.
+                data = pos;
+                while (pos < end)
+                {
+                    pos += Detail::FindFlowIndicator(pos, end - pos);
+                    if (pos == end || *pos != ':')
+                    {
+                        break;
+                    }
+                    if (pos + 1 == end || IsFlowSpace(pos[1]) || pos[1] == ',' || pos[1] == ']' || pos[1] == '}')
+                    {
+                        break;
+                    }
+                    ++pos;
+                }
+                if (pos < end && (*pos == '[' || *pos == '{'))
+                {
+                    return Error(Detail::ErrorInvalidFlow(), line);
+                }
+                size = pos - data;
+                while (size && IsFlowSpace(data[size - 1]))
+                {
+                    size--;
+                }
+                if (size == 0)
+                {
+                    return Error(Detail::ErrorInvalidFlow(), line);
+                }
+                return true;
+            }
+
+            void Print()
+            {
+                for (size_t i = 0; i < m_Lines.size(); i++)
+                {
+                    const ReaderLine* pLine = &m_Lines[i];
+
+                    // Print type
+                    if (pLine->Type == Node::SequenceType)
+                    {
+                        std::cout << "seq ";
+                    }
+                    else if (pLine->Type == Node::MapType)
+                    {
+                        std::cout << "map ";
+                    }
+                    else if (pLine->Type == Node::ScalarType)
+                    {
+                        std::cout << "sca ";
+                    }
+                    else
+                    {
+                        std::cout << "    ";
+                    }
+
+                    // Print flags
+                    if (pLine->GetFlag(ReaderLine::FoldedScalarFlag))
+                    {
+                        std::cout << "f";
+                    }
+                    else
+                    {
+                        std::cout << "-";
+                    }
+                    if (pLine->GetFlag(ReaderLine::LiteralScalarFlag))
+                    {
+                        std::cout << "l";
+                    }
+                    else
+                    {
+                        std::cout << "-";
+                    }
+                    if (pLine->GetFlag(ReaderLine::ScalarNewlineFlag))
+                    {
+                        std::cout << "n";
+                    }
+                    else
+                    {
+                        std::cout << "-";
+                    }
+                    if (i + 1 == m_Lines.size())
+                    {
+                        std::cout << "e";
+                    }
+                    else
+                    {
+                        std::cout << "-";
+                    }
+
+
+                    std::cout << "| ";
+                    std::cout << pLine->No << " ";
+                    std::cout << std::string(pLine->Offset, ' ');
+
+                    if (pLine->Type == Node::ScalarType)
+                    {
+                        std::string scalarValue = pLine->Str();
+                        for (size_t i = 0; (i = scalarValue.find("\n", i)) != std::string::npos;)
+                        {
+                            scalarValue.replace(i, 1, "\\n");
+                            i += 2;
+                        }
+                        std::cout << scalarValue << std::endl;
+                    }
+                    else if (pLine->Type == Node::MapType)
+                    {
+                        std::cout << pLine->Str() + ":" << std::endl;
+                    }
+                    else if (pLine->Type == Node::SequenceType)
+                    {
+                        std::cout << "-" << std::endl;
+                    }
+                    else
+                    {
+                        std::cout << "> UNKOWN TYPE <" << std::endl;
+                    }
+                }
+            }
+
+            void SkipEmptyLines(size_t& next)
+            {
+                while (next < m_Raw.size() && m_Raw[next].Size == 0)
+                {
+                    next++;
+                }
+            }
+
+            static size_t FindNotSpace(const char* data, const size_t size, size_t pos)
+            {
+                for (; pos < size; pos++)
+                {
+                    if (data[pos] != ' ' && data[pos] != '\t')
+                        return pos;
+                }
+                return std::string::npos;
+            }
+
+            static size_t FindLastNotSpace(const char* data, size_t size)
+            {
+                while (size)
+                {
+                    size--;
+                    if (data[size] != ' ' && data[size] != '\t')
+                        return size;
+                }
+                return std::string::npos;
+            }
+
+            static bool IsSequenceStart(const char* data, const size_t size)
+            {
+                if (size == 0 || data[0] != '-')
+                {
+                    return false;
+                }
+
+                if (size >= 2 && data[1] != ' ')
+                {
+                    return false;
+                }
+
+                return true;
+            }
+
+            /// Reads flags of block scalar (they are 0 if it isn't a block scalar), returns false if it is invalid.
+            bool ReadBlockFlags(const char* data, const size_t size, const size_t line, const size_t column, unsigned char& flags)
+            {
+                flags = 0;
+                if (size == 0)
+                {
+                    return true;
+                }
+
+                if (data[0] == '|')
+                {
+                    if (size >= 2)
+                    {
+                        if (data[1] != '-' && data[1] != ' ' && data[1] != '\t')
+                        {
+                            return Error(Exception::ParsingError, ExceptionMessage(Detail::ErrorInvalidBlockScalar(), line, std::string(data, size)), line, column);
+                        }
+                    }
+                    else
+                    {
+                        flags |= ReaderLine::FlagMask(static_cast<size_t>(ReaderLine::ScalarNewlineFlag));
+                    }
+                    flags |= ReaderLine::FlagMask(static_cast<size_t>(ReaderLine::LiteralScalarFlag));
+                    return true;
+                }
+
+                if (data[0] == '>')
+                {
+                    if (size >= 2)
+                    {
+                        if (data[1] != '-' && data[1] != ' ' && data[1] != '\t')
+                        {
+                            return Error(Exception::ParsingError, ExceptionMessage(Detail::ErrorInvalidBlockScalar(), line, std::string(data, size)), line, column);
+                        }
+                    }
+                    else
+                    {
+                        flags |= ReaderLine::FlagMask(static_cast<size_t>(ReaderLine::ScalarNewlineFlag));
+                    }
+                    flags |= ReaderLine::FlagMask(static_cast<size_t>(ReaderLine::FoldedScalarFlag));
+                    return true;
+                }
+
+                return true;
+            }
+
+            /// Records the first error, returns false.
+            bool Error(const Exception::Type type, const std::string& message, const size_t line, const size_t column)
+            {
+                if (m_Status.Failed == false)
+                {
+                    m_Status.Failed = true;
+                    m_Status.Type = type;
+                    m_Status.Message = message;
+                    m_Status.Line = line;
+                    m_Status.Column = column;
+                }
+                return false;
+            }
+
+            bool Error(const std::string& message, const ReaderLine& line)
+            {
+                return Error(Exception::ParsingError, ExceptionMessage(message, line), line.No, line.Offset + 1);
+            }
+
+            bool Error(const std::string& message, const ReaderLine& line, const size_t errorPos)
+            {
+                return Error(Exception::ParsingError, ExceptionMessage(message, line, errorPos), line.No, line.Offset + errorPos + 1);
+            }
+
+            bool InternalError(const std::string& message, const ReaderLine& line)
+            {
+                return Error(Exception::InternalError, ExceptionMessage(message, line), line.No, line.Offset + 1);
+            }
+
+
+            std::vector<ReaderLine> m_Raw;      ///< Lines of input buffer.
+            std::vector<ReaderLine> m_Lines;    ///< Lines after splitting of keys and values.
+            size_t m_Next;                      ///< Offset of the next document in the buffer.
+            std::string m_Key;                  ///< Buffer of current key.
+            std::string m_Scalar;               ///< Buffer of current scalar.
+            std::unordered_set<std::string> m_Anchors; ///< Anchors which are defined in the document.
+            Status m_Status;                    ///< Result of the last parsing.
+        };
+
+        //-----------------------------------------------------------------------------------------
+
+        namespace Detail
+        {
+            inline Status CannotOpenFile()
+            {
+                Status status;
+                status.Failed = true;
+                status.Type = Exception::OperationError;
+                status.Message = ErrorCannotOpenFile();
+                return status;
+            }
+
+            /// The file is parsed directly from its view (mapping), the view is closed after parsing.
+            template<class Target> Status ParseFile(Target& target, const char* filename)
+            {
+                FileView file;
+                if (file.Open(filename) == false)
+                {
+                    return CannotOpenFile();
+                }
+
+                ParseImp imp;
+                imp.TryParse(target, file.Data(), file.Size());
+                return imp.LastStatus();
+            }
+
+            template<class Target> Status ParseStream(Target& target, std::istream& stream)
+            {
+                // Read the rest of the stream to one buffer.
+                std::vector<char> buffer;
+                const std::streampos start = stream.tellg();
+                if (start != std::streampos(-1))
+                {
+                    stream.seekg(0, stream.end);
+                    const std::streampos end = stream.tellg();
+                    stream.seekg(start);
+                    if (end > start)
+                    {
+                        buffer.resize(static_cast<size_t>(end - start));
+                        stream.read(buffer.data(), buffer.size());
+                        buffer.resize(static_cast<size_t>(stream.gcount()));
+                    }
+                }
+                else
+                    buffer.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+
+                ParseImp imp;
+                if (imp.TryParse(target, buffer.data(), buffer.size()) == false)
+                {
+                    return imp.LastStatus();
+                }
+
+                // Set stream position to the next document.
+                if (imp.Next() < buffer.size() && start != std::streampos(-1))
+                {
+                    stream.clear();
+                    stream.seekg(start + std::streamoff(imp.Next()));
+                }
+                else
+                    stream.setstate(std::ios::eofbit);
+                return imp.LastStatus();
+            }
+        }
+
+        inline void Parse(Node& root, const char* filename)
+        {
+            const Status status = Detail::ParseFile(root, filename);
+            if (status.Failed)
+            {
+                Detail::Throw(status);
+            }
+        }
+
+        inline void Parse(Node& root, std::istream& stream)
+        {
+            const Status status = Detail::ParseStream(root, stream);
+            if (status.Failed)
+            {
+                Detail::Throw(status);
+            }
+        }
+
+        inline void Parse(Node& root, const std::string& string)
+        {
+            Parse(root, string.data(), string.size());
+        }
+
+        inline void Parse(Node& root, const char* buffer, const size_t size)
+        {
+            ParseImp imp;
+            imp.Parse(root, buffer, size);
+        }
+
+        inline void Parse(Handler& handler, const char* filename)
         {
-            switch (m_Type)
+            const Status status = Detail::ParseFile(handler, filename);
+            if (status.Failed)
             {
-            case SequenceType:
-                static_cast<Detail::SequenceConstIteratorImp*>(m_pImp)->m_Iterator--;
-                break;
-            case MapType:
-                static_cast<Detail::MapConstIteratorImp*>(m_pImp)->m_Iterator--;
-                break;
-            default:
-                break;
+                Detail::Throw(status);
             }
-            return *this;
         }
 
-        inline bool ConstIterator::operator == (const ConstIterator& it)
+        inline void Parse(Handler& handler, std::istream& stream)
         {
-            if (m_Type != it.m_Type)
-            {
-                return false;
-            }
-
-            switch (m_Type)
+            const Status status = Detail::ParseStream(handler, stream);
+            if (status.Failed)
             {
-            case SequenceType:
-                return static_cast<Detail::SequenceConstIteratorImp*>(m_pImp)->m_Iterator == static_cast<Detail::SequenceConstIteratorImp*>(it.m_pImp)->m_Iterator;
-                break;
-            case MapType:
-                return static_cast<Detail::MapConstIteratorImp*>(m_pImp)->m_Iterator == static_cast<Detail::MapConstIteratorImp*>(it.m_pImp)->m_Iterator;
-                break;
-            default:
-                break;
+                Detail::Throw(status);
             }
-
-            return false;
         }
 
-        inline bool ConstIterator::operator != (const ConstIterator& it)
+        inline void Parse(Handler& handler, const std::string& string)
         {
-            return !(*this == it);
+            Parse(handler, string.data(), string.size());
         }
 
-        //-----------------------------------------------------------------------------------------
-
-        inline Node::Node(bool none) 
-            : m_pImp(new Detail::NodeImp())
+        inline void Parse(Handler& handler, const char* buffer, const size_t size)
         {
-            if (none)
-                Clear();
+            ParseImp imp;
+            imp.Parse(handler, buffer, size);
         }
 
-        inline Node::Node(const Node& node)
-            : Node()
+        inline Status TryParse(Node& root, const char* filename)
         {
-            *this = node;
+            return Detail::ParseFile(root, filename);
         }
 
-        inline Node::Node(const std::string& value) :
-            Node()
+        inline Status TryParse(Node& root, std::istream& stream)
         {
-            *this = value;
+            return Detail::ParseStream(root, stream);
         }
 
-        inline Node::Node(const char* value) :
-            Node()
+        inline Status TryParse(Node& root, const std::string& string)
         {
-            *this = value;
+            return TryParse(root, string.data(), string.size());
         }
 
-        inline Node::~Node()
+        inline Status TryParse(Node& root, const char* buffer, const size_t size)
         {
-            delete ((Detail::NodeImp*)m_pImp);
+            ParseImp imp;
+            imp.TryParse(root, buffer, size);
+            return imp.LastStatus();
         }
 
-        inline Node::eType Node::Type() const
+        inline Status TryParse(Handler& handler, const char* filename)
         {
-            return ((Detail::NodeImp*)m_pImp)->m_Type;
+            return Detail::ParseFile(handler, filename);
         }
 
-        inline bool Node::IsNone() const
+        inline Status TryParse(Handler& handler, std::istream& stream)
         {
-            return ((Detail::NodeImp*)m_pImp)->m_Type == Node::None;
+            return Detail::ParseStream(handler, stream);
         }
 
-        inline bool Node::IsSequence() const
+        inline Status TryParse(Handler& handler, const std::string& string)
         {
-            return ((Detail::NodeImp*)m_pImp)->m_Type == Node::SequenceType;
+            return TryParse(handler, string.data(), string.size());
         }
 
-        inline bool Node::IsMap() const
+        inline Status TryParse(Handler& handler, const char* buffer, const size_t size)
         {
-            return ((Detail::NodeImp*)m_pImp)->m_Type == Node::MapType;
+            ParseImp imp;
+            imp.TryParse(handler, buffer, size);
+            return imp.LastStatus();
         }
 
-        inline bool Node::IsScalar() const
+        //-----------------------------------------------------------------------------------------
+
+        inline Document::Document()
+            : m_Imp(&m_Arena, true, true)
+            , m_Root(&m_Imp)
         {
-            return ((Detail::NodeImp*)m_pImp)->m_Type == Node::ScalarType;
         }
 
-        inline void Node::Clear()
+        inline Node& Document::Root()
         {
-            ((Detail::NodeImp*)m_pImp)->Clear();
+            return m_Root;
         }
 
-        inline size_t Node::Size() const
+        inline const Node& Document::Root() const
         {
-            if (((Detail::NodeImp*)m_pImp)->m_pImp == nullptr)
-                return 0;
-            return ((Detail::NodeImp*)m_pImp)->m_pImp->GetSize();
+            return m_Root;
         }
 
-        inline Node& Node::Insert(const size_t index)
+        inline void Document::Parse(const char* buffer, const size_t size)
         {
-            ((Detail::NodeImp*)m_pImp)->InitSequence();
-            return *((Detail::NodeImp*)m_pImp)->m_pImp->Insert(index);
+            Yaml::Parse(m_Root, buffer, size);
         }
 
-        inline Node& Node::PushFront()
+        inline void Document::Parse(const std::string& string)
         {
-            ((Detail::NodeImp*)m_pImp)->InitSequence();
-            return *((Detail::NodeImp*)m_pImp)->m_pImp->PushFront();
+            Yaml::Parse(m_Root, string);
         }
 
-        inline Node& Node::PushBack()
+        inline void Document::Parse(std::istream& stream)
         {
-            ((Detail::NodeImp*)m_pImp)->InitSequence();
-            return *((Detail::NodeImp*)m_pImp)->m_pImp->PushBack();
+            Yaml::Parse(m_Root, stream);
         }
 
-        inline Node& Node::operator[](const size_t index)
+        inline void Document::Parse(const char* filename)
         {
-            ((Detail::NodeImp*)m_pImp)->InitSequence();
-            Node* pNode = ((Detail::NodeImp*)m_pImp)->m_pImp->GetNode(index);
-            if (pNode == nullptr)
-                return Detail::EmptyNode();
-            return *pNode;
+            const Status status = TryParse(filename);
+            if (status.Failed)
+            {
+                Detail::Throw(status);
+            }
         }
 
-        inline Node& Node::operator[](const std::string& key)
+        inline void Document::ParseInPlace(const char* buffer, const size_t size)
         {
-            ((Detail::NodeImp*)m_pImp)->InitMap();
-            return *((Detail::NodeImp*)m_pImp)->m_pImp->GetNode(key);
+            m_Imp.Clear();
+            ParseImp imp;
+            imp.Parse(m_Root, buffer, size, true);
         }
 
-        inline void Node::Erase(const size_t index)
+        inline void Document::ParseParallel(const char* buffer, const size_t size, size_t threads)
         {
-            if (((Detail::NodeImp*)m_pImp)->m_pImp == nullptr || ((Detail::NodeImp*)m_pImp)->m_Type != Node::SequenceType)
+            if (threads == 0)
+            {
+                threads = std::min<size_t>(std::max<size_t>(std::thread::hardware_concurrency(), 1), size / PARALLEL_CHUNK_MIN + 1);
+            }
+            Node::eType type = Node::None;
+            const std::vector<size_t> bounds = threads > 1 ? ParseImp::SplitTopLevel(buffer, size, threads, type) : std::vector<size_t>();
+            if (bounds.size() < 3)
+            {
+                Parse(buffer, size);
                 return;
-            return ((Detail::NodeImp*)m_pImp)->m_pImp->Erase(index);
+            }
+
+            // Errors are reported by serial parsing, so all failures (also aliases to other chunks) are just marked.
+            std::vector<Node> chunks(bounds.size() - 1);
+            std::atomic<bool> failed(false);
+            auto parse = [&](size_t i)
+            {
+                const char* data = buffer + bounds[i];
+                const size_t chunkSize = bounds[i + 1] - bounds[i];
+                if (failed == false && ParseImp::IsSplittable(data, chunkSize, type))
+                {
+                    ParseImp imp;
+                    if (imp.TryParse(chunks[i], data, chunkSize) && imp.Next() == chunkSize && chunks[i].Type() == type)
+                        return;
+                }
+                failed = true;
+            };
+            std::vector<std::thread> workers;
+            for (size_t i = 1; i < chunks.size(); ++i)
+                workers.push_back(std::thread(parse, i));
+            parse(0);
+            for (size_t i = 0; i < workers.size(); ++i)
+                workers[i].join();
+
+            std::vector<const Node*> pChunks;
+            for (size_t i = 0; i < chunks.size(); ++i)
+                pChunks.push_back(&chunks[i]);
+            if (failed || Merge(pChunks, type) == false)
+                Parse(buffer, size);
         }
 
-        inline void Node::Erase(const std::string& key)
+        inline Status Document::TryParse(const char* buffer, const size_t size)
         {
-            if (((Detail::NodeImp*)m_pImp)->m_pImp == nullptr || ((Detail::NodeImp*)m_pImp)->m_Type != Node::MapType)
-                return;
-            return ((Detail::NodeImp*)m_pImp)->m_pImp->Erase(key);
+            return Yaml::TryParse(m_Root, buffer, size);
         }
 
-        inline Node& Node::operator = (const Node& node)
+        inline Status Document::TryParse(const std::string& string)
         {
-            ((Detail::NodeImp*)m_pImp)->Clear();
-            CopyNode(node, *this);
-            return *this;
+            return Yaml::TryParse(m_Root, string);
         }
 
-        inline Node& Node::operator = (const std::string& value)
+        inline Status Document::TryParse(std::istream& stream)
         {
-            ((Detail::NodeImp*)m_pImp)->InitScalar();
-            ((Detail::NodeImp*)m_pImp)->m_pImp->SetData(value);
-            return *this;
+            return Yaml::TryParse(m_Root, stream);
         }
 
-        inline Node& Node::operator = (const char* value)
+        inline Status Document::TryParse(const char* filename)
         {
-            ((Detail::NodeImp*)m_pImp)->InitScalar();
-            ((Detail::NodeImp*)m_pImp)->m_pImp->SetData(value ? std::string(value) : "");
-            return *this;
+            m_Imp.Clear();
+            const Detail::FileView* pFile = m_Arena.Open(filename);
+            if (pFile == nullptr)
+            {
+                return Detail::CannotOpenFile();
+            }
+            ParseImp imp;
+            imp.TryParse(m_Root, pFile->Data(), pFile->Size(), true);
+            return imp.LastStatus();
         }
 
-        inline Iterator Node::Begin()
+        inline bool Document::Merge(const std::vector<const Node*>& chunks, Node::eType type)
         {
-            Iterator it;
-            if (((Detail::NodeImp*)m_pImp)->m_pImp != nullptr)
+            m_Imp.Clear();
+            m_Imp.Init(type);
+            for (size_t c = 0; c < chunks.size(); ++c)
             {
-                Detail::IteratorImp* pItImp = nullptr;
-                switch (((Detail::NodeImp*)m_pImp)->m_Type)
+                const Detail::NodeImp* pChunk = (Detail::NodeImp*)chunks[c]->m_pImp;
+                m_Arena.Borrow(*chunks[c]->m_pArena);
+                for (size_t i = 0; i < pChunk->Size(); ++i)
                 {
-                case Node::SequenceType:
-                    it.m_Type = Iterator::SequenceType;
-                    pItImp = new Detail::SequenceIteratorImp;
-                    pItImp->InitBegin(static_cast<Detail::SequenceImp*>(((Detail::NodeImp*)m_pImp)->m_pImp));
-                    break;
-                case Node::MapType:
-                    it.m_Type = Iterator::MapType;
-                    pItImp = new Detail::MapIteratorImp;
-                    pItImp->InitBegin(static_cast<Detail::MapImp*>(((Detail::NodeImp*)m_pImp)->m_pImp));
-                    break;
-                default:
-                    break;
+                    if (type == Node::MapType)
+                    {
+                        // Value of a repeated key would be combined with the previous one by serial parsing.
+                        if (m_Imp.Find(pChunk->Key(i), pChunk->KeySize(i)) != std::string::npos)
+                            return false;
+                        m_Imp.Get(pChunk->Key(i), pChunk->KeySize(i), true);
+                    }
+                    else
+                        m_Imp.Insert(m_Imp.Size());
+                    m_Imp.Share(m_Imp.Size() - 1, (Detail::NodeImp*)pChunk->Item(i).m_pImp);
                 }
-                it.m_pImp = pItImp;
             }
-            return it;
+            return true;
         }
 
-        inline ConstIterator Node::Begin() const
+        inline void Document::Clear()
         {
-            ConstIterator it;
-            if (((Detail::NodeImp*)m_pImp)->m_pImp != nullptr)
+            m_Imp.Clear();
+        }
+
+        inline size_t Document::Reserved() const
+        {
+            return m_Arena.Reserved();
+        }
+
+        //-----------------------------------------------------------------------------------------
+
+        inline Path::Path()
+        {
+        }
+
+        inline Path::Path(const std::string& path)
+        {
+            Status status = TryCompile(path);
+            if (status.Failed)
+                Detail::Throw(status);
+        }
+
+        inline Status Path::TryCompile(const std::string& path)
+        {
+            Status status;
+            m_Steps.clear();
+            const char* begin = path.c_str(), *pos = begin, *end = pos + path.size(), *error = nullptr;
+            while (pos < end)
             {
-                Detail::IteratorImp* pItImp = nullptr;
-                switch (((Detail::NodeImp*)m_pImp)->m_Type)
+                Step step = { Step::Key, std::string(), 0 };
+                if (*pos == '[')
                 {
-                case Node::SequenceType:
-                    it.m_Type = ConstIterator::SequenceType;
-                    pItImp = new Detail::SequenceConstIteratorImp;
-                    pItImp->InitBegin(static_cast<Detail::SequenceImp*>(((Detail::NodeImp*)m_pImp)->m_pImp));
-                    break;
-                case Node::MapType:
-                    it.m_Type = ConstIterator::MapType;
-                    pItImp = new Detail::MapConstIteratorImp;
-                    pItImp->InitBegin(static_cast<Detail::MapImp*>(((Detail::NodeImp*)m_pImp)->m_pImp));
-                    break;
-                default:
+                    const char* close = pos + 1;
+                    if (close < end && (*close == '"' || *close == '\''))
+                    {
+                        const char* quote = static_cast<const char*>(memchr(close + 1, *close, end - close - 1));
+                        if (quote == nullptr || quote + 1 == end || quote[1] != ']')
+                        {
+                            error = pos;
+                            break;
+                        }
+                        step.key.assign(close + 1, quote);
+                        close = quote + 1;
+                    }
+                    else if (close < end && *close == '*')
+                    {
+                        step.kind = Step::Any;
+                        close++;
+                    }
+                    else
+                    {
+                        step.kind = Step::Index;
+                        for (; close < end && *close >= '0' && *close <= '9'; close++)
+                        {
+                            const size_t digit = size_t(*close - '0');
+                            if (step.index > (std::numeric_limits<size_t>::max() - digit) / 10)
+                                break;
+                            step.index = step.index * 10 + digit;
+                        }
+                    }
+                    if (close == pos + 1 || close == end || *close != ']')
+                    {
+                        error = close;
+                        break;
+                    }
+                    pos = close + 1;
+                    if (pos < end && *pos != '.' && *pos != '[')
+                    {
+                        error = pos;
+                        break;
+                    }
+                }
+                else
+                {
+                    const char* keyEnd = pos;
+                    while (keyEnd < end && *keyEnd != '.' && *keyEnd != '[')
+                        keyEnd++;
+                    if (keyEnd == pos)
+                    {
+                        error = pos;
+                        break;
+                    }
+                    if (keyEnd == pos + 1 && *pos == '*')
+                        step.kind = Step::Any;
+                    else
+                        step.key.assign(pos, keyEnd);
+                    pos = keyEnd;
+                }
+                m_Steps.push_back(step);
+                if (pos < end && *pos == '.' && ++pos == end)
+                {
+                    error = pos;
                     break;
                 }
-                it.m_pImp = pItImp;
             }
-            return it;
+            if (error)
+            {
+                m_Steps.clear();
+                status.Failed = true;
+                status.Type = Exception::OperationError;
+                status.Column = error - begin + 1;
+                status.Message = Detail::ErrorInvalidPath();
+            }
+            return status;
         }
 
-        inline Iterator Node::End()
+        inline const Node* Path::Find(const Node& root) const
         {
-            Iterator it;
-            if (((Detail::NodeImp*)m_pImp)->m_pImp != nullptr)
+            const Node* pFirst = nullptr;
+            Select(root, 0, nullptr, &pFirst);
+            return pFirst;
+        }
+
+        inline Node* Path::Find(Node& root) const
+        {
+            std::vector<size_t> indices;
+            if (Find(root, 0, indices) == false)
+                return nullptr;
+
+            // Only the path to the found node is detached from shared nodes.
+            Node* pNode = &root;
+            for (size_t s = 0; s < indices.size(); ++s)
+                pNode = &pNode->Mutable(true)->Item(indices[s]);
+            return pNode;
+        }
+
+        inline void Path::Select(const Node& root, std::vector<const Node*>& nodes) const
+        {
+            Select(root, 0, &nodes, nullptr);
+        }
+
+        inline void Path::Range(const Detail::NodeImp* pImp, const Step& step, size_t& begin, size_t& end)
+        {
+            begin = 0;
+            end = pImp->Size();
+            if (step.kind == Step::Key)
             {
-                Detail::IteratorImp* pItImp = nullptr;
-                switch (((Detail::NodeImp*)m_pImp)->m_Type)
-                {
-                case Node::SequenceType:
-                    it.m_Type = Iterator::SequenceType;
-                    pItImp = new Detail::SequenceIteratorImp;
-                    pItImp->InitEnd(static_cast<Detail::SequenceImp*>(((Detail::NodeImp*)m_pImp)->m_pImp));
-                    break;
-                case Node::MapType:
-                    it.m_Type = Iterator::MapType;
-                    pItImp = new Detail::MapIteratorImp;
-                    pItImp->InitEnd(static_cast<Detail::MapImp*>(((Detail::NodeImp*)m_pImp)->m_pImp));
-                    break;
-                default:
-                    break;
-                }
-                it.m_pImp = pItImp;
+                begin = pImp->m_Type == Node::MapType ? pImp->Find(step.key.data(), step.key.size()) : std::string::npos;
+                end = begin == std::string::npos ? 0 : begin + 1;
+            }
+            else if (step.kind == Step::Index)
+            {
+                begin = pImp->m_Type == Node::SequenceType ? step.index : end;
+                end = std::min(begin + 1, end);
             }
-            return it;
         }
 
-        inline ConstIterator Node::End() const
+        inline void Path::Select(const Node& node, size_t step, std::vector<const Node*>* pNodes, const Node** ppFirst) const
         {
-            ConstIterator it;
-            if (((Detail::NodeImp*)m_pImp)->m_pImp != nullptr)
+            if (step == m_Steps.size())
             {
-                Detail::IteratorImp* pItImp = nullptr;
-
-                switch (((Detail::NodeImp*)m_pImp)->m_Type)
-                {
-                case Node::SequenceType:
-                    it.m_Type = ConstIterator::SequenceType;
-                    pItImp = new Detail::SequenceConstIteratorImp;
-                    pItImp->InitEnd(static_cast<Detail::SequenceImp*>(((Detail::NodeImp*)m_pImp)->m_pImp));
-                    break;
-                case Node::MapType:
-                    it.m_Type = ConstIterator::MapType;
-                    pItImp = new Detail::MapConstIteratorImp;
-                    pItImp->InitEnd(static_cast<Detail::MapImp*>(((Detail::NodeImp*)m_pImp)->m_pImp));
-                    break;
-                default:
-                    break;
-                }
-                it.m_pImp = pItImp;
+                if (pNodes)
+                    pNodes->push_back(&node);
+                else
+                    *ppFirst = &node;
+                return;
             }
-
-            return it;
+            const Detail::NodeImp* pImp = (const Detail::NodeImp*)node.m_pImp;
+            size_t i, end;
+            Range(pImp, m_Steps[step], i, end);
+            for (; i < end && (ppFirst == nullptr || *ppFirst == nullptr); ++i)
+                Select(pImp->Item(i), step + 1, pNodes, ppFirst);
         }
 
-        inline const std::string& Node::AsString() const
+        inline bool Path::Find(const Node& node, size_t step, std::vector<size_t>& indices) const
         {
-            if (((Detail::NodeImp*)m_pImp)->m_pImp == nullptr)
-                return Detail::EmptyString();
-            return ((Detail::NodeImp*)m_pImp)->m_pImp->GetData();
+            if (step == m_Steps.size())
+                return true;
+            const Detail::NodeImp* pImp = (const Detail::NodeImp*)node.m_pImp;
+            size_t i, end;
+            Range(pImp, m_Steps[step], i, end);
+            for (indices.push_back(0); i < end; ++i)
+            {
+                indices.back() = i;
+                if (Find(pImp->Item(i), step + 1, indices))
+                    return true;
+            }
+            indices.pop_back();
+            return false;
         }
 
         //-----------------------------------------------------------------------------------------
 
-        class ReaderLine
+        inline PathSet::PathSet()
+            : m_Entries(1)
+            , m_Count(0)
         {
-        public:
-            ReaderLine(const std::string& data = "", const size_t no = 0, 
-                const size_t offset = 0, const Node::eType type = Node::None,
-                const unsigned char flags = 0) 
-                : Data(data)
-                , No(no)
-                , Offset(offset)
-                , Type(type)
-                , Flags(flags)
-                , NextLine(nullptr)
+        }
+
+        inline size_t PathSet::Add(const Path& path)
+        {
+            size_t current = 0;
+            for (size_t s = 0; s < path.m_Steps.size(); ++s)
             {
+                size_t next = 0;
+                for (size_t c = 0; c < m_Entries[current].children.size() && next == 0; ++c)
+                {
+                    if (m_Entries[m_Entries[current].children[c]].step == path.m_Steps[s])
+                        next = m_Entries[current].children[c];
+                }
+                if (next == 0)
+                {
+                    next = m_Entries.size();
+                    m_Entries.push_back(Entry());
+                    m_Entries.back().step = path.m_Steps[s];
+                    m_Entries[current].children.push_back(next);
+                }
+                current = next;
             }
+            m_Entries[current].paths.push_back(m_Count);
+            return m_Count++;
+        }
 
-            enum eFlag
-            {
-                LiteralScalarFlag,
-                FoldedScalarFlag,
-                ScalarNewlineFlag
-            };
+        inline void PathSet::Select(const Node& root, std::vector<std::vector<const Node*>>& results) const
+        {
+            results.resize(m_Count);
+            for (size_t i = 0; i < m_Count; ++i)
+                results[i].clear();
+            Select(root, m_Entries[0], results);
+        }
 
-            void SetFlag(const eFlag flag)
+        inline void PathSet::Select(const Node& node, const Entry& entry, std::vector<std::vector<const Node*>>& results) const
+        {
+            for (size_t p = 0; p < entry.paths.size(); ++p)
+                results[entry.paths[p]].push_back(&node);
+            const Detail::NodeImp* pImp = (const Detail::NodeImp*)node.m_pImp;
+            for (size_t c = 0; c < entry.children.size(); ++c)
             {
-                Flags |= FlagMask(static_cast<size_t>(flag));
+                const Entry& child = m_Entries[entry.children[c]];
+                size_t i, end;
+                Path::Range(pImp, child.step, i, end);
+                for (; i < end; ++i)
+                    Select(pImp->Item(i), child, results);
             }
+        }
 
-            void SetFlags(const unsigned char flags)
-            {
-                Flags |= flags;
-            }
+        //-----------------------------------------------------------------------------------------
 
-            void UnsetFlag(const eFlag flag)
+        /*!
+        * \brief Reads a stream of YAML documents (separated by "---", terminated by "...") one by one.
+        * Content before the first "---" is the first document, a leading "---" only starts it.
+        *
+        * The parser state and the arena of the given Document are reused for every document, a stream is read
+        * by chunks, so memory is bounded by the largest document instead of the whole stream.
+        * A parsing error skips the broken document: Next() can be called again to continue with the following one.
+        */
+        class DocumentReader
+        {
+        public:
+            DocumentReader(const char* buffer, const size_t size)
+                : m_pStream(nullptr)
+                , m_pData(buffer)
+                , m_Size(size)
+                , m_Pos(0)
+                , m_Chunk(0)
+                , m_Count(0)
+                , m_End(true)
             {
-                Flags &= ~FlagMask(static_cast<size_t>(flag));
             }
 
-            void UnsetFlags(const unsigned char flags)
+            DocumentReader(std::istream& stream, const size_t chunk = 64 * 1024)
+                : m_pStream(&stream)
+                , m_pData(nullptr)
+                , m_Size(0)
+                , m_Pos(0)
+                , m_Chunk(std::max<size_t>(chunk, 1))
+                , m_Count(0)
+                , m_End(false)
             {
-                Flags &= ~flags;
             }
 
-            bool GetFlag(const eFlag flag) const
+            /// Parses the next document. Returns false at the end of input (an empty trailing document is skipped).
+            bool Next(Document& document)
             {
-                return (Flags & FlagMask(static_cast<size_t>(flag))) != 0;
+                Status status;
+                const bool next = Next(document, status);
+                if (status.Failed)
+                {
+                    Detail::Throw(status);
+                }
+                return next;
             }
 
-            void CopyScalarFlags(ReaderLine* from)
+            /// Parses the next document without exceptions, a broken document is returned (cleared) with the failed status.
+            bool Next(Document& document, Status& status)
             {
-                if (from == nullptr)
+                status = Status();
+                size_t end = ParseImp::FindDocumentEnd(m_pData + m_Pos, m_Size - m_Pos);
+                while (end == std::string::npos && m_End == false)
                 {
-                    return;
+                    Read();
+                    end = ParseImp::FindDocumentEnd(m_pData + m_Pos, m_Size - m_Pos);
                 }
-                unsigned char newFlags = from->Flags & (FlagMask(0) | FlagMask(1) | FlagMask(2));
-                Flags |= newFlags;
+                if (end == std::string::npos)
+                    end = m_Size - m_Pos;
+                if (end == 0)
+                {
+                    document.Clear();
+                    return false;
+                }
+
+                const char* data = m_pData + m_Pos;
+                m_Pos += end;
+                if (m_Parser.TryParse(document.Root(), data, end) == false)
+                {
+                    status = m_Parser.LastStatus();
+                    return true;
+                }
+                if (document.Root().IsNone() && m_Pos == m_Size && m_End)
+                    return false;
+                m_Count++;
+                return true;
             }
 
-            static CPL_INLINE const unsigned char FlagMask(size_t index)
+            /// Number of read documents.
+            size_t Count() const
             {
-                static const unsigned char flagMask[3] = { 0x01, 0x02, 0x04 };
-                return flagMask[index];
+                return m_Count;
             }
 
-            std::string Data;
-            size_t No;
-            size_t Offset;
-            Node::eType Type;
-            unsigned char Flags;
-            ReaderLine* NextLine;
+        private:
+            DocumentReader(const DocumentReader&);
+            DocumentReader& operator = (const DocumentReader&);
+
+            void Read()
+            {
+                if (m_Pos)
+                {
+                    memmove(m_Buffer.data(), m_Buffer.data() + m_Pos, m_Size - m_Pos);
+                    m_Size -= m_Pos;
+                    m_Pos = 0;
+                }
+                // Large documents double the buffer, so they are rescanned a logarithmic number of times.
+                const size_t chunk = std::max(m_Chunk, m_Size);
+                if (m_Buffer.size() < m_Size + chunk)
+                    m_Buffer.resize(m_Size + chunk);
+                m_pStream->read(m_Buffer.data() + m_Size, chunk);
+                m_Size += static_cast<size_t>(m_pStream->gcount());
+                m_pData = m_Buffer.data();
+                if (!*m_pStream)
+                    m_End = true;
+            }
+
+            ParseImp m_Parser;
+            std::istream* m_pStream;
+            std::vector<char> m_Buffer;
+            const char* m_pData;
+            size_t m_Size, m_Pos, m_Chunk, m_Count;
+            bool m_End;
         };
 
         //-----------------------------------------------------------------------------------------
 
-        class ParseImp
+        /*!
+        * \brief Document of a text which is edited: after an edit only blocks of top-level entries (of the root block map
+        * or sequence) which are touched by the edit are parsed again, the rest of blocks are reused.
+        *
+        * Blocks are parsed to own trees (scalars are copied, so the text can be changed by the caller), their entries
+        * are shared by the root. The tree is the same as after Document::Parse(): texts which can't be split to blocks,
+        * edits which change the type of the root or join keys of several blocks are parsed as a whole.
+        */
+        class IncrementalDocument
         {
         public:
-            ParseImp()
+            IncrementalDocument()
+                : m_Type(Node::None)
+                , m_Size(0)
+                , m_Parsed(0)
             {
             }
 
-            ~ParseImp()
+            const Node& Root() const
             {
-                ClearLines();
+                return m_Document.Root();
             }
 
-            void Parse(Node& root, std::istream& stream)
+            void Parse(const char* buffer, const size_t size)
             {
-                try
+                const Status status = TryParse(buffer, size);
+                if (status.Failed)
                 {
-                    root.Clear();
-                    ReadLines(stream);
-                    PostProcessLines();
-                    //Print();
-                    ParseRoot(root);
-                }
-                catch (Exception e)
-                {
-                    root.Clear();
-                    throw;
+                    Detail::Throw(status);
                 }
             }
 
-        private:
-
-            ParseImp(const ParseImp& copy)
-            {
-            }
-
-            void ReadLines(std::istream& stream)
+            /// The text is edited: bytes [offset, offset + removed) of the previous text are replaced by the bytes
+            /// [offset, offset + size + removed - previous size) of the new text given by buffer.
+            void Update(const char* buffer, const size_t size, const size_t offset, const size_t removed)
             {
-                std::string     line = "";
-                size_t          lineNo = 0;
-                bool            documentStartFound = false;
-                bool            foundFirstNotEmpty = false;
-                std::streampos  streamPos = 0;
-
-                // Read all lines, as long as the stream is ok.
-                while (!stream.eof() && !stream.fail())
+                const Status status = TryUpdate(buffer, size, offset, removed);
+                if (status.Failed)
                 {
-                    // Read line
-                    streamPos = stream.tellg();
-                    std::getline(stream, line);
-                    lineNo++;
-
-                    // Remove comment
-                    const size_t commentPos = FindNotCited(line, '#');
-                    if (commentPos != std::string::npos)
-                    {
-                        line.resize(commentPos);
-                    }
-
-                    // Start of document.
-                    if (documentStartFound == false && line == "---")
-                    {
-                        // Erase all lines before this line.
-                        ClearLines();
-                        documentStartFound = true;
-                        continue;
-                    }
-
-                    // End of document.
-                    if (line == "...")
-                    {
-                        break;
-                    }
-                    else if (line == "---")
-                    {
-                        stream.seekg(streamPos);
-                        break;
-                    }
-
-                    // Remove trailing return.
-                    if (line.size())
-                    {
-                        if (line[line.size() - 1] == '\r')
-                        {
-                            line.resize(line.size() - 1);
-                        }
-                    }
-
-                    // Validate characters.
-                    for (size_t i = 0; i < line.size(); i++)
-                    {
-                        if (line[i] != '\t' && (line[i] < 32 || line[i] > 125))
-                        {
-                            throw ParsingException(ExceptionMessage(Detail::ErrorInvalidCharacter(), lineNo, i + 1));
-                        }
-                    }
-
-                    // Validate tabs
-                    const size_t firstTabPos = line.find_first_of('\t');
-                    size_t       startOffset = line.find_first_not_of(" \t");
-
-                    // Make sure no tabs are in the very front.
-                    if (startOffset != std::string::npos)
-                    {
-                        if (firstTabPos < startOffset)
-                        {
-                            throw ParsingException(ExceptionMessage(Detail::ErrorTabInOffset(), lineNo, firstTabPos));
-                        }
-
-                        // Remove front spaces.
-                        line = line.substr(startOffset);
-                    }
-                    else
-                    {
-                        startOffset = 0;
-                        line = "";
-                    }
-
-                    // Add line.
-                    if (foundFirstNotEmpty == false)
-                    {
-                        if (line.size())
-                        {
-                            foundFirstNotEmpty = true;
-                        }
-                        else
-                        {
-                            continue;
-                        }
-                    }
-
-                    ReaderLine* pLine = new ReaderLine(line, lineNo, startOffset);
-                    m_Lines.push_back(pLine);
+                    Detail::Throw(status);
                 }
             }
 
-            void PostProcessLines()
+            Status TryParse(const char* buffer, const size_t size)
             {
-                for (auto it = m_Lines.begin(); it != m_Lines.end();)
-                {
-                    if (PostProcessSequenceLine(it))
-                        continue;
-                    if (PostProcessMappingLine(it))
-                        continue;
-                    PostProcessScalarLine(it);
-                }
-
-                if (m_Lines.size())
+                m_Size = size;
+                m_Parsed = size;
+                m_Bounds.assign(1, 0);
+                m_Chunks.clear();
+                if (ParseBlocks(buffer, 0, size, m_Type, m_Bounds, m_Chunks) && Merge())
                 {
-                    if (m_Lines.back()->Type != Node::ScalarType)
-                        throw ParsingException(ExceptionMessage(Detail::ErrorUnexpectedDocumentEnd(), *m_Lines.back()));
-                    if (m_Lines.size() > 1)
-                    {
-                        auto prevEnd = m_Lines.end();
-                        --prevEnd;
-
-                        for (auto it = m_Lines.begin(); it != prevEnd; it++)
-                        {
-                            auto nextIt = it;
-                            ++nextIt;
-
-                            (*it)->NextLine = *nextIt;
-                        }
-                    }
+                    return Status();
                 }
+                m_Bounds.clear();
+                m_Chunks.clear();
+                return m_Document.TryParse(buffer, size);
             }
 
-            bool PostProcessSequenceLine(std::list<ReaderLine*>::iterator& it)
+            Status TryUpdate(const char* buffer, const size_t size, const size_t offset, const size_t removed)
             {
-                ReaderLine* pLine = *it;
-
-                // Sequence split
-                if (IsSequenceStart(pLine->Data) == false)
+                if (m_Chunks.empty() || offset + removed > m_Size || size + removed < m_Size)
                 {
-                    return false;
+                    return TryParse(buffer, size);
                 }
+                const size_t inserted = size + removed - m_Size;
 
-                pLine->Type = Node::SequenceType;
+                // Blocks which touch the edit (also at their bounds: it can join them with neighbours) are parsed again.
+                size_t first = 0, last = m_Chunks.size();
+                while (m_Bounds[first + 1] < offset)
+                    first++;
+                while (m_Bounds[last - 1] > offset + removed)
+                    last--;
+                const size_t begin = m_Bounds[first], end = m_Bounds[last] + inserted - removed;
 
-                ClearTrailingEmptyLines(++it);
-
-                const size_t valueStart = pLine->Data.find_first_not_of(" \t", 1);
-                if (valueStart == std::string::npos)
+                Node::eType type = Node::None;
+                std::vector<size_t> bounds;
+                std::vector<std::unique_ptr<Node>> chunks;
+                if (ParseBlocks(buffer, begin, end, type, bounds, chunks) == false || type != m_Type ||
+                    (end < size && ParseImp::IsContinued(buffer, buffer + end)))
                 {
-                    return true;
+                    return TryParse(buffer, size);
                 }
+                m_Size = size;
+                m_Parsed = end - begin;
+                for (size_t i = last + 1; i < m_Bounds.size(); ++i)
+                    m_Bounds[i] = m_Bounds[i] + inserted - removed;
+                m_Bounds.erase(m_Bounds.begin() + first + 1, m_Bounds.begin() + last + 1);
+                m_Bounds.insert(m_Bounds.begin() + first + 1, bounds.begin(), bounds.end());
+                m_Chunks.erase(m_Chunks.begin() + first, m_Chunks.begin() + last);
+                m_Chunks.insert(m_Chunks.begin() + first, std::make_move_iterator(chunks.begin()), std::make_move_iterator(chunks.end()));
+                if (Merge() == false)
+                {
+                    return TryParse(buffer, size);
+                }
+                return Status();
+            }
 
-                // Create new line and insert
-                std::string newLine = pLine->Data.substr(valueStart);
-                it = m_Lines.insert(it, new ReaderLine(newLine, pLine->No, pLine->Offset + valueStart));
-                pLine->Data = "";
-
-                return false;
+            /// Number of bytes which were parsed by the last parsing or update.
+            size_t Parsed() const
+            {
+                return m_Parsed;
             }
 
-            bool PostProcessMappingLine(std::list<ReaderLine*>::iterator& it)
+            /// Number of blocks of top-level entries (0 if the text is parsed as a whole).
+            size_t Blocks() const
             {
-                ReaderLine* pLine = *it;
+                return m_Chunks.size();
+            }
 
-                // Find map key.
-                size_t preKeyQuotes = 0;
-                size_t tokenPos = FindNotCited(pLine->Data, ':', preKeyQuotes);
-                if (tokenPos == std::string::npos)
-                {
-                    return false;
-                }
-                if (preKeyQuotes > 1)
-                {
-                    throw ParsingException(ExceptionMessage(Detail::ErrorKeyIncorrect(), *pLine));
-                }
+        private:
+            static const size_t BLOCK_SIZE = 4 * 1024; ///< Approximate size of block.
 
-                pLine->Type = Node::MapType;
+            IncrementalDocument(const IncrementalDocument&);
+            IncrementalDocument& operator = (const IncrementalDocument&);
 
-                // Get key
-                std::string key = pLine->Data.substr(0, tokenPos);
-                const size_t keyEnd = key.find_last_not_of(" \t");
-                if (keyEnd == std::string::npos)
+            /// Parses blocks of the text [begin, end), adds their ends to bounds and their trees to chunks.
+            static bool ParseBlocks(const char* buffer, const size_t begin, const size_t end, Node::eType& type,
+                std::vector<size_t>& bounds, std::vector<std::unique_ptr<Node>>& chunks)
+            {
+                const std::vector<size_t> blocks = ParseImp::SplitTopLevel(buffer + begin, end - begin, (end - begin) / BLOCK_SIZE + 1, type);
+                if (blocks.size() < 2)
                 {
-                    throw ParsingException(ExceptionMessage(Detail::ErrorKeyMissing(), *pLine));
+                    return false;
                 }
-                key.resize(keyEnd + 1);
-
-                // Handle cited key.
-                if (preKeyQuotes == 1)
+                for (size_t i = 1; i < blocks.size(); ++i)
                 {
-                    if (key.front() != '"' || key.back() != '"')
+                    const char* data = buffer + begin + blocks[i - 1];
+                    const size_t size = blocks[i] - blocks[i - 1];
+                    chunks.push_back(std::unique_ptr<Node>(new Node()));
+                    ParseImp imp;
+                    if (ParseImp::IsSplittable(data, size, type) == false || imp.TryParse(*chunks.back(), data, size) == false ||
+                        imp.Next() != size || chunks.back()->Type() != type)
                     {
-                        throw ParsingException(ExceptionMessage(Detail::ErrorKeyIncorrect(), *pLine));
+                        return false;
                     }
-
-                    key = key.substr(1, key.size() - 2);
+                    bounds.push_back(begin + blocks[i]);
                 }
-                RemoveAllEscapeTokens(key);
+                return true;
+            }
 
-                // Get value
-                std::string value = "";
-                size_t valueStart = std::string::npos;
-                if (tokenPos + 1 != pLine->Data.size())
-                {
-                    valueStart = pLine->Data.find_first_not_of(" \t", tokenPos + 1);
-                    if (valueStart != std::string::npos)
-                    {
-                        value = pLine->Data.substr(valueStart);
-                    }
-                }
+            bool Merge()
+            {
+                std::vector<const Node*> chunks(m_Chunks.size());
+                for (size_t i = 0; i < m_Chunks.size(); ++i)
+                    chunks[i] = m_Chunks[i].get();
+                return m_Document.Merge(chunks, m_Type);
+            }
 
-                // Make sure the value is not a sequence start.
-                if (IsSequenceStart(value) == true)
-                {
-                    throw ParsingException(ExceptionMessage(Detail::ErrorBlockSequenceNotAllowed(), *pLine, valueStart));
-                }
+            Document m_Document;
+            Node::eType m_Type;
+            std::vector<size_t> m_Bounds;   ///< Offsets of blocks in the text, the last is its size.
+            std::vector<std::unique_ptr<Node>> m_Chunks; ///< Trees of blocks.
+            size_t m_Size, m_Parsed;
+        };
 
-                pLine->Data = key;
+        //-----------------------------------------------------------------------------------------
 
+        namespace Detail
+        {
+            /// Binding of YAML values to objects of some type: events of a value are converted directly to the object.
+            class Binding
+            {
+            public:
+                virtual ~Binding() {}
 
-                // Remove all empty lines after map key.
-                ClearTrailingEmptyLines(++it);
+                /// Name of the type in error messages.
+                virtual const char* Name() const = 0;
 
-                // Add new empty line?
-                size_t newLineOffset = valueStart;
-                if (newLineOffset == std::string::npos)
-                {
-                    if (it != m_Lines.end() && (*it)->Offset > pLine->Offset)
-                    {
-                        return true;
-                    }
+                /// Sets the default value.
+                virtual void Reset(void* pObject) const = 0;
 
-                    newLineOffset = tokenPos + 2;
-                }
-                else
-                {
-                    newLineOffset += pLine->Offset;
-                }
+                /// Returns false if the scalar can't be converted.
+                virtual bool Scalar(void* /*pObject*/, const char* /*data*/, size_t /*size*/) const { return false; }
 
-                // Add new line with value.
-                unsigned char dummyBlockFlags = 0;
-                if (IsBlockScalar(value, pLine->No, dummyBlockFlags) == true)
-                {
-                    newLineOffset = pLine->Offset;
-                }
-                ReaderLine* pNewLine = new ReaderLine(value, pLine->No, newLineOffset, Node::ScalarType);
-                it = m_Lines.insert(it, pNewLine);
+                /// Maps: the field of the key (nullptr if the key is unknown), its binding and its key.
+                virtual bool IsMap() const { return false; }
+                virtual void* Find(void* /*pObject*/, const char* /*key*/, size_t /*size*/, const Binding*& /*pBinding*/, const std::string*& /*pKey*/) const { return nullptr; }
 
-                // Return false in order to handle next line(scalar value).
-                return false;
+                /// Sequences: they are cleared at start, items with default values are appended.
+                virtual bool IsSequence() const { return false; }
+                virtual void Clear(void* /*pObject*/) const {}
+                virtual void* Append(void* /*pObject*/, const Binding*& /*pBinding*/) const { return nullptr; }
+            };
+
+            /// The scalar is a decimal number (an integer if it is required) without other characters.
+            inline bool IsNumber(const char* data, const size_t size, const bool integer)
+            {
+                size_t i = size && (data[0] == '-' || data[0] == '+') ? 1 : 0, digits = 0;
+                for (; i < size && data[i] >= '0' && data[i] <= '9'; ++i, ++digits);
+                if (integer == false && i < size && data[i] == '.')
+                    for (++i; i < size && data[i] >= '0' && data[i] <= '9'; ++i, ++digits);
+                if (integer == false && digits && i < size && (data[i] == 'e' || data[i] == 'E'))
+                {
+                    size_t exponent = 0;
+                    i += i + 1 < size && (data[i + 1] == '-' || data[i + 1] == '+') ? 2 : 1;
+                    for (; i < size && data[i] >= '0' && data[i] <= '9'; ++i, ++exponent);
+                    digits = exponent ? digits : 0;
+                }
+                return digits && i == size;
             }
 
-            void PostProcessScalarLine(std::list<ReaderLine*>::iterator& it)
+            template<class V> inline bool ConvertScalar(const char* data, const size_t size, V& value)
             {
-                ReaderLine* pLine = *it;
-                pLine->Type = Node::ScalarType;
+                static_assert(std::is_arithmetic<V>::value, "Schema fields must be arithmetic, bool, std::string, std::vector or structs.");
+                return IsNumber(data, size, std::is_integral<V>::value) && Cpl::ToVal(data, size, value);
+            }
 
-                size_t parentOffset = pLine->Offset;
-                if (pLine != m_Lines.front())
-                {
-                    std::list<ReaderLine*>::iterator lastIt = it;
-                    --lastIt;
-                    parentOffset = (*lastIt)->Offset;
-                }
+            inline bool ConvertScalar(const char* data, const size_t size, bool& value)
+            {
+                return Cpl::ToVal(data, size, value);
+            }
 
-                std::list<ReaderLine*>::iterator lastNotEmpty = it++;
+            inline bool ConvertScalar(const char* data, const size_t size, std::string& value)
+            {
+                value.assign(data, size);
+                return true;
+            }
 
-                // Find last empty lines
-                while (it != m_Lines.end())
+            template<class V> class ScalarBinding : public Binding
+            {
+            public:
+                static const Binding* Get()
                 {
-                    pLine = *it;
-                    pLine->Type = Node::ScalarType;
-                    if (pLine->Data.size())
-                    {
-                        if (pLine->Offset <= parentOffset)
-                        {
-                            break;
-                        }
-                        else
-                        {
-                            lastNotEmpty = it;
-                        }
-                    }
-                    ++it;
+                    static const ScalarBinding binding;
+                    return &binding;
                 }
 
-                ClearTrailingEmptyLines(++lastNotEmpty);
-            }
-
-            void ParseRoot(Node& root)
-            {
-                // Get first line and start type.
-                auto it = m_Lines.begin();
-                if (it == m_Lines.end())
+                const char* Name() const override
                 {
-                    return;
+                    return std::is_same<V, bool>::value ? "bool" : std::is_integral<V>::value ? "integer" :
+                        std::is_floating_point<V>::value ? "number" : "string";
                 }
-                Node::eType type = (*it)->Type;
-                ReaderLine* pLine = *it;
 
-                // Handle next line.
-                switch (type)
+                void Reset(void* pObject) const override
                 {
-                case Node::SequenceType:
-                    ParseSequence(root, it);
-                    break;
-                case Node::MapType:
-                    ParseMap(root, it);
-                    break;
-                case Node::ScalarType:
-                    ParseScalar(root, it);
-                    break;
-                default:
-                    break;
+                    *(V*)pObject = V();
                 }
 
-                if (it != m_Lines.end())
+                bool Scalar(void* pObject, const char* data, size_t size) const override
                 {
-                    throw InternalException(ExceptionMessage(Detail::ErrorUnexpectedDocumentEnd(), *pLine));
+                    return ConvertScalar(data, size, *(V*)pObject);
                 }
+            };
 
-            }
+            template<class V> struct BindingOf;
 
-            void ParseSequence(Node& node, std::list<ReaderLine*>::iterator& it)
+            /// A std::vector is loaded from a sequence or from a scalar with space separated items.
+            template<class V> class SequenceBinding : public Binding
             {
-                ReaderLine* pNextLine = nullptr;
-                while (it != m_Lines.end())
+            public:
+                SequenceBinding(const Binding* pItem, const std::shared_ptr<const Binding>& pOwned = nullptr)
+                    : m_pItem(pItem)
+                    , m_pOwned(pOwned)
                 {
-                    ReaderLine* pLine = *it;
-                    Node& childNode = node.PushBack();
-
-                    // Move to next line, error check.
-                    ++it;
-                    if (it == m_Lines.end())
-                    {
-                        throw InternalException(ExceptionMessage(Detail::ErrorUnexpectedDocumentEnd(), *pLine));
-                    }
-
-                    // Handle value of map
-                    Node::eType valueType = (*it)->Type;
-                    switch (valueType)
-                    {
-                    case Node::SequenceType:
-                        ParseSequence(childNode, it);
-                        break;
-                    case Node::MapType:
-                        ParseMap(childNode, it);
-                        break;
-                    case Node::ScalarType:
-                        ParseScalar(childNode, it);
-                        break;
-                    default:
-                        break;
-                    }
-
-                    if (it == m_Lines.end() || ((pNextLine = *it)->Offset < pLine->Offset))
-                    {
-                        break;
-                    }
-                    if (pNextLine->Offset > pLine->Offset)
-                    {
-                        throw ParsingException(ExceptionMessage(Detail::ErrorIncorrectOffset(), *pNextLine));
-                    }
-                    if (pNextLine->Type != Node::SequenceType)
-                    {
-                        throw InternalException(ExceptionMessage(Detail::ErrorDiffEntryNotAllowed(), *pNextLine));
-                    }
                 }
-            }
 
-            void ParseMap(Node& node, std::list<ReaderLine*>::iterator& it)
-            {
-                ReaderLine* pNextLine = nullptr;
-                while (it != m_Lines.end())
+                static const Binding* Get()
                 {
-                    ReaderLine* pLine = *it;
-                    Node& childNode = node[pLine->Data];
-
-                    // Move to next line, error check.
-                    ++it;
-                    if (it == m_Lines.end())
-                    {
-                        throw InternalException(ExceptionMessage(Detail::ErrorUnexpectedDocumentEnd(), *pLine));
-                    }
-
-                    // Handle value of map
-                    Node::eType valueType = (*it)->Type;
-                    switch (valueType)
-                    {
-                    case Node::SequenceType:
-                        ParseSequence(childNode, it);
-                        break;
-                    case Node::MapType:
-                        ParseMap(childNode, it);
-                        break;
-                    case Node::ScalarType:
-                        ParseScalar(childNode, it);
-                        break;
-                    default:
-                        break;
-                    }
-
-                    if (it == m_Lines.end() || ((pNextLine = *it)->Offset < pLine->Offset))
-                    {
-                        break;
-                    }
-                    if (pNextLine->Offset > pLine->Offset)
-                    {
-                        throw ParsingException(ExceptionMessage(Detail::ErrorIncorrectOffset(), *pNextLine));
-                    }
-                    if (pNextLine->Type != pLine->Type)
-                    {
-                        throw InternalException(ExceptionMessage(Detail::ErrorDiffEntryNotAllowed(), *pNextLine));
-                    }
+                    static const SequenceBinding binding(BindingOf<V>::Get());
+                    return &binding;
                 }
-            }
-
-            void ParseScalar(Node& node, std::list<ReaderLine*>::iterator& it)
-            {
-                std::string data = "";
-                ReaderLine* pFirstLine = *it;
-                ReaderLine* pLine = *it;
 
-                // Check if current line is a block scalar.
-                unsigned char blockFlags = 0;
-                bool isBlockScalar = IsBlockScalar(pLine->Data, pLine->No, blockFlags);
-                const bool newLineFlag = static_cast<bool>(blockFlags & ReaderLine::FlagMask(static_cast<size_t>(ReaderLine::ScalarNewlineFlag)));
-                const bool foldedFlag = static_cast<bool>(blockFlags & ReaderLine::FlagMask(static_cast<size_t>(ReaderLine::FoldedScalarFlag)));
-                const bool literalFlag = static_cast<bool>(blockFlags & ReaderLine::FlagMask(static_cast<size_t>(ReaderLine::LiteralScalarFlag)));
-                size_t parentOffset = 0;
+                const char* Name() const override
+                {
+                    return "sequence";
+                }
 
-                // Find parent offset
-                if (it != m_Lines.begin())
+                void Reset(void* pObject) const override
                 {
-                    std::list<ReaderLine*>::iterator parentIt = it;
-                    --parentIt;
-                    parentOffset = (*parentIt)->Offset;
+                    Clear(pObject);
                 }
 
-                // Move to next iterator/line if current line is a block scalar.
-                if (isBlockScalar)
+                bool Scalar(void* pObject, const char* data, size_t size) const override
                 {
-                    ++it;
-                    if (it == m_Lines.end() || (pLine = *it)->Type != Node::ScalarType)
+                    Clear(pObject);
+                    for (const char* beg = data, *end = data + size; beg < end;)
                     {
-                        return;
+                        const char* item = Cpl::Detail::NextItem(beg, end);
+                        const Binding* pItem;
+                        if (item < beg && m_pItem->Scalar(Append(pObject, pItem), item, beg - item) == false)
+                            return false;
                     }
+                    return true;
                 }
 
-                // Not a block scalar, cut end spaces/tabs
-                if (isBlockScalar == false)
+                bool IsSequence() const override
                 {
-                    while (1)
-                    {
-                        pLine = *it;
+                    return true;
+                }
 
-                        if (parentOffset != 0 && pLine->Offset <= parentOffset)
-                        {
-                            throw ParsingException(ExceptionMessage(Detail::ErrorIncorrectOffset(), *pLine));
-                        }
+                void Clear(void* pObject) const override
+                {
+                    ((std::vector<V>*)pObject)->clear();
+                }
 
-                        const size_t endOffset = pLine->Data.find_last_not_of(" \t");
-                        if (endOffset == std::string::npos)
-                        {
-                            data += "\n";
-                        }
-                        else
-                        {
-                            data += pLine->Data.substr(0, endOffset + 1);
-                        }
+                void* Append(void* pObject, const Binding*& pBinding) const override
+                {
+                    std::vector<V>& items = *(std::vector<V>*)pObject;
+                    items.emplace_back();
+                    m_pItem->Reset(&items.back());
+                    pBinding = m_pItem;
+                    return &items.back();
+                }
 
-                        // Move to next line
-                        ++it;
-                        if (it == m_Lines.end() || (*it)->Type != Node::ScalarType)
-                        {
-                            break;
-                        }
+            private:
+                const Binding* m_pItem;
+                std::shared_ptr<const Binding> m_pOwned;
+            };
 
-                        data += " ";
-                    }
+            template<class V> struct BindingOf
+            {
+                static const Binding* Get()
+                {
+                    return ScalarBinding<V>::Get();
+                }
+            };
 
-                    if (ValidateQuote(data) == false)
-                    {
-                        throw ParsingException(ExceptionMessage(Detail::ErrorInvalidQuote(), *pFirstLine));
-                    }
+            template<class V> struct BindingOf<std::vector<V>>
+            {
+                static const Binding* Get()
+                {
+                    return SequenceBinding<V>::Get();
                 }
-                // Block scalar
-                else
+            };
+
+            /// Handler which converts events of a document to the object of a binding. Unknown keys are skipped,
+            /// the first error stops loading: it is described by the path of the value and its position in the buffer.
+            class BindingLoader : public Handler
+            {
+            public:
+                BindingLoader(const Binding* pBinding, void* pObject, const char* buffer, const size_t size)
+                    : m_pBinding(pBinding)
+                    , m_pObject(pObject)
+                    , m_pKey(nullptr)
+                    , m_Item(std::string::npos)
+                    , m_Buffer(buffer)
+                    , m_Size(size)
+                    , m_pLast(buffer)
                 {
-                    pLine = *it;
-                    size_t blockOffset = pLine->Offset;
-                    if (blockOffset <= parentOffset)
-                    {
-                        throw ParsingException(ExceptionMessage(Detail::ErrorIncorrectOffset(), *pLine));
-                    }
+                }
 
-                    bool addedSpace = false;
-                    while (it != m_Lines.end() && (*it)->Type == Node::ScalarType)
-                    {
-                        pLine = *it;
+                const Status& LastStatus() const
+                {
+                    return m_Status;
+                }
 
-                        const size_t endOffset = pLine->Data.find_last_not_of(" \t");
-                        if (endOffset != std::string::npos && pLine->Offset < blockOffset)
-                        {
-                            throw ParsingException(ExceptionMessage(Detail::ErrorIncorrectOffset(), *pLine));
-                        }
+                bool MapStart() override
+                {
+                    if (Next() == false)
+                        return false;
+                    if (m_pBinding->IsMap() == false)
+                        return Error(ErrorBindingMap());
+                    Push();
+                    return true;
+                }
 
-                        if (endOffset == std::string::npos)
-                        {
-                            if (addedSpace)
-                            {
-                                data[data.size() - 1] = '\n';
-                                addedSpace = false;
-                            }
-                            else
-                            {
-                                data += "\n";
-                            }
+                void MapEnd() override
+                {
+                    m_Stack.pop_back();
+                }
 
-                            ++it;
-                            continue;
-                        }
-                        else
-                        {
-                            if (blockOffset != pLine->Offset && foldedFlag)
-                            {
-                                if (addedSpace)
-                                {
-                                    data[data.size() - 1] = '\n';
-                                    addedSpace = false;
-                                }
-                                else
-                                {
-                                    data += "\n";
-                                }
-                            }
-                            data += std::string(pLine->Offset - blockOffset, ' ');
-                            data += pLine->Data;
-                        }
+                bool SequenceStart() override
+                {
+                    if (Next() == false)
+                        return false;
+                    if (m_pBinding->IsSequence() == false)
+                        return Error(ErrorBindingSequence());
+                    m_pBinding->Clear(m_pObject);
+                    Push();
+                    return true;
+                }
 
-                        // Move to next line
-                        ++it;
-                        if (it == m_Lines.end() || (*it)->Type != Node::ScalarType)
-                        {
-                            if (newLineFlag)
-                            {
-                                data += "\n";
-                            }
-                            break;
-                        }
+                void SequenceEnd() override
+                {
+                    m_Stack.pop_back();
+                }
 
-                        if (foldedFlag)
-                        {
-                            data += " ";
-                            addedSpace = true;
-                        }
-                        else if (literalFlag && endOffset != std::string::npos)
-                        {
-                            data += "\n";
-                        }
-                    }
+                bool Key(const char* data, size_t size) override
+                {
+                    if (m_Status.Failed)
+                        return false;
+                    Track(data);
+                    const Frame& frame = m_Stack.back();
+                    m_pObject = frame.pBinding->Find(frame.pObject, data, size, m_pBinding, m_pKey);
+                    m_Item = std::string::npos;
+                    return m_pObject != nullptr;
                 }
 
-                if (data.size() && (data[0] == '"' || data[0] == '\''))
+                void Scalar(const char* data, size_t size) override
                 {
-                    data = data.substr(1, data.size() - 2);
+                    if (Next() == false)
+                        return;
+                    Track(data);
+                    // An empty value (also of a key without value) keeps the default.
+                    size_t i = 0;
+                    for (; i < size && Cpl::Detail::IsSpace(data[i]); ++i);
+                    if (i < size && m_pBinding->Scalar(m_pObject, data, size) == false)
+                        Error(ErrorBindingValue());
+                    m_pObject = nullptr;
                 }
 
-                node = data;
-            }
+                void Null() override
+                {
+                    if (Next())
+                        m_pObject = nullptr;
+                }
 
-            void Print()
-            {
-                for (auto it = m_Lines.begin(); it != m_Lines.end(); it++)
+                void Alias(const char* /*data*/, size_t /*size*/) override
                 {
+                    if (Next())
+                        Error(ErrorBindingAlias());
+                }
 
-                    ReaderLine* pLine = *it;
+            private:
+                struct Frame
+                {
+                    const Binding* pBinding;
+                    void* pObject;
+                    const std::string* pKey;
+                    size_t Item, Count;
+                };
 
-                    // Print type
-                    if (pLine->Type == Node::SequenceType)
-                    {
-                        std::cout << "seq ";
-                    }
-                    else if (pLine->Type == Node::MapType)
-                    {
-                        std::cout << "map ";
-                    }
-                    else if (pLine->Type == Node::ScalarType)
-                    {
-                        std::cout << "sca ";
-                    }
-                    else
+                /// Sets the object of the next value: the root, the field of the last key or a new sequence item.
+                bool Next()
+                {
+                    if (m_Status.Failed)
+                        return false;
+                    if (m_Stack.size() && m_Stack.back().pBinding->IsSequence())
                     {
-                        std::cout << "    ";
+                        Frame& frame = m_Stack.back();
+                        m_pObject = frame.pBinding->Append(frame.pObject, m_pBinding);
+                        m_pKey = nullptr;
+                        m_Item = frame.Count++;
                     }
+                    return m_pObject != nullptr;
+                }
 
-                    // Print flags
-                    if (pLine->GetFlag(ReaderLine::FoldedScalarFlag))
-                    {
-                        std::cout << "f";
-                    }
-                    else
-                    {
-                        std::cout << "-";
-                    }
-                    if (pLine->GetFlag(ReaderLine::LiteralScalarFlag))
-                    {
-                        std::cout << "l";
-                    }
-                    else
-                    {
-                        std::cout << "-";
-                    }
-                    if (pLine->GetFlag(ReaderLine::ScalarNewlineFlag))
-                    {
-                        std::cout << "n";
-                    }
-                    else
-                    {
-                        std::cout << "-";
-                    }
-                    if (pLine->NextLine == nullptr)
-                    {
-                        std::cout << "e";
-                    }
-                    else
-                    {
-                        std::cout << "-";
-                    }
+                void Push()
+                {
+                    m_Stack.push_back(Frame{ m_pBinding, m_pObject, m_pKey, m_Item, 0 });
+                    m_pObject = nullptr;
+                }
+
+                void Track(const char* data)
+                {
+                    if (data >= m_Buffer && data < m_Buffer + m_Size)
+                        m_pLast = data;
+                }
 
+                static void AppendPath(std::string& path, const std::string* pKey, const size_t item)
+                {
+                    if (pKey)
+                        path += (path.empty() ? "" : ".") + *pKey;
+                    else if (item != std::string::npos)
+                        path += "[" + std::to_string(item) + "]";
+                }
 
-                    std::cout << "| ";
-                    std::cout << pLine->No << " ";
-                    std::cout << std::string(pLine->Offset, ' ');
+                /// The error is described by the path of the value, its type and the line of the last key or scalar.
+                bool Error(const std::string& message)
+                {
+                    std::string path;
+                    for (size_t i = 0; i < m_Stack.size(); ++i)
+                        AppendPath(path, m_Stack[i].pKey, m_Stack[i].Item);
+                    AppendPath(path, m_pKey, m_Item);
 
-                    if (pLine->Type == Node::ScalarType)
+                    const char* begin = m_Buffer, *end = m_Buffer + m_Size;
+                    m_Status.Line = 1;
+                    for (const char* p = m_Buffer; p < m_pLast; ++p)
                     {
-                        std::string scalarValue = pLine->Data;
-                        for (size_t i = 0; (i = scalarValue.find("\n", i)) != std::string::npos;)
+                        if (*p == '\n')
                         {
-                            scalarValue.replace(i, 1, "\\n");
-                            i += 2;
+                            m_Status.Line++;
+                            begin = p + 1;
                         }
-                        std::cout << scalarValue << std::endl;
-                    }
-                    else if (pLine->Type == Node::MapType)
-                    {
-                        std::cout << pLine->Data + ":" << std::endl;
-                    }
-                    else if (pLine->Type == Node::SequenceType)
-                    {
-                        std::cout << "-" << std::endl;
-                    }
-                    else
-                    {
-                        std::cout << "> UNKOWN TYPE <" << std::endl;
                     }
+                    const char* lineEnd = begin;
+                    for (; lineEnd < end && *lineEnd != '\n' && *lineEnd != '\r'; ++lineEnd);
+
+                    m_Status.Failed = true;
+                    m_Status.Type = Exception::ParsingError;
+                    m_Status.Column = m_pLast - begin + 1;
+                    m_Status.Message = message + (path.empty() ? std::string(" Value") : " Field '" + path + "'") +
+                        " (" + m_pBinding->Name() + "). Line " + std::to_string(m_Status.Line) +
+                        " column " + std::to_string(m_Status.Column) + ": " + std::string(begin, lineEnd);
+                    return false;
                 }
+
+                const Binding* m_pBinding;
+                void* m_pObject;
+                const std::string* m_pKey;
+                size_t m_Item;
+                std::vector<Frame> m_Stack;
+                const char* m_Buffer;
+                size_t m_Size;
+                const char* m_pLast;
+                Status m_Status;
+            };
+        }
+
+        /*!
+        * \brief Schema of a plain struct: its fields are declared once by keys, member pointers and default values.
+        *
+        * YAML is loaded directly from parser events to the members (scalars are converted without intermediate
+        * nodes and strings). Fields are arithmetic, bool, std::string, std::vector of them (a sequence or a scalar
+        * with space separated items), nested structs and std::vector of nested structs (with own schemas).
+        * Missing keys get default values, unknown keys are skipped. Errors contain the path of the field and the line.
+        *
+        *   struct Server { std::string host; int port; std::vector<int> ids; };
+        *   Schema<Server> schema;
+        *   schema.Field("host", &Server::host, "localhost").Field("port", &Server::port, 80).Field("ids", &Server::ids);
+        *   Status status = schema.TryLoad(server, text);
+        */
+        template<class T> class Schema : public Detail::Binding
+        {
+        public:
+            /// Field of a scalar type or a std::vector of scalars.
+            template<class V> Schema& Field(const std::string& key, V T::* member, const typename std::common_type<V>::type& value = V())
+            {
+                m_Fields.push_back(std::make_shared<Member<V>>(key, member, Detail::BindingOf<V>::Get(), nullptr, &value));
+                return *this;
             }
 
-            void ClearLines()
+            /// Field of a nested struct, its missing fields get default values of its schema.
+            template<class S> Schema& Field(const std::string& key, S T::* member, const Schema<S>& schema)
             {
-                for (auto it = m_Lines.begin(); it != m_Lines.end(); it++)
-                {
-                    delete* it;
-                }
-                m_Lines.clear();
+                std::shared_ptr<const Detail::Binding> pSchema = std::make_shared<Schema<S>>(schema);
+                m_Fields.push_back(std::make_shared<Member<S>>(key, member, pSchema.get(), pSchema, nullptr));
+                return *this;
+            }
+
+            /// Field of a sequence of nested structs.
+            template<class S> Schema& Field(const std::string& key, std::vector<S> T::* member, const Schema<S>& schema)
+            {
+                std::shared_ptr<const Detail::Binding> pSchema = std::make_shared<Schema<S>>(schema);
+                std::shared_ptr<const Detail::Binding> pSequence = std::make_shared<Detail::SequenceBinding<S>>(pSchema.get(), pSchema);
+                m_Fields.push_back(std::make_shared<Member<std::vector<S>>>(key, member, pSequence.get(), pSequence, nullptr));
+                return *this;
+            }
+
+            /// Sets default values of all fields.
+            void Reset(T& object) const
+            {
+                Reset((void*)&object);
             }
 
-            void ClearTrailingEmptyLines(std::list<ReaderLine*>::iterator& it)
+            void Load(T& object, const char* buffer, const size_t size) const
             {
-                while (it != m_Lines.end())
+                Check(TryLoad(object, buffer, size));
+            }
+
+            void Load(T& object, const std::string& string) const
+            {
+                Check(TryLoad(object, string));
+            }
+
+            /// The file is loaded from its view (mapping).
+            void Load(T& object, const char* filename) const
+            {
+                Check(TryLoad(object, filename));
+            }
+
+            /// Loading which doesn't throw exceptions: the first error is returned (fields after it are not loaded).
+            Status TryLoad(T& object, const char* buffer, const size_t size) const
+            {
+                Reset(object);
+                Detail::BindingLoader loader(this, &object, buffer, size);
+                const Status status = Yaml::TryParse(loader, buffer, size);
+                return loader.LastStatus().Failed ? loader.LastStatus() : status;
+            }
+
+            Status TryLoad(T& object, const std::string& string) const
+            {
+                return TryLoad(object, string.data(), string.size());
+            }
+
+            Status TryLoad(T& object, const char* filename) const
+            {
+                Detail::FileView file;
+                if (file.Open(filename) == false)
+                    return Detail::CannotOpenFile();
+                return TryLoad(object, file.Data(), file.Size());
+            }
+
+            const char* Name() const override
+            {
+                return "map";
+            }
+
+            void Reset(void* pObject) const override
+            {
+                for (size_t i = 0; i < m_Fields.size(); ++i)
+                    m_Fields[i]->Reset(*(T*)pObject);
+            }
+
+            bool IsMap() const override
+            {
+                return true;
+            }
+
+            void* Find(void* pObject, const char* key, size_t size, const Detail::Binding*& pBinding, const std::string*& pKey) const override
+            {
+                for (size_t i = 0; i < m_Fields.size(); ++i)
                 {
-                    ReaderLine* pLine = *it;
-                    if (pLine->Data.size() == 0)
+                    const FieldBase& field = *m_Fields[i];
+                    if (field.Key.size() == size && memcmp(field.Key.data(), key, size) == 0)
                     {
-                        delete* it;
-                        it = m_Lines.erase(it);
-                    }
-                    else
-                    {
-                        return;
+                        pBinding = field.pBinding;
+                        pKey = &field.Key;
+                        return field.Get(*(T*)pObject);
                     }
-
                 }
+                return nullptr;
             }
 
-            static bool IsSequenceStart(const std::string& data)
+        private:
+            struct FieldBase
             {
-                if (data.size() == 0 || data[0] != '-')
+                FieldBase(const std::string& key, const Detail::Binding* pBinding, const std::shared_ptr<const Detail::Binding>& pOwned)
+                    : Key(key)
+                    , pBinding(pBinding)
+                    , pOwned(pOwned)
                 {
-                    return false;
                 }
 
-                if (data.size() >= 2 && data[1] != ' ')
-                {
-                    return false;
-                }
+                virtual ~FieldBase() {}
+                virtual void* Get(T& object) const = 0;
+                virtual void Reset(T& object) const = 0;
 
-                return true;
-            }
+                std::string Key;
+                const Detail::Binding* pBinding;
+                std::shared_ptr<const Detail::Binding> pOwned;
+            };
 
-            static bool IsBlockScalar(const std::string& data, const size_t line, unsigned char& flags)
+            /// Field of a member, without default value it is reset by its binding.
+            template<class V> struct Member : public FieldBase
             {
-                flags = 0;
-                if (data.size() == 0)
+                Member(const std::string& key, V T::* member, const Detail::Binding* pBinding, const std::shared_ptr<const Detail::Binding>& pOwned, const V* pValue)
+                    : FieldBase(key, pBinding, pOwned)
+                    , Pointer(member)
+                    , Value(pValue ? *pValue : V())
+                    , Default(pValue != nullptr)
                 {
-                    return false;
                 }
 
-                if (data[0] == '|')
+                void* Get(T& object) const override
                 {
-                    if (data.size() >= 2)
-                    {
-                        if (data[1] != '-' && data[1] != ' ' && data[1] != '\t')
-                        {
-                            throw ParsingException(ExceptionMessage(Detail::ErrorInvalidBlockScalar(), line, data));
-                        }
-                    }
-                    else
-                    {
-                        flags |= ReaderLine::FlagMask(static_cast<size_t>(ReaderLine::ScalarNewlineFlag));
-                    }
-                    flags |= ReaderLine::FlagMask(static_cast<size_t>(ReaderLine::LiteralScalarFlag));
-                    return true;
+                    return &(object.*Pointer);
                 }
 
-                if (data[0] == '>')
+                void Reset(T& object) const override
                 {
-                    if (data.size() >= 2)
-                    {
-                        if (data[1] != '-' && data[1] != ' ' && data[1] != '\t')
-                        {
-                            throw ParsingException(ExceptionMessage(Detail::ErrorInvalidBlockScalar(), line, data));
-                        }
-                    }
+                    if (Default)
+                        object.*Pointer = Value;
                     else
-                    {
-                        flags |= ReaderLine::FlagMask(static_cast<size_t>(ReaderLine::ScalarNewlineFlag));
-                    }
-                    flags |= ReaderLine::FlagMask(static_cast<size_t>(ReaderLine::FoldedScalarFlag));
-                    return true;
+                        this->pBinding->Reset(&(object.*Pointer));
                 }
 
-                return false;
-            }
-
-            std::list<ReaderLine*> m_Lines;    ///< List of lines.
-
-        };
-
-        //-----------------------------------------------------------------------------------------
-
-        inline void Parse(Node& root, const char* filename)
-        {
-            std::ifstream f(filename, std::ifstream::binary);
-            if (f.is_open() == false)
-            {
-                throw OperationException(Detail::ErrorCannotOpenFile());
-            }
-
-            f.seekg(0, f.end);
-            size_t fileSize = static_cast<size_t>(f.tellg());
-            f.seekg(0, f.beg);
-
-            std::unique_ptr<char[]> data(new char[fileSize]);
-            f.read(data.get(), fileSize);
-            f.close();
-
-            Parse(root, data.get(), fileSize);
-        }
-
-        inline void Parse(Node& root, std::istream& stream)
-        {
-            ParseImp* pImp = nullptr;
+                V T::* Pointer;
+                V Value;
+                bool Default;
+            };
 
-            try
+            static void Check(const Status& status)
             {
-                pImp = new ParseImp;
-                pImp->Parse(root, stream);
-                delete pImp;
+                if (status.Failed)
+                    Detail::Throw(status);
             }
-            catch (const Exception e)
-            {
-                delete pImp;
-                throw;
-            }
-        }
-
-        inline void Parse(Node& root, const std::string& string)
-        {
-            std::stringstream ss(string);
-            Parse(root, ss);
-        }
 
-        inline void Parse(Node& root, const char* buffer, const size_t size)
-        {
-            std::stringstream ss(std::string(buffer, size));
-            Parse(root, ss);
-        }
+            std::vector<std::shared_ptr<const FieldBase>> m_Fields;
+        };
 
         //-----------------------------------------------------------------------------------------
 
@@ -2380,235 +5728,457 @@ namespace Cpl
 
         inline void Serialize(const Node& root, const char* filename, const SerializeConfig& config)
         {
-            std::stringstream stream;
-            Serialize(root, stream, config);
+            std::string string;
+            Serialize(root, string, config);
 
             std::ofstream f(filename);
             if (f.is_open() == false)
             {
-                throw OperationException(Detail::ErrorCannotOpenFile());
+                CPL_YAML_THROW(OperationException(Detail::ErrorCannotOpenFile()));
             }
 
-            f.write(stream.str().c_str(), stream.str().size());
+            f.write(string.c_str(), string.size());
             f.close();
         }
 
-        inline size_t LineFolding(const std::string& input, std::vector<std::string>& folded, const size_t maxLength)
+        namespace Detail
         {
-            folded.clear();
-            if (input.size() == 0)
+            /// Writes YAML text of a node tree into one growable buffer.
+            class Serializer
             {
-                return 0;
-            }
-
-            size_t currentPos = 0;
-            size_t lastPos = 0;
-            size_t spacePos = std::string::npos;
-            while (currentPos < input.size())
-            {
-                currentPos = lastPos + maxLength;
-
-                if (currentPos < input.size())
+            public:
+                Serializer(const SerializeConfig& config)
+                    : m_Config(config)
                 {
-                    spacePos = input.find_first_of(' ', currentPos);
+                    memset(m_Cited, 0, sizeof(m_Cited));
+                    for (const char* token = "\":{}[],&*#?|-<>=!%@"; *token; ++token)
+                        m_Cited[(unsigned char)*token] = true;
                 }
 
-                if (spacePos == std::string::npos || currentPos >= input.size())
+                void Serialize(const Node& root)
                 {
-                    const std::string endLine = input.substr(lastPos);
-                    if (endLine.size())
+                    m_Buffer.clear();
+                    m_Anchors.clear();
+                    m_AnchorNames.clear();
+                    m_Renamed.clear();
+                    m_AnchorCount = 0;
+                    FindShared((const NodeImp*)root.m_pImp);
+                    if (m_Anchors.size())
                     {
-                        folded.push_back(endLine);
+                        for (std::unordered_map<const NodeImp*, size_t>::iterator it = m_Anchors.begin(); it != m_Anchors.end();)
+                        {
+                            if (it->second < 2)
+                                it = m_Anchors.erase(it);
+                            else
+                            {
+                                // A name which is redefined for other node in the document is kept only for one of them.
+                                if (it->first->m_Anchor && m_AnchorNames.insert(it->first->m_Anchor).second == false)
+                                    m_Renamed.insert(it->first);
+                                (it++)->second = 0;
+                            }
+                        }
                     }
-
-                    return folded.size();
+                    Write((const NodeImp*)root.m_pImp, false, 0);
                 }
 
-                folded.push_back(input.substr(lastPos, spacePos - lastPos));
-
-                lastPos = spacePos + 1;
-            }
+                std::string& Buffer()
+                {
+                    return m_Buffer;
+                }
 
-            return folded.size();
-        }
+            protected:
+                struct Segment
+                {
+                    const char* data;
+                    size_t size;
+                };
 
-        inline void SerializeLoop(const Node& node, std::ostream& stream, bool useLevel, const size_t level, const SerializeConfig& config)
-        {
-            const size_t indention = config.SpaceIndentation;
+                void Indent(size_t level)
+                {
+                    static const char spaces[] = "                                                                ";
+                    const size_t size = sizeof(spaces) - 1;
+                    for (; level > size; level -= size)
+                        m_Buffer.append(spaces, size);
+                    m_Buffer.append(spaces, level);
+                }
 
-            switch (node.Type())
-            {
-            case Node::SequenceType:
-            {
-                for (auto it = node.Begin(); it != node.End(); it++)
+                bool ShouldBeCited(const char* data, size_t size) const
                 {
-                    const Node& value = (*it).second;
-                    if (value.IsNone())
+                    for (size_t i = 0; i < size; ++i)
                     {
-                        continue;
+                        if (m_Cited[(unsigned char)data[i]])
+                            return true;
                     }
-                    stream << std::string(level, ' ') << "- ";
-                    useLevel = false;
-                    if (value.IsSequence() || (value.IsMap() && config.SequenceMapNewline == true))
+                    return false;
+                }
+
+                /// Writes key with escaped '\\' and '"'.
+                void WriteKey(const char* key, size_t size)
+                {
+                    for (size_t pos = FindFirstOf(key, size, '\\', '"'); pos < size; pos = FindFirstOf(key, size, '\\', '"'))
                     {
-                        useLevel = true;
-                        stream << "\n";
+                        m_Buffer.append(key, pos);
+                        m_Buffer.push_back('\\');
+                        m_Buffer.push_back(key[pos]);
+                        key += pos + 1;
+                        size -= pos + 1;
                     }
-
-                    SerializeLoop(value, stream, useLevel, level + 2, config);
+                    m_Buffer.append(key, size);
                 }
 
-            }
-            break;
-            case Node::MapType:
-            {
-                size_t count = 0;
-                for (auto it = node.Begin(); it != node.End(); it++)
+                /// Writes key of map entry with ": ", it is quoted if it has special characters.
+                void WriteMapKey(const char* key, size_t size)
                 {
-                    const Node& value = (*it).second;
-                    if (value.IsNone())
+                    if (ShouldBeCited(key, size))
                     {
-                        continue;
+                        m_Buffer.push_back('"');
+                        WriteKey(key, size);
+                        m_Buffer.append("\": ", 3);
                     }
-
-                    if (useLevel || count > 0)
+                    else
                     {
-                        stream << std::string(level, ' ');
+                        WriteKey(key, size);
+                        m_Buffer.append(": ", 2);
                     }
+                }
 
-                    std::string key = (*it).first;
-                    AddEscapeTokens(key, "\\\"");
-                    if (ShouldBeCited(key))
+                /// Splits line by spaces after each maxLength characters.
+                size_t LineFolding(Segment line, const size_t maxLength)
+                {
+                    m_Lines.clear();
+                    if (line.size == 0)
+                        return 0;
+                    size_t currentPos = 0, lastPos = 0, spacePos = std::string::npos;
+                    while (currentPos < line.size)
                     {
-                        stream << "\"" << key << "\"" << ": ";
+                        currentPos = lastPos + maxLength;
+                        if (currentPos < line.size)
+                        {
+                            const void* space = memchr(line.data + currentPos, ' ', line.size - currentPos);
+                            spacePos = space ? (const char*)space - line.data : std::string::npos;
+                        }
+                        if (spacePos == std::string::npos || currentPos >= line.size)
+                        {
+                            if (line.size > lastPos)
+                                m_Lines.push_back({ line.data + lastPos, line.size - lastPos });
+                            return m_Lines.size();
+                        }
+                        m_Lines.push_back({ line.data + lastPos, spacePos - lastPos });
+                        lastPos = spacePos + 1;
                     }
-                    else
+                    return m_Lines.size();
+                }
+
+                /// Counts references to nodes of parsed aliases, subtree of each one is visited once. Copy-on-write copies
+                /// are written in full. Nodes which are referred more than once in the tree are written once with anchor.
+                void FindShared(const NodeImp* pImp)
+                {
+                    for (size_t i = 0, n = pImp->Size(); i < n; ++i)
                     {
-                        stream << key << ": ";
+                        const NodeImp* pValue = (const NodeImp*)pImp->Item(i).m_pImp;
+                        if (pValue->m_Anchored == false || m_Anchors[pValue]++ == 0)
+                            FindShared(pValue);
                     }
+                }
 
-
-                    useLevel = false;
-                    if (value.IsScalar() == false || (value.IsScalar() && config.MapScalarNewline))
+                /// Writes anchor (&name) before the first occurrence of shared node or alias (*name) instead of the next ones.
+                /// Names of parsed anchors are kept, other shared nodes (e.g. values of merged maps) get numbers
+                /// which don't match the names. Returns false if the alias is written and the node itself is not needed.
+                bool WriteAnchor(const NodeImp* pImp, bool& anchored)
+                {
+                    anchored = false;
+                    if (m_Anchors.empty())
+                        return true;
+                    std::unordered_map<const NodeImp*, size_t>::iterator it = m_Anchors.find(pImp);
+                    if (it == m_Anchors.end())
+                        return true;
+                    const char* name = pImp->m_Anchor && (m_Renamed.empty() || m_Renamed.count(pImp) == 0) ? pImp->m_Anchor : nullptr;
+                    anchored = it->second == 0;
+                    if (anchored)
                     {
-                        useLevel = true;
-                        stream << "\n";
+                        if (name)
+                            it->second = std::string::npos;
+                        else
+                        {
+                            while (m_AnchorNames.count(std::to_string(++m_AnchorCount)))
+                                ;
+                            it->second = m_AnchorCount;
+                        }
                     }
-
-                    SerializeLoop(value, stream, useLevel, level + indention, config);
-
-                    useLevel = true;
-                    count++;
+                    m_Buffer.push_back(anchored ? '&' : '*');
+                    if (name)
+                        m_Buffer.append(name);
+                    else
+                        m_Buffer.append(std::to_string(it->second));
+                    return anchored;
                 }
 
-            }
-            break;
-            case Node::ScalarType:
-            {
-                const std::string value = node.As<std::string>();
-
-                // Empty scalar
-                if (value.size() == 0)
+                /// Sequence or map which is written in flow style: it has the style and its keys and scalars
+                /// have no line breaks, quotes or backslashes (such content keeps block style).
+                static bool IsFlow(const NodeImp* pImp)
                 {
-                    stream << "\n";
-                    break;
+                    if (pImp->m_Flow == false || (pImp->m_Type != Node::SequenceType && pImp->m_Type != Node::MapType))
+                        return false;
+                    const bool map = pImp->m_Type == Node::MapType;
+                    for (size_t i = 0, n = pImp->Size(); i < n; ++i)
+                    {
+                        const NodeImp* pValue = (const NodeImp*)pImp->Item(i).m_pImp;
+                        if (map && IsFlowScalar(pImp->Key(i), pImp->KeySize(i)) == false)
+                            return false;
+                        if (pValue->m_Type == Node::ScalarType ? IsFlowScalar(pValue->m_Value, pValue->m_Size) == false :
+                            pValue->m_Type != Node::None && IsFlow(pValue) == false)
+                            return false;
+                    }
+                    return true;
                 }
 
-                // Get lines of scalar.
-                std::string line = "";
-                std::vector<std::string> lines;
-                std::istringstream iss(value);
-                while (iss.eof() == false)
+                static bool IsFlowScalar(const char* data, size_t size)
                 {
-                    std::getline(iss, line);
-                    lines.push_back(line);
+                    for (size_t i = 0; i < size; ++i)
+                    {
+                        if (data[i] == '\n' || data[i] == '"' || data[i] == '\\')
+                            return false;
+                    }
+                    return true;
                 }
 
-                // Block scalar
-                const std::string& lastLine = lines.back();
-                const bool endNewline = lastLine.size() == 0;
-                if (endNewline)
+                void WriteFlow(const NodeImp* pImp)
                 {
-                    lines.pop_back();
+                    switch (pImp->m_Type)
+                    {
+                    case Node::SequenceType:
+                    case Node::MapType:
+                    {
+                        const bool map = pImp->m_Type == Node::MapType;
+                        m_Buffer.push_back(map ? '{' : '[');
+                        for (size_t i = 0, n = pImp->Size(), count = 0; i < n; ++i)
+                        {
+                            const NodeImp* pValue = (const NodeImp*)pImp->Item(i).m_pImp;
+                            if (pValue->m_Type == Node::None)
+                                continue;
+                            if (count++)
+                                m_Buffer.append(", ", 2);
+                            if (map)
+                            {
+                                WriteFlowScalar(pImp->Key(i), pImp->KeySize(i));
+                                m_Buffer.append(": ", 2);
+                            }
+                            bool anchored;
+                            if (WriteAnchor(pValue, anchored) == false)
+                                continue;
+                            if (anchored)
+                                m_Buffer.push_back(' ');
+                            WriteFlow(pValue);
+                        }
+                        m_Buffer.push_back(map ? '}' : ']');
+                        break;
+                    }
+                    case Node::ScalarType:
+                        WriteFlowScalar(pImp->m_Value, pImp->m_Size);
+                        break;
+                    default:
+                        break;
+                    }
                 }
 
-                // Literal
-                if (lines.size() > 1)
+                /// Flow scalar is quoted if it is empty, has outer spaces, flow indicators, comment or leading indicator.
+                void WriteFlowScalar(const char* data, size_t size)
                 {
-                    stream << "|";
+                    const bool cited = size == 0 || data[0] == ' ' || data[size - 1] == ' ' || memchr("'&*!|>%@?", data[0], 9) ||
+                        FindFlowIndicator(data, size) < size || memchr(data, '#', size);
+                    if (cited)
+                        m_Buffer.push_back('"');
+                    m_Buffer.append(data, size);
+                    if (cited)
+                        m_Buffer.push_back('"');
                 }
-                // Folded/plain
-                else
+
+                void Write(const NodeImp* pImp, bool useLevel, const size_t level)
                 {
-                    const std::string frontLine = lines.front();
-                    if (config.ScalarMaxLength == 0 || lines.front().size() <= config.ScalarMaxLength ||
-                        LineFolding(frontLine, lines, config.ScalarMaxLength) == 1)
+                    if (IsFlow(pImp))
                     {
                         if (useLevel)
+                            Indent(level);
+                        WriteFlow(pImp);
+                        m_Buffer.push_back('\n');
+                        return;
+                    }
+                    switch (pImp->m_Type)
+                    {
+                    case Node::SequenceType:
+                        for (size_t i = 0, n = pImp->Size(); i < n; ++i)
+                        {
+                            const NodeImp* pValue = (const NodeImp*)pImp->Item(i).m_pImp;
+                            if (pValue->m_Type == Node::None)
+                                continue;
+                            Indent(level);
+                            m_Buffer.append("- ", 2);
+                            bool anchored;
+                            if (WriteAnchor(pValue, anchored) == false)
+                            {
+                                m_Buffer.push_back('\n');
+                                continue;
+                            }
+                            useLevel = false;
+                            if ((pValue->m_Type == Node::SequenceType || (pValue->m_Type == Node::MapType && (m_Config.SequenceMapNewline || anchored))) && IsFlow(pValue) == false)
+                            {
+                                useLevel = true;
+                                m_Buffer.push_back('\n');
+                            }
+                            else if (anchored)
+                                m_Buffer.push_back(' ');
+                            Write(pValue, useLevel, level + 2);
+                        }
+                        break;
+                    case Node::MapType:
+                        for (size_t i = 0, n = pImp->Size(), count = 0; i < n; ++i)
                         {
-                            stream << std::string(level, ' ');
+                            const NodeImp* pValue = (const NodeImp*)pImp->Item(i).m_pImp;
+                            if (pValue->m_Type == Node::None)
+                                continue;
+                            if (useLevel || count > 0)
+                                Indent(level);
+                            WriteMapKey(pImp->Key(i), pImp->KeySize(i));
+                            useLevel = true;
+                            count++;
+                            bool anchored;
+                            if (WriteAnchor(pValue, anchored) == false)
+                            {
+                                m_Buffer.push_back('\n');
+                                continue;
+                            }
+                            if ((pValue->m_Type != Node::ScalarType && IsFlow(pValue) == false) || m_Config.MapScalarNewline)
+                            {
+                                m_Buffer.push_back('\n');
+                                Write(pValue, true, level + m_Config.SpaceIndentation);
+                                continue;
+                            }
+                            if (anchored)
+                                m_Buffer.push_back(' ');
+                            Write(pValue, false, level + m_Config.SpaceIndentation);
                         }
+                        break;
+                    case Node::ScalarType:
+                        WriteScalar(pImp->m_Value, pImp->m_Size, useLevel, level);
+                        break;
+                    default:
+                        break;
+                    }
+                }
+
+                void WriteScalar(const char* value, const size_t size, bool useLevel, const size_t level)
+                {
+                    // Empty scalar
+                    if (size == 0)
+                    {
+                        m_Buffer.push_back('\n');
+                        return;
+                    }
 
-                        if (ShouldBeCited(value))
+                    // Get lines of scalar.
+                    m_Lines.clear();
+                    for (const char* line = value, *end = value + size;;)
+                    {
+                        const char* lineEnd = (const char*)memchr(line, '\n', end - line);
+                        if (lineEnd == nullptr)
                         {
-                            stream << "\"" << value << "\"\n";
+                            m_Lines.push_back({ line, size_t(end - line) });
                             break;
                         }
-                        stream << value << "\n";
-                        break;
+                        m_Lines.push_back({ line, size_t(lineEnd - line) });
+                        line = lineEnd + 1;
                     }
+
+                    // Block scalar
+                    const bool endNewline = m_Lines.back().size == 0;
+                    if (endNewline)
+                        m_Lines.pop_back();
+
+                    // Literal
+                    if (m_Lines.size() > 1)
+                        m_Buffer.push_back('|');
+                    // Folded/plain
                     else
                     {
-                        stream << ">";
+                        const Segment frontLine = m_Lines.front();
+                        if (m_Config.ScalarMaxLength == 0 || frontLine.size <= m_Config.ScalarMaxLength ||
+                            LineFolding(frontLine, m_Config.ScalarMaxLength) == 1)
+                        {
+                            if (useLevel)
+                                Indent(level);
+                            if (ShouldBeCited(value, size))
+                            {
+                                m_Buffer.push_back('"');
+                                m_Buffer.append(value, size);
+                                m_Buffer.append("\"\n", 2);
+                            }
+                            else
+                            {
+                                m_Buffer.append(value, size);
+                                m_Buffer.push_back('\n');
+                            }
+                            return;
+                        }
+                        m_Buffer.push_back('>');
                     }
-                }
 
-                if (endNewline == false)
-                {
-                    stream << "-";
-                }
-                stream << "\n";
+                    if (endNewline == false)
+                        m_Buffer.push_back('-');
+                    m_Buffer.push_back('\n');
 
-
-                for (auto it = lines.begin(); it != lines.end(); it++)
-                {
-                    stream << std::string(level, ' ') << (*it) << "\n";
+                    for (size_t i = 0; i < m_Lines.size(); ++i)
+                    {
+                        Indent(level);
+                        m_Buffer.append(m_Lines[i].data, m_Lines[i].size);
+                        m_Buffer.push_back('\n');
+                    }
                 }
-            }
-            break;
 
-            default:
-                break;
-            }
+                const SerializeConfig& m_Config;
+                bool m_Cited[256];              ///< Characters which require quoting.
+                std::vector<Segment> m_Lines;   ///< Lines of current scalar.
+                std::string m_Buffer;
+                std::unordered_map<const NodeImp*, size_t> m_Anchors; ///< Shared nodes and numbers of their anchors.
+                std::unordered_set<std::string> m_AnchorNames; ///< Names of parsed anchors which are written.
+                std::unordered_set<const NodeImp*> m_Renamed; ///< Shared nodes which anchor names are taken by other nodes.
+                size_t m_AnchorCount;
+            };
         }
 
         inline void Serialize(const Node& root, std::ostream& stream, const SerializeConfig& config)
         {
             if (config.SpaceIndentation < 2)
             {
-                throw OperationException(Detail::ErrorIndentation());
+                CPL_YAML_THROW(OperationException(Detail::ErrorIndentation()));
             }
 
-            SerializeLoop(root, stream, false, 0, config);
+            Detail::Serializer serializer(config);
+            serializer.Serialize(root);
+            stream.write(serializer.Buffer().data(), serializer.Buffer().size());
         }
 
         inline void Serialize(const Node& root, std::string& string, const SerializeConfig& config)
         {
-            std::stringstream stream;
-            Serialize(root, stream, config);
-            string = stream.str();
+            if (config.SpaceIndentation < 2)
+            {
+                CPL_YAML_THROW(OperationException(Detail::ErrorIndentation()));
+            }
+
+            Detail::Serializer serializer(config);
+            serializer.Serialize(root);
+            string.swap(serializer.Buffer());
         }
 
         //-----------------------------------------------------------------------------------------
 
-        inline std::string ExceptionMessage(const std::string& message, ReaderLine& line)
+        inline std::string ExceptionMessage(const std::string& message, const ReaderLine& line)
         {
-            return message + std::string(" Line ") + std::to_string(line.No) + std::string(": ") + line.Data;
+            return message + std::string(" Line ") + std::to_string(line.No) + std::string(": ") + line.Str();
         }
 
-        inline std::string ExceptionMessage(const std::string& message, ReaderLine& line, const size_t errorPos)
+        inline std::string ExceptionMessage(const std::string& message, const ReaderLine& line, const size_t errorPos)
         {
-            return message + std::string(" Line ") + std::to_string(line.No) + std::string(" column ") + std::to_string(errorPos + 1) + std::string(": ") + line.Data;
+            return message + std::string(" Line ") + std::to_string(line.No) + std::string(" column ") + std::to_string(errorPos + 1) + std::string(": ") + line.Str();
         }
 
         inline std::string ExceptionMessage(const std::string& message, const size_t errorLine, const size_t errorPos)
@@ -2621,17 +6191,17 @@ namespace Cpl
             return message + std::string(" Line ") + std::to_string(errorLine) + std::string(": ") + data;
         }
 
-        inline bool FindQuote(const std::string& input, size_t& start, size_t& end, size_t searchPos)
+        inline bool FindQuote(const char* input, const size_t size, size_t& start, size_t& end, size_t searchPos)
         {
             start = end = std::string::npos;
             size_t qPos = searchPos;
             bool foundStart = false;
 
-            while (qPos != std::string::npos)
+            while (qPos < size)
             {
                 // Find first quote.
-                qPos = input.find_first_of("\"'", qPos);
-                if (qPos == std::string::npos)
+                qPos += Detail::FindFirstOf(input + qPos, size - qPos, '"', '\'');
+                if (qPos == size)
                 {
                     return false;
                 }
@@ -2654,7 +6224,7 @@ namespace Cpl
                 }
 
                 // Check if it's possible for another loop.
-                if (qPos + 1 == input.size())
+                if (qPos + 1 == size)
                 {
                     return false;
                 }
@@ -2664,43 +6234,57 @@ namespace Cpl
             return false;
         }
 
-        inline size_t FindNotCited(const std::string& input, char token, size_t& preQuoteCount)
+        inline bool FindQuote(const std::string& input, size_t& start, size_t& end, size_t searchPos)
+        {
+            return FindQuote(input.data(), input.size(), start, end, searchPos);
+        }
+
+        inline size_t FindNotCited(const char* input, const size_t size, char token, size_t& preQuoteCount)
         {
             preQuoteCount = 0;
-            size_t tokenPos = input.find_first_of(token);
-            if (tokenPos == std::string::npos)
-                return std::string::npos;
-            std::vector<std::pair<size_t, size_t>> quotes;
-            size_t quoteStart = 0;
-            size_t quoteEnd = 0;
-            while (FindQuote(input, quoteStart, quoteEnd, quoteEnd))
-            {
-                quotes.push_back({ quoteStart, quoteEnd });
-                if (quoteEnd + 1 == input.size())
-                    break;
-                quoteEnd++;
-            }
-            if (quotes.size() == 0)
-                return tokenPos;
-            size_t currentQuoteIndex = 0;
-            std::pair<size_t, size_t> currentQuote = { 0, 0 };
-            while (currentQuoteIndex < quotes.size())
+
+            // Token inside of a cited part is taken if the quote isn't closed.
+            size_t open = std::string::npos, pending = std::string::npos, pendingQuotes = 0;
+            for (size_t pos = Detail::FindFirstOf(input, size, token, '"'); pos < size; pos += 1 + Detail::FindFirstOf(input + pos + 1, size - pos - 1, token, '"'))
             {
-                currentQuote = quotes[currentQuoteIndex];
-                if (tokenPos < currentQuote.first)
-                    return tokenPos;
-                preQuoteCount++;
-                if (tokenPos <= currentQuote.second)
+                if (input[pos] == token)
                 {
-                    if (tokenPos + 1 == input.size())
-                        return std::string::npos;
-                    tokenPos = input.find_first_of(token, tokenPos + 1);
-                    if (tokenPos == std::string::npos)
-                        return std::string::npos;
+                    if (open == std::string::npos)
+                        return pos;
+                    if (pending == std::string::npos)
+                    {
+                        pending = pos;
+                        pendingQuotes = preQuoteCount;
+                    }
+                }
+                else if (pos == 0 || input[pos - 1] != '\\')
+                {
+                    if (open == std::string::npos)
+                        open = pos;
+                    else
+                    {
+                        open = pending = std::string::npos;
+                        preQuoteCount++;
+                    }
                 }
-                currentQuoteIndex++;
             }
-            return tokenPos;
+            if (open != std::string::npos && pending != std::string::npos)
+            {
+                preQuoteCount = pendingQuotes;
+                return pending;
+            }
+            return std::string::npos;
+        }
+
+        inline size_t FindNotCited(const char* input, const size_t size, char token)
+        {
+            size_t dummy = 0;
+            return FindNotCited(input, size, token, dummy);
+        }
+
+        inline size_t FindNotCited(const std::string& input, char token, size_t& preQuoteCount)
+        {
+            return FindNotCited(input.data(), input.size(), token, preQuoteCount);
         }
 
         inline size_t FindNotCited(const std::string& input, char token)
@@ -2709,60 +6293,66 @@ namespace Cpl
             return FindNotCited(input, token, dummy);
         }
 
-        inline bool ValidateQuote(const std::string& input)
+        inline bool ValidateQuote(const char* input, const size_t size)
         {
-            if (input.size() == 0)
+            if (size == 0)
                 return true;
             char token = 0;
             size_t searchPos = 0;
             if (input[0] == '\"' || input[0] == '\'')
             {
-                if (input.size() == 1)
+                if (size == 1)
                     return false;
                 token = input[0];
                 searchPos = 1;
             }
-            while (searchPos != std::string::npos && searchPos < input.size() - 1)
+            while (searchPos < size - 1)
             {
-                searchPos = input.find_first_of("\"'", searchPos + 1);
-                if (searchPos == std::string::npos)
+                for (searchPos++; searchPos < size && input[searchPos] != '\"' && input[searchPos] != '\''; searchPos++);
+                if (searchPos == size)
                     break;
                 const char foundToken = input[searchPos];
-                if (input[searchPos] == '\"' || input[searchPos] == '\'')
+                if (token == 0 && input[searchPos - 1] != '\\')
+                    return false;
+                if (foundToken == token && input[searchPos - 1] != '\\')
                 {
-                    if (token == 0 && input[searchPos - 1] != '\\')
-                        return false;
-                    if (foundToken == token && input[searchPos - 1] != '\\')
-                    {
-                        if (searchPos == input.size() - 1)
-                            return true;
-                        return false;
-                    }
+                    if (searchPos == size - 1)
+                        return true;
+                    return false;
                 }
             }
             return token == 0;
         }
 
+        inline bool ValidateQuote(const std::string& input)
+        {
+            return ValidateQuote(input.data(), input.size());
+        }
+
         inline void CopyNode(const Node& from, Node& to)
         {
             const Node::eType type = from.Type();
             switch (type)
             {
             case Node::SequenceType:
+                to.Mutable(true)->Init(type);
                 for (auto it = from.Begin(); it != from.End(); it++)
                 {
                     const Node& currentNode = (*it).second;
                     Node& newNode = to.PushBack();
                     CopyNode(currentNode, newNode);
                 }
+                to.SetFlow(from.IsFlow());
                 break;
             case Node::MapType:
+                to.Mutable(true)->Init(type);
                 for (auto it = from.Begin(); it != from.End(); it++)
                 {
                     const Node& currentNode = (*it).second;
                     Node& newNode = to[(*it).first];
                     CopyNode(currentNode, newNode);
                 }
+                to.SetFlow(from.IsFlow());
                 break;
             case Node::ScalarType:
                 to = from.As<std::string>();
@@ -2794,15 +6384,17 @@ namespace Cpl
 
         inline void RemoveAllEscapeTokens(std::string& input)
         {
-            size_t found = input.find_first_of("\\");
-            while (found != std::string::npos)
+            // Compacts the string in place, a trailing escape token is kept.
+            size_t src = input.find('\\'), dst = src;
+            if (src == std::string::npos)
+                return;
+            while (src < input.size())
             {
-                if (found + 1 == input.size())
-                    return;
-                std::string replace(1, input[found + 1]);
-                input.replace(found, 2, replace);
-                found = input.find_first_of("\\", found + 1);
+                if (input[src] == '\\' && src + 1 < input.size())
+                    src++;
+                input[dst++] = input[src++];
             }
+            input.resize(dst);
         }
     }
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -0,0 +1,984 @@
+/*
+* Common Purpose Library (http://github.com/ermig1979/Cpl).
+*
+* Copyright (c) 2021-2021 Yermalayeu Ihar.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include "Cpl/Yaml.h"
+#include "Cpl/Xml.h"
+
+namespace Cpl
+{
+    namespace Yaml
+    {
+        /**
+        * Transcodes YAML to XML without building of Node tree, the element conventions of Param are used:
+        * maps are written as elements named by their keys (keys which are not valid element names and "item"
+        * as <item><first>key</first><second>value</second></item>), sequences as <item> elements and flow sequences
+        * of words as space separated text. Aliases and merge keys are expanded. Output is written in the layout of Xml::Print().
+        * YAML doesn't tell a struct from a map, so entries of maps which keys are in maps (names of ParamMap parameters)
+        * are written as <item> pairs too, as Param saves them.
+        * The output written to std::ostream is flushed by chunks.
+        */
+        void ToXml(const char* buffer, const size_t size, std::string& xml, const Strings& maps = Strings());
+        void ToXml(const char* buffer, const size_t size, std::ostream& xml, const Strings& maps = Strings());
+        Status TryToXml(const char* buffer, const size_t size, std::string& xml, const Strings& maps = Strings());
+
+        /**
+        * Transcodes YAML read from the stream by chunks. Top-level entries (not indented lines) of the root block map
+        * or sequence are parsed and written by blocks of about the chunk size, so memory is bounded by the largest
+        * entry and recorded anchors instead of the whole input. Input which can't be split to entries (a flow or scalar
+        * root, a leading "---", merge keys of the root) is read as a whole. Only the first document is transcoded and,
+        * as DocumentReader does, a "---" after content ends it (ToXml() for a buffer takes the document after it).
+        * Otherwise the output is the same as of ToXml() for a buffer, on error it is incomplete.
+        */
+        void ToXml(std::istream& yaml, std::ostream& xml, const Strings& maps = Strings(), const size_t chunk = 64 * 1024);
+        Status TryToXml(std::istream& yaml, std::ostream& xml, const Strings& maps = Strings(), const size_t chunk = 64 * 1024);
+
+        /// Transcodes XML to YAML with the conventions of ToXml() without building of Node tree (attributes are ignored).
+        /// It is not streamed: the whole input is copied and parsed in situ to Xml::XmlDocument, so it takes memory for
+        /// a copy of the input, the XML nodes and attributes (about 100 bytes per element) and the YAML output.
+        void FromXml(const char* buffer, const size_t size, std::string& yaml, const SerializeConfig& config = { 2, 64, false, false });
+        Status TryFromXml(const char* buffer, const size_t size, std::string& yaml, const SerializeConfig& config = { 2, 64, false, false });
+
+        //-----------------------------------------------------------------------------------------
+
+        namespace Detail
+        {
+            /// Writes events of YAML document as XML (see ToXml()). Anchored values are recorded as events and replayed for aliases.
+            class XmlWriter : public Handler
+            {
+            public:
+                XmlWriter(std::ostream* pStream, const Strings& maps)
+                    : m_pStream(pStream)
+                    , m_Level(0)
+                    , m_Depth(0)
+                    , m_Pair(false)
+                    , m_PairMap(false)
+                    , m_Maps(maps.begin(), maps.end())
+                    , m_Merge(MergeNone)
+                    , m_Replay(0)
+                    , m_Anchored(false)
+                {
+                    m_Buffer.append("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n");
+                    Push(Frame::Root, 0, false);
+                }
+
+                bool MapStart() override
+                {
+                    return Start(EventMapStart);
+                }
+
+                void MapEnd() override
+                {
+                    Record(EventMapEnd);
+                    End();
+                    Recorded();
+                }
+
+                bool SequenceStart() override
+                {
+                    return Start(EventSequenceStart);
+                }
+
+                bool FlowSequenceStart() override
+                {
+                    return Start(EventFlowSequenceStart);
+                }
+
+                void SequenceEnd() override
+                {
+                    Record(EventSequenceEnd);
+                    if (m_Merge == MergeList)
+                        m_Merge = MergeNone;
+                    else
+                        End();
+                    Recorded();
+                }
+
+                bool Key(const char* data, size_t size) override
+                {
+                    Record(EventKey, data, size);
+                    if (size == 2 && data[0] == '<' && data[1] == '<')
+                        m_Merge = MergeKey;
+                    else
+                        SetKey(data, size);
+                    return true;
+                }
+
+                void Scalar(const char* data, size_t size) override
+                {
+                    Record(EventScalar, data, size);
+                    if (Merged(EventScalar, data, size) == false)
+                    {
+                        if (Top().kind == Frame::Flow && IsWord(data, size))
+                        {
+                            if (m_Words.size())
+                                m_Flow.push_back(' ');
+                            m_Flow.append(data, size);
+                            m_Words.push_back(m_Flow.size());
+                        }
+                        else
+                            Value(data, size);
+                    }
+                    Recorded();
+                }
+
+                void Null() override
+                {
+                    Record(EventNull);
+                    if (Merged(EventNull, nullptr, 0) == false)
+                        Value(nullptr, 0);
+                    Recorded();
+                }
+
+                void Anchor(const char* data, size_t size) override
+                {
+                    if (m_Replay)
+                        return;
+                    Record(EventAnchor, data, size);
+                    m_Recorders.push_back(Recorder(std::string(data, size), m_Tape.size(), m_Level));
+                    m_Anchored = true;
+                }
+
+                void Alias(const char* data, size_t size) override
+                {
+                    Record(EventAlias, data, size);
+                    if (Merged(EventAlias, data, size) == false)
+                    {
+                        Anchors::const_iterator it = m_Anchors.find(std::string(data, size));
+                        if (it != m_Anchors.end())
+                            Replay(it->second, 0, it->second.size());
+                        else
+                            Value(nullptr, 0);
+                    }
+                    Recorded();
+                }
+
+                /// Writes the rest of output to the stream or returns the whole output.
+                std::string& Finish()
+                {
+                    m_Buffer.push_back('\n'); // Xml::Print() ends the document by an empty line.
+                    if (m_pStream)
+                    {
+                        m_pStream->write(m_Buffer.data(), m_Buffer.size());
+                        m_Buffer.clear();
+                    }
+                    return m_Buffer;
+                }
+
+            private:
+                static const size_t FLUSH_SIZE = 64 * 1024;
+
+                enum EventType
+                {
+                    EventMapStart,
+                    EventMapEnd,
+                    EventSequenceStart,
+                    EventFlowSequenceStart,
+                    EventSequenceEnd,
+                    EventKey,
+                    EventScalar,
+                    EventNull,
+                    EventAnchor,
+                    EventAlias,
+                };
+
+                struct Event
+                {
+                    EventType type;
+                    std::string data;
+
+                    Event(EventType t, const char* d, size_t s) : type(t), data(d, s) {}
+                };
+                typedef std::vector<Event> Events;
+                typedef std::unordered_map<std::string, Events> Anchors;
+
+                /// Anchored value which events are recorded until the frames return to the level.
+                struct Recorder
+                {
+                    std::string name;
+                    size_t begin, level;
+
+                    Recorder(const std::string& n, size_t b, size_t l) : name(n), begin(b), level(l) {}
+                };
+
+                /// Open map or sequence, frames are reused to avoid allocations.
+                struct Frame
+                {
+                    enum Kind { Root, Map, Sequence, Flow } kind;
+                    std::string name;           ///< Name of element, it is empty for the root value.
+                    size_t depth, children;     ///< Indentation of the element and its children.
+                    size_t count;               ///< Number of written children.
+                    bool pair;                  ///< Element is <second> of <item> pair.
+                    bool pairs;                 ///< All entries of the map are written as <item> pairs.
+                    bool tracked;               ///< Keys of the map are collected to skip them in merged maps.
+                    Strings merges;             ///< Anchors of maps merged at the end of the map.
+                    std::unordered_set<std::string> keys;
+                };
+
+                enum MergeState
+                {
+                    MergeNone,
+                    MergeKey,   ///< Value of merge key is expected.
+                    MergeList,  ///< Sequence of merged aliases.
+                };
+
+                static bool IsName(const char* data, size_t size)
+                {
+                    if (size == 0 || (size == 4 && memcmp(data, "item", 4) == 0))
+                        return false;
+                    for (size_t i = 0; i < size; ++i)
+                    {
+                        const unsigned char c = data[i];
+                        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c >= 0x80)
+                            continue;
+                        if (i == 0 || ((c < '0' || c > '9') && c != '-' && c != '.'))
+                            return false;
+                    }
+                    return true;
+                }
+
+                static bool IsWord(const char* data, size_t size)
+                {
+                    if (size == 0)
+                        return false;
+                    for (size_t i = 0; i < size; ++i)
+                    {
+                        if (data[i] == ' ' || data[i] == '\t' || data[i] == '\n' || data[i] == '\r')
+                            return false;
+                    }
+                    return true;
+                }
+
+                static size_t ValueEnd(const Events& events, size_t i)
+                {
+                    while (i < events.size() && events[i].type == EventAnchor)
+                        i++;
+                    for (size_t level = 0; i < events.size();)
+                    {
+                        const EventType type = events[i++].type;
+                        if (type == EventMapStart || type == EventSequenceStart || type == EventFlowSequenceStart)
+                            level++;
+                        else if (type == EventMapEnd || type == EventSequenceEnd)
+                            level--;
+                        if (level == 0)
+                            break;
+                    }
+                    return i;
+                }
+
+                Frame& Top()
+                {
+                    return m_Frames[m_Level - 1];
+                }
+
+                Frame& Push(Frame::Kind kind, size_t depth, bool pair)
+                {
+                    if (m_Level == m_Frames.size())
+                        m_Frames.resize(m_Level + 1);
+                    Frame& frame = m_Frames[m_Level++];
+                    frame.kind = kind;
+                    frame.name.clear();
+                    frame.depth = depth;
+                    frame.children = 0;
+                    frame.count = 0;
+                    frame.pair = pair;
+                    frame.pairs = false;
+                    frame.tracked = m_Anchored;
+                    if (frame.keys.size())
+                        frame.keys.clear();
+                    return frame;
+                }
+
+                void Indent(size_t depth)
+                {
+                    m_Buffer.append(depth, '\t');
+                }
+
+                /// Writes text with XML entities as Xml::Print() does.
+                void Escape(const char* data, size_t size)
+                {
+                    size_t begin = 0;
+                    for (size_t i = 0; i < size; ++i)
+                    {
+                        const char* entity = nullptr;
+                        switch (data[i])
+                        {
+                        case '<': entity = "&lt;"; break;
+                        case '>': entity = "&gt;"; break;
+                        case '&': entity = "&amp;"; break;
+                        case '\'': entity = "&apos;"; break;
+                        case '"': entity = "&quot;"; break;
+                        default: continue;
+                        }
+                        m_Buffer.append(data + begin, i - begin);
+                        m_Buffer.append(entity);
+                        begin = i + 1;
+                    }
+                    m_Buffer.append(data + begin, size - begin);
+                }
+
+                void Flush()
+                {
+                    if (m_pStream && m_Buffer.size() >= FLUSH_SIZE)
+                    {
+                        m_pStream->write(m_Buffer.data(), m_Buffer.size());
+                        m_Buffer.clear();
+                    }
+                }
+
+                void Record(EventType type, const char* data = nullptr, size_t size = 0)
+                {
+                    if (m_Replay == 0 && m_Recorders.size())
+                        m_Tape.push_back(Event(type, data ? data : "", size));
+                }
+
+                /// Stores events of completed anchored values.
+                void Recorded()
+                {
+                    if (m_Replay)
+                        return;
+                    while (m_Recorders.size() && m_Merge == MergeNone && m_Level == m_Recorders.back().level &&
+                        m_Tape.size() > m_Recorders.back().begin)
+                    {
+                        const Recorder& recorder = m_Recorders.back();
+                        m_Anchors[recorder.name].assign(m_Tape.begin() + recorder.begin, m_Tape.end());
+                        m_Recorders.pop_back();
+                    }
+                    if (m_Recorders.empty())
+                        m_Tape.clear();
+                }
+
+                void Replay(const Events& events, size_t begin, size_t end)
+                {
+                    m_Replay++;
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        const Event& event = events[i];
+                        switch (event.type)
+                        {
+                        case EventMapStart:
+                            if (MapStart() == false)
+                                i = ValueEnd(events, i) - 1;
+                            break;
+                        case EventSequenceStart:
+                            if (SequenceStart() == false)
+                                i = ValueEnd(events, i) - 1;
+                            break;
+                        case EventFlowSequenceStart:
+                            if (FlowSequenceStart() == false)
+                                i = ValueEnd(events, i) - 1;
+                            break;
+                        case EventMapEnd: MapEnd(); break;
+                        case EventSequenceEnd: SequenceEnd(); break;
+                        case EventKey: Key(event.data.data(), event.data.size()); break;
+                        case EventScalar: Scalar(event.data.data(), event.data.size()); break;
+                        case EventNull: Null(); break;
+                        case EventAlias: Alias(event.data.data(), event.data.size()); break;
+                        default: break;
+                        }
+                    }
+                    m_Replay--;
+                }
+
+                /// Handles value of merge key: aliases are merged at the end of the current map.
+                /// Other values are written as value of usual "<<" key, returns false in this case.
+                bool Merged(EventType type, const char* data, size_t size)
+                {
+                    if (m_Merge == MergeNone)
+                        return false;
+                    if (type == EventAlias)
+                    {
+                        Top().merges.push_back(std::string(data, size));
+                        if (m_Merge == MergeKey)
+                            m_Merge = MergeNone;
+                        return true;
+                    }
+                    if (m_Merge == MergeList)
+                        return true;
+                    m_Merge = MergeNone;
+                    if (type == EventSequenceStart || type == EventFlowSequenceStart)
+                    {
+                        m_Merge = MergeList;
+                        return true;
+                    }
+                    SetKey("<<", 2);
+                    return false;
+                }
+
+                /// Writes entries of merged maps which keys are absent in the current map.
+                void Merge()
+                {
+                    const size_t frame = m_Level - 1;
+                    m_Frames[frame].tracked = true;
+                    for (size_t m = 0; m < m_Frames[frame].merges.size(); ++m)
+                    {
+                        Anchors::const_iterator it = m_Anchors.find(m_Frames[frame].merges[m]);
+                        if (it == m_Anchors.end() || it->second.empty() || it->second[0].type != EventMapStart)
+                            continue;
+                        const Events& events = it->second;
+                        for (size_t i = 1, end; i < events.size() && events[i].type == EventKey; i = end)
+                        {
+                            end = ValueEnd(events, i + 1);
+                            if (events[i].data == "<<" || m_Frames[frame].keys.count(events[i].data) == 0)
+                                Replay(events, i, end);
+                        }
+                    }
+                    m_Frames[frame].merges.clear();
+                }
+
+                /// Sets element of the next map value, keys which are not valid names are written as <item> pairs.
+                void SetKey(const char* data, size_t size)
+                {
+                    Frame& frame = Top();
+                    if (frame.tracked)
+                        frame.keys.insert(std::string(data, size));
+                    m_PairMap = m_Maps.size() && m_Maps.count(std::string(data, size));
+                    if (frame.pairs == false && IsName(data, size))
+                    {
+                        m_Name.assign(data, size);
+                        m_Depth = frame.children;
+                        m_Pair = false;
+                        return;
+                    }
+                    Child();
+                    Indent(frame.children);
+                    m_Buffer.append("<item>\n");
+                    Indent(frame.children + 1);
+                    m_Buffer.append("<first>");
+                    Escape(data, size);
+                    m_Buffer.append("</first>\n");
+                    m_Name = "second";
+                    m_Depth = frame.children + 1;
+                    m_Pair = true;
+                }
+
+                /// Closes start tag of the current element before its first child.
+                void Child()
+                {
+                    Frame& frame = Top();
+                    if (frame.count++ == 0 && frame.name.size())
+                        m_Buffer.append(">\n", 2);
+                }
+
+                /// Flow sequence which has not only words is written as <item> elements.
+                void Unflow()
+                {
+                    Frame& frame = Top();
+                    frame.kind = Frame::Sequence;
+                    for (size_t i = 0, begin = 0; i < m_Words.size(); begin = m_Words[i++] + 1)
+                    {
+                        Child();
+                        Indent(frame.children);
+                        m_Buffer.append("<item>");
+                        Escape(m_Flow.data() + begin, m_Words[i] - begin);
+                        m_Buffer.append("</item>\n");
+                    }
+                    m_Flow.clear();
+                    m_Words.clear();
+                }
+
+                /// Starts element of the next value ("<name"), values of sequences and of the root are <item> elements.
+                void Open()
+                {
+                    Frame& frame = Top();
+                    if (frame.kind == Frame::Flow)
+                        Unflow();
+                    if (frame.kind != Frame::Map)
+                    {
+                        m_Name = "item";
+                        m_Depth = frame.children;
+                        m_Pair = false;
+                        m_PairMap = false;
+                    }
+                    Child();
+                    Indent(m_Depth);
+                    m_Buffer.push_back('<');
+                    m_Buffer.append(m_Name);
+                }
+
+                void Value(const char* data, size_t size)
+                {
+                    if (Top().kind == Frame::Root && size == 0)
+                        return;
+                    Open();
+                    if (size == 0)
+                        m_Buffer.append("/>\n", 3);
+                    else
+                    {
+                        m_Buffer.push_back('>');
+                        Escape(data, size);
+                        m_Buffer.append("</", 2);
+                        m_Buffer.append(m_Name);
+                        m_Buffer.append(">\n", 2);
+                    }
+                    if (m_Pair)
+                    {
+                        Indent(m_Depth - 1);
+                        m_Buffer.append("</item>\n");
+                    }
+                    Flush();
+                }
+
+                bool Start(EventType type)
+                {
+                    if (m_Merge == MergeList)
+                        return false;
+                    Record(type);
+                    if (Merged(type, nullptr, 0))
+                        return true;
+                    Frame::Kind kind = type == EventMapStart ? Frame::Map : (type == EventSequenceStart ? Frame::Sequence : Frame::Flow);
+                    if (Top().kind == Frame::Root)
+                        Push(kind == Frame::Map ? kind : Frame::Sequence, 0, false);
+                    else
+                    {
+                        Open();
+                        Frame& frame = Push(kind, m_Depth, m_Pair);
+                        frame.name = m_Name;
+                        frame.children = m_Depth + 1;
+                        frame.pairs = kind == Frame::Map && m_PairMap;
+                    }
+                    return true;
+                }
+
+                void End()
+                {
+                    if (Top().merges.size())
+                        Merge();
+                    const Frame& frame = Top();
+                    if (frame.kind == Frame::Flow)
+                    {
+                        if (m_Words.empty())
+                            m_Buffer.append("/>\n", 3);
+                        else
+                        {
+                            m_Buffer.push_back('>');
+                            Escape(m_Flow.data(), m_Flow.size());
+                            m_Buffer.append("</", 2);
+                            m_Buffer.append(frame.name);
+                            m_Buffer.append(">\n", 2);
+                        }
+                        m_Flow.clear();
+                        m_Words.clear();
+                    }
+                    else if (frame.name.size())
+                    {
+                        if (frame.count == 0)
+                            m_Buffer.append("/>\n", 3);
+                        else
+                        {
+                            Indent(frame.depth);
+                            m_Buffer.append("</", 2);
+                            m_Buffer.append(frame.name);
+                            m_Buffer.append(">\n", 2);
+                        }
+                    }
+                    if (frame.pair)
+                    {
+                        Indent(frame.depth - 1);
+                        m_Buffer.append("</item>\n");
+                    }
+                    m_Level--;
+                    Flush();
+                }
+
+                std::ostream* m_pStream;
+                std::string m_Buffer;
+                std::vector<Frame> m_Frames;
+                size_t m_Level;                 ///< Number of open frames.
+                std::string m_Name;             ///< Element of the next value.
+                size_t m_Depth;
+                bool m_Pair;
+                bool m_PairMap;                 ///< Value of the next key is a map of <item> pairs.
+                std::unordered_set<std::string> m_Maps;
+                MergeState m_Merge;
+                std::string m_Flow;             ///< Words of the current flow sequence.
+                std::vector<size_t> m_Words;    ///< Ends of the words.
+                Anchors m_Anchors;
+                std::vector<Recorder> m_Recorders;
+                Events m_Tape;                  ///< Events of recorded values.
+                size_t m_Replay;
+                bool m_Anchored;
+            };
+
+            /// Passes events of top-level entries to the handler, the root map or sequence is started and ended by the caller.
+            class EntryHandler : public Handler
+            {
+            public:
+                EntryHandler(Handler& handler)
+                    : m_Handler(handler)
+                    , m_Level(0)
+                {
+                }
+
+                bool MapStart() override
+                {
+                    return m_Level++ == 0 || Started(m_Handler.MapStart());
+                }
+
+                void MapEnd() override
+                {
+                    if (--m_Level)
+                        m_Handler.MapEnd();
+                }
+
+                bool SequenceStart() override
+                {
+                    return m_Level++ == 0 || Started(m_Handler.SequenceStart());
+                }
+
+                void SequenceEnd() override
+                {
+                    if (--m_Level)
+                        m_Handler.SequenceEnd();
+                }
+
+                bool FlowMapStart() override
+                {
+                    return m_Level++ == 0 || Started(m_Handler.FlowMapStart());
+                }
+
+                bool FlowSequenceStart() override
+                {
+                    return m_Level++ == 0 || Started(m_Handler.FlowSequenceStart());
+                }
+
+                bool Key(const char* data, size_t size) override
+                {
+                    return m_Handler.Key(data, size);
+                }
+
+                void Scalar(const char* data, size_t size) override
+                {
+                    if (m_Level)
+                        m_Handler.Scalar(data, size);
+                }
+
+                void Null() override
+                {
+                    if (m_Level)
+                        m_Handler.Null();
+                }
+
+                void Anchor(const char* data, size_t size) override
+                {
+                    if (m_Level)
+                        m_Handler.Anchor(data, size);
+                }
+
+                void Alias(const char* data, size_t size) override
+                {
+                    if (m_Level)
+                        m_Handler.Alias(data, size);
+                }
+
+            private:
+                /// Skipped subtree has no end event.
+                bool Started(bool started)
+                {
+                    if (started == false)
+                        m_Level--;
+                    return started;
+                }
+
+                Handler& m_Handler;
+                size_t m_Level;
+            };
+
+            /// Reads YAML by chunks and passes blocks of top-level entries to the writer (see ToXml() for a stream).
+            inline Status ToXml(std::istream& yaml, XmlWriter& writer, const size_t chunk)
+            {
+                ParseImp parser;
+                EntryHandler entries(writer);
+                std::vector<char> buffer;
+                size_t size = 0;
+                Node::eType type = Node::None;
+                bool blocks = true;
+                while (yaml)
+                {
+                    // Large entries double the buffer, so they are rescanned a logarithmic number of times.
+                    const size_t read = std::max(chunk, size);
+                    if (buffer.size() < size + read)
+                        buffer.resize(size + read);
+                    yaml.read(buffer.data() + size, read);
+                    size += static_cast<size_t>(yaml.gcount());
+                    if (blocks == false || !yaml)
+                        continue;
+
+                    // Complete lines are split at the first entry after their half, the first block is written.
+                    size_t lines = size;
+                    while (lines && buffer[lines - 1] != '\n')
+                        lines--;
+                    Node::eType blockType = Node::None;
+                    const std::vector<size_t> bounds = ParseImp::SplitTopLevel(buffer.data(), lines, 2, blockType);
+                    if (bounds.size() < 3)
+                    {
+                        blocks = bounds.size() == 2 || lines == 0;
+                        continue;
+                    }
+                    if ((type != Node::None && blockType != type) || ParseImp::IsSplittable(buffer.data(), bounds[1], blockType) == false)
+                    {
+                        blocks = false;
+                        continue;
+                    }
+                    if (type == Node::None)
+                    {
+                        type = blockType;
+                        if (type == Node::MapType)
+                            writer.MapStart();
+                        else
+                            writer.SequenceStart();
+                    }
+                    if (parser.TryParse(entries, buffer.data(), bounds[1], true) == false)
+                        return parser.LastStatus();
+                    memmove(buffer.data(), buffer.data() + bounds[1], size - bounds[1]);
+                    size -= bounds[1];
+                }
+
+                size_t end = ParseImp::FindDocumentEnd(buffer.data(), size);
+                if (end == std::string::npos)
+                    end = size;
+                if (type == Node::None)
+                {
+                    parser.TryParse(writer, buffer.data(), end);
+                    return parser.LastStatus();
+                }
+                if (parser.TryParse(entries, buffer.data(), end, true) == false)
+                    return parser.LastStatus();
+                if (type == Node::MapType)
+                    writer.MapEnd();
+                else
+                    writer.SequenceEnd();
+                return Status();
+            }
+
+            /// Writes parsed XML document as YAML (see FromXml()), the layout of Serializer is used.
+            class XmlSerializer : public Serializer
+            {
+            public:
+                typedef Xml::XmlNode<char> XmlNode;
+
+                XmlSerializer(const SerializeConfig& config)
+                    : Serializer(config)
+                {
+                }
+
+                void Serialize(const XmlNode* pRoot)
+                {
+                    m_Buffer.clear();
+                    if (FirstElement(pRoot))
+                        Write(pRoot, false, 0);
+                }
+
+            private:
+                static const XmlNode* FirstElement(const XmlNode* pNode)
+                {
+                    const XmlNode* pChild = pNode->FirstNode();
+                    while (pChild && pChild->Type() != Xml::NodeElement)
+                        pChild = pChild->NextSibling();
+                    return pChild;
+                }
+
+                static const XmlNode* NextElement(const XmlNode* pNode)
+                {
+                    const XmlNode* pNext = pNode->NextSibling();
+                    while (pNext && pNext->Type() != Xml::NodeElement)
+                        pNext = pNext->NextSibling();
+                    return pNext;
+                }
+
+                static bool IsNamed(const XmlNode* pNode, const char* name, size_t size)
+                {
+                    return pNode->NameSize() == size && memcmp(pNode->Name(), name, size) == 0;
+                }
+
+                /// Item with <first> scalar and <second> value is an entry of map.
+                static bool IsPair(const XmlNode* pNode)
+                {
+                    if (IsNamed(pNode, "item", 4) == false)
+                        return false;
+                    const XmlNode* pFirst = FirstElement(pNode);
+                    if (pFirst == nullptr || IsNamed(pFirst, "first", 5) == false || FirstElement(pFirst))
+                        return false;
+                    const XmlNode* pSecond = NextElement(pFirst);
+                    return pSecond && IsNamed(pSecond, "second", 6) && NextElement(pSecond) == nullptr;
+                }
+
+                /// Element without child elements is scalar, element with only <item> children (not pairs) is sequence.
+                static Node::eType Type(const XmlNode* pNode)
+                {
+                    const XmlNode* pChild = FirstElement(pNode);
+                    if (pChild == nullptr)
+                        return Node::ScalarType;
+                    bool items = true, pairs = true;
+                    for (; pChild && items; pChild = NextElement(pChild))
+                    {
+                        items = IsNamed(pChild, "item", 4);
+                        pairs = pairs && IsPair(pChild);
+                    }
+                    return items && pairs == false ? Node::SequenceType : Node::MapType;
+                }
+
+                void Write(const XmlNode* pNode, bool useLevel, const size_t level)
+                {
+                    switch (Type(pNode))
+                    {
+                    case Node::SequenceType:
+                        for (const XmlNode* pItem = FirstElement(pNode); pItem; pItem = NextElement(pItem))
+                        {
+                            Indent(level);
+                            m_Buffer.append("- ", 2);
+                            const Node::eType type = Type(pItem);
+                            if (type == Node::SequenceType || (type == Node::MapType && m_Config.SequenceMapNewline))
+                            {
+                                m_Buffer.push_back('\n');
+                                Write(pItem, true, level + 2);
+                            }
+                            else
+                                Write(pItem, false, level + 2);
+                        }
+                        break;
+                    case Node::MapType:
+                        for (const XmlNode* pChild = FirstElement(pNode), *pFirst = pChild; pChild; pChild = NextElement(pChild))
+                        {
+                            if (useLevel || pChild != pFirst)
+                                Indent(level);
+                            const XmlNode* pValue = pChild;
+                            if (IsPair(pChild))
+                            {
+                                const XmlNode* pKey = FirstElement(pChild);
+                                WriteMapKey(pKey->Value(), pKey->ValueSize());
+                                pValue = NextElement(pKey);
+                            }
+                            else
+                                WriteMapKey(pChild->Name(), pChild->NameSize());
+                            if (Type(pValue) != Node::ScalarType || m_Config.MapScalarNewline)
+                            {
+                                m_Buffer.push_back('\n');
+                                Write(pValue, true, level + m_Config.SpaceIndentation);
+                            }
+                            else
+                                Write(pValue, false, level + m_Config.SpaceIndentation);
+                        }
+                        break;
+                    default:
+                        WriteScalar(pNode->Value(), pNode->ValueSize(), useLevel, level);
+                        break;
+                    }
+                }
+            };
+
+            /// Parses XML in place (data is zero terminated) and writes it as YAML.
+            inline Status FromXml(char* data, const size_t size, std::string& yaml, const SerializeConfig& config)
+            {
+                Status status;
+                if (config.SpaceIndentation < 2)
+                {
+                    status.Failed = true;
+                    status.Type = Exception::OperationError;
+                    status.Message = ErrorIndentation();
+                    return status;
+                }
+
+                // XML parser reports errors only by exceptions.
+                Xml::XmlDocument<char> document;
+                try
+                {
+                    document.Parse<0>(data, size);
+                }
+                catch (const Xml::ParseError& error)
+                {
+                    status.Failed = true;
+                    status.Message = std::string("Invalid XML: ") + error.what();
+                    return status;
+                }
+
+                XmlSerializer serializer(config);
+                serializer.Serialize(&document);
+                yaml.swap(serializer.Buffer());
+                return status;
+            }
+        }
+
+        inline void ToXml(const char* buffer, const size_t size, std::string& xml, const Strings& maps)
+        {
+            Detail::XmlWriter writer(nullptr, maps);
+            Parse(writer, buffer, size);
+            xml.swap(writer.Finish());
+        }
+
+        inline void ToXml(const char* buffer, const size_t size, std::ostream& xml, const Strings& maps)
+        {
+            Detail::XmlWriter writer(&xml, maps);
+            Parse(writer, buffer, size);
+            writer.Finish();
+        }
+
+        inline Status TryToXml(const char* buffer, const size_t size, std::string& xml, const Strings& maps)
+        {
+            Detail::XmlWriter writer(nullptr, maps);
+            const Status status = TryParse(writer, buffer, size);
+            if (status.Failed == false)
+            {
+                xml.swap(writer.Finish());
+            }
+            return status;
+        }
+
+        inline void ToXml(std::istream& yaml, std::ostream& xml, const Strings& maps, const size_t chunk)
+        {
+            const Status status = TryToXml(yaml, xml, maps, chunk);
+            if (status.Failed)
+            {
+                Detail::Throw(status);
+            }
+        }
+
+        inline Status TryToXml(std::istream& yaml, std::ostream& xml, const Strings& maps, const size_t chunk)
+        {
+            Detail::XmlWriter writer(&xml, maps);
+            const Status status = Detail::ToXml(yaml, writer, std::max<size_t>(chunk, 1));
+            if (status.Failed == false)
+            {
+                writer.Finish();
+            }
+            return status;
+        }
+
+        inline void FromXml(const char* buffer, const size_t size, std::string& yaml, const SerializeConfig& config)
+        {
+            const Status status = TryFromXml(buffer, size, yaml, config);
+            if (status.Failed)
+            {
+                Detail::Throw(status);
+            }
+        }
+
+        inline Status TryFromXml(const char* buffer, const size_t size, std::string& yaml, const SerializeConfig& config)
+        {
+            std::string data(buffer, size);
+            return Detail::FromXml(&data[0], data.size(), yaml, config);
+        }
+    }
+}
@@ -38,10 +38,12 @@ namespace Test
     {
         String name;
         TestPtr test;
+        bool benchmark;
 
-        Group(const String& n, const TestPtr& t)
+        Group(const String& n, const TestPtr& t, bool b = false)
             : name(n)
             , test(t)
+            , benchmark(b)
         {
         }
     };
@@ -53,6 +55,11 @@ namespace Test
     bool name##AddToList(){ g_groups.push_back(Group(#name, name##Test)); return true; } \
     bool name##AtList = name##AddToList();
 
+#define TEST_ADD_BENCHMARK(name) \
+    bool name##Test(); \
+    bool name##AddToList(){ g_groups.push_back(Group(#name, name##Test, true)); return true; } \
+    bool name##AtList = name##AddToList();
+
     TEST_ADD(LogCallback);
     TEST_ADD(LogCallbackRaw);
 
@@ -71,6 +78,7 @@ namespace Test
     TEST_ADD(ParamMapBug);
     TEST_ADD(ParamLimited);
     TEST_ADD(ParamTemplate);
+    TEST_ADD(ParamYamlOrder);
 
     TEST_ADD(ParamVectorV2);
     TEST_ADD(ParamMapV2);
@@ -79,6 +87,7 @@ namespace Test
 
     TEST_ADD(PerformanceSimple);
     TEST_ADD(PerformanceStdThread);
+    TEST_ADD(PerformanceClear);
 #if defined(CPL_TEST_NORETURN)
     TEST_ADD(PerformanceNoReturn);
 #endif
@@ -90,8 +99,35 @@ namespace Test
 
     TEST_ADD(YamlSimple);
     TEST_ADD(YamlParam);
+    TEST_ADD(YamlBuffer);
+    TEST_ADD(YamlContainer);
+    TEST_ADD(YamlDocument);
+    TEST_ADD(YamlStream);
+    TEST_ADD(YamlEvent);
+    TEST_ADD(YamlSerialize);
+    TEST_ADD(YamlFind);
+    TEST_ADD(YamlFlow);
+    TEST_ADD(YamlAnchor);
+    TEST_ADD(YamlCopy);
+    TEST_ADD(YamlView);
+    TEST_ADD(YamlParallel);
+    TEST_ADD(YamlPath);
+    TEST_ADD(YamlXml);
+    TEST_ADD(YamlQuote);
+    TEST_ADD(YamlStatus);
+    TEST_ADD(YamlFile);
+    TEST_ADD(YamlIncremental);
+    TEST_ADD(YamlSchema);
+    TEST_ADD_BENCHMARK(YamlBenchmark);
 
     TEST_ADD(XmlAllocateString);
+    TEST_ADD(XmlCloneNode);
+    TEST_ADD(XmlValueAs);
+    TEST_ADD(XmlUtf16);
+    TEST_ADD_BENCHMARK(XmlUtf16Benchmark);
+    TEST_ADD(XmlLimits);
+    TEST_ADD(XmlDeep);
+    TEST_ADD_BENCHMARK(XmlDeepBenchmark);
     TEST_ADD(DoFileModify);
     TEST_ADD(DoFileExistance);
     TEST_ADD(DoFileInfo);
@@ -102,6 +138,7 @@ namespace Test
         Log::Level logLevel;
         String logFile;
         Strings include, exclude;
+        String benchmarkDir;
 
         Options(int argc, char* argv[])
             : Cpl::ArgsParser(argc, argv, true)
@@ -111,13 +148,15 @@ namespace Test
             logFile = GetArg2("-lf", "--logFile", "", false);
             include = GetArgs("-i", Strings(), false);
             exclude = GetArgs("-e", Strings(), false);
+            benchmarkDir = GetArg2("-bd", "--benchmarkDir", "", false);
         }
 
+        /// Benchmarks are run only if an include filter names them fully.
         bool Required(const Group& group)
         {
-            bool required = include.empty();
+            bool required = include.empty() && !group.benchmark;
             for (size_t i = 0; i < include.size() && !required; ++i)
-                if (group.name.find(include[i]) != std::string::npos)
+                if (group.benchmark ? group.name == include[i] : group.name.find(include[i]) != std::string::npos)
                     required = true;
             for (size_t i = 0; i < exclude.size() && required; ++i)
                 if (group.name.find(exclude[i]) != std::string::npos)
@@ -132,6 +171,8 @@ namespace Test
         std::cout << "Test application parameters:" << std::endl << std::endl;
         std::cout << " -i=test      - include test filter." << std::endl << std::endl;
         std::cout << " -e=test      - exclude test filter." << std::endl << std::endl;
+        std::cout << " -bd=bench    - a directory of benchmark results and baselines." << std::endl;
+        std::cout << "                Benchmarks are run only if -i names them fully." << std::endl << std::endl;
         std::cout << " -ll=1        - a log level." << std::endl << std::endl;
         std::cout << " -lf=test.log - a log file name." << std::endl << std::endl;
         std::cout << " -h or -?     - to print this help message." << std::endl << std::endl;
@@ -158,6 +199,13 @@ namespace Test
         CPL_LOG_SS(Info, "ALL TESTS ARE FINISHED SUCCESSFULLY!" << std::endl);
         return 0;
     }
+
+    String g_benchmarkDir;
+
+    const String& BenchmarkDir()
+    {
+        return g_benchmarkDir;
+    }
 }
 
 int main(int argc, char* argv[])
@@ -172,6 +220,8 @@ int main(int argc, char* argv[])
         Cpl::Log::Global().AddFileWriter(options.logLevel, options.logFile);
     Cpl::Log::Global().SetFlags(Cpl::Log::BashFlags);
 
+    Test::g_benchmarkDir = options.benchmarkDir;
+
     Test::Groups groups;
     for (const Test::Group& group : Test::g_groups)
         if (options.Required(group))
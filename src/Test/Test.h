@@ -36,4 +36,7 @@ namespace Test
     typedef Cpl::Int Int;
     typedef Cpl::String String;
     typedef Cpl::Strings Strings;
+
+    /// Directory of results and baselines of benchmarks (-bd option), results are not saved if it is empty.
+    const String& BenchmarkDir();
 }
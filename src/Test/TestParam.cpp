@@ -405,6 +405,51 @@ namespace Test
 
         return true;
     }
+
+    //---------------------------------------------------------------------------------------------
+
+    bool ParamYamlOrderTest()
+    {
+        struct ChildParam
+        {
+            CPL_PARAM_VALUE(Int, zeta, 1);
+            CPL_PARAM_VALUE(Int, alpha, 2);
+        };
+
+        struct TestParam
+        {
+            CPL_PARAM_VALUE(String, name, "Name");
+            CPL_PARAM_STRUCT(ChildParam, child);
+            CPL_PARAM_VALUE(Int, count, 3);
+            CPL_PARAM_VALUE(Int, beta, 4);
+        };
+
+        CPL_PARAM_HOLDER(TestParamHolder, TestParam, test);
+
+        // Keys of YAML maps keep insertion order, so parameters are saved in order of their declaration.
+        const String expected =
+            "test: \n"
+            "  name: Name\n"
+            "  child: \n"
+            "    zeta: 1\n"
+            "    alpha: 2\n"
+            "  count: 3\n"
+            "  beta: 4\n";
+
+        TestParamHolder test, loaded;
+        std::stringstream yaml;
+        test.Save(yaml, true, Cpl::ParamFormatYaml);
+        if (yaml.str() != expected)
+        {
+            CPL_LOG_SS(Error, "Order of YAML parameters is changed:" << std::endl << yaml.str());
+            return false;
+        }
+
+        if (!loaded.Load(yaml, Cpl::ParamFormatYaml))
+            return false;
+
+        return loaded.Equal(test);
+    }
 }
 
 
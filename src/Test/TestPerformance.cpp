@@ -116,6 +116,29 @@ namespace Test
         return true;
     }
 
+    bool PerformanceClearTest()
+    {
+#if defined(CPL_PERF_ENABLE)
+        // Each thread keeps a pointer to its map of measurers, so Clear() empties the maps instead of erasing them.
+        Cpl::PerformanceStorage& storage = Cpl::PerformanceStorage::Global();
+        for (size_t i = 1; i <= 3; ++i)
+        {
+            storage.Clear();
+            if (!storage.Merged().empty())
+                return false;
+            for (size_t j = 0; j < i; ++j)
+            {
+                Cpl::PerformanceHolder holder(storage.Get("PerformanceClearTest"));
+            }
+            Cpl::PerformanceStorage::FunctionMap merged = storage.Merged();
+            if (merged.size() != 1 || merged["PerformanceClearTest"]->Count() != i)
+                return false;
+        }
+        storage.Clear();
+#endif
+        return true;
+    }
+
 #if defined(CPL_TEST_NORETURN)
     static void* TestFuncV5(void*)
     {
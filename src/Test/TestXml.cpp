@@ -23,9 +23,13 @@
 * SOFTWARE.
 */
 
+#include "Test/Test.h"
+
 #include "Cpl/Xml.h"
+#include <chrono>
 #include <iostream>
 #include <string>
+#include <sstream>
 
 namespace Test
 {
@@ -147,4 +151,377 @@ namespace Test
 
         return true;
     }
+
+    static std::string XmlToString(const Cpl::Xml::XmlNode<char>* node)
+    {
+        std::stringstream ss;
+        std::ostream& os = ss;
+        Cpl::Xml::Print(os, *node, Cpl::Xml::PrintNoIndenting);
+        return ss.str();
+    }
+
+    bool XmlCloneNodeTest()
+    {
+        std::string text = "<root a=\"1\" b=\"two\"><item>first</item><item c=\"3\">second</item><empty/></root>";
+        Cpl::Xml::XmlDocument<char> src;
+        src.Parse<0>((char*)text.c_str(), text.size());
+        std::string original = XmlToString(src.FirstNode());
+
+        Cpl::Xml::XmlDocument<char> dst;
+        Cpl::Xml::XmlNode<char>* clone = dst.CloneNode(src.FirstNode());
+        Cpl::Xml::XmlNode<char>* copy = dst.CopyNode(src.FirstNode());
+        if (XmlToString(clone) != original || XmlToString(copy) != original)
+            return false;
+        if (clone->FirstNode()->Value() != src.FirstNode()->FirstNode()->Value())
+            return false;
+        if (copy->FirstNode()->Value() == src.FirstNode()->FirstNode()->Value())
+            return false;
+
+        src.Clear();
+        text.assign(text.size(), ' ');
+        if (XmlToString(copy) != original)
+            return false;
+
+        Cpl::Xml::XmlNode<char>* list = dst.CreateNode(Cpl::Xml::NodeElement, "list");
+        Cpl::Xml::XmlNode<char>* items = dst.AllocateNodes(Cpl::Xml::NodeElement, 3);
+        for (int i = 0; i < 3; ++i)
+            items[i].Name("i", 1);
+        list->AppendNode(dst.CreateNode(Cpl::Xml::NodeElement, "head", "0"));
+        list->AppendNodes(items, 3);
+        if (XmlToString(list) != "<list><head>0</head><i/><i/><i/></list>")
+            return false;
+
+        return true;
+    }
+
+    bool XmlValueAsTest()
+    {
+        std::string text = "<root i=\" -42\" u=\"4000000000\" f=\"2.5e-3\" b=\"Yes\" big=\"99999999999\">"
+            "<list>1 2\t3\n 4 -5</list><bad>x1</bad><name>abc</name></root>";
+        Cpl::Xml::XmlDocument<char> doc;
+        doc.Parse<0>((char*)text.c_str(), text.size());
+        const Cpl::Xml::XmlNode<char>* root = doc.FirstNode("root");
+
+        if (root->FirstAttribute("i")->As<int>() != -42)
+            return false;
+        if (root->FirstAttribute("u")->As<uint32_t>() != 4000000000u)
+            return false;
+        uint32_t unsignedValue = 7;
+        if (root->FirstAttribute("i")->Get(unsignedValue) || unsignedValue != 7)
+            return false;
+        if (root->FirstAttribute("f")->As<double>() != 2.5e-3)
+            return false;
+        if (root->FirstAttribute("b")->As<bool>() != true)
+            return false;
+        int big = 7;
+        if (root->FirstAttribute("big")->Get(big) || big != 7)
+            return false;
+        if (root->FirstNode("bad")->As<int>(13) != 13)
+            return false;
+        if (root->FirstNode("name")->As<std::string>() != "abc")
+            return false;
+
+        int values[8];
+        if (root->FirstNode("list")->Get(values, 8) != 5 || values[2] != 3 || values[4] != -5)
+            return false;
+        if (root->FirstNode("list")->Get(values, 3) != 3)
+            return false;
+        std::vector<float> vector;
+        if (!root->FirstNode("list")->Get(vector) || vector.size() != 5 || vector[3] != 4.0f)
+            return false;
+        std::vector<uint32_t> unsignedVector(1, 7);
+        if (root->FirstNode("list")->Get(unsignedVector) || unsignedVector.size() != 1 || unsignedVector[0] != 7)
+            return false;
+
+        return true;
+    }
+
+    static void XmlUtf16Append(std::string& utf8, std::u16string& utf16, std::wstring& wide, const char* ascii)
+    {
+        for (; *ascii; ++ascii)
+        {
+            utf8.push_back(*ascii);
+            utf16.push_back(char16_t(*ascii));
+            wide.push_back(wchar_t(*ascii));
+        }
+    }
+
+    static void XmlUtf16Sample(size_t count, bool ascii, std::string& utf8, std::u16string& utf16, std::wstring& wide)
+    {
+        XmlUtf16Append(utf8, utf16, wide, "<?xml version=\"1.0\"?>\n<root>\n");
+        for (size_t i = 0; i < count; ++i)
+        {
+            XmlUtf16Append(utf8, utf16, wide, "  <item id=\"");
+            XmlUtf16Append(utf8, utf16, wide, std::to_string(i).c_str());
+            XmlUtf16Append(utf8, utf16, wide, "\" name=\"caf");
+            if (!ascii)
+                utf8 += "\xC3\xA9", utf16 += char16_t(0x00E9), wide += wchar_t(0x00E9);
+            XmlUtf16Append(utf8, utf16, wide, "\">value &amp; text ");
+            if (!ascii)
+                utf8 += "\xE2\x82\xAC\xF0\x9F\x98\x80", utf16 += u"\u20AC\U0001F600", wide += L"\u20AC\U0001F600";
+            XmlUtf16Append(utf8, utf16, wide, "</item>\n");
+        }
+        XmlUtf16Append(utf8, utf16, wide, "</root>\n");
+    }
+
+    static std::string XmlUtf16Print(const Cpl::Xml::XmlDocument<char>& doc)
+    {
+        std::stringstream ss;
+        std::ostream& os = ss;
+        Cpl::Xml::Print(os, doc);
+        return ss.str();
+    }
+
+    bool XmlUtf16Test()
+    {
+        std::string utf8;
+        std::u16string utf16;
+        std::wstring wide;
+        XmlUtf16Sample(3, false, utf8, utf16, wide);
+
+        Cpl::Xml::XmlDocument<char> doc8;
+        std::string buffer = utf8;
+        doc8.Parse<0>((char*)buffer.c_str(), buffer.size());
+        std::string expected = XmlUtf16Print(doc8);
+
+        Cpl::Xml::XmlDocument<char> doc16;
+        doc16.ParseUtf16<0>(utf16.c_str(), utf16.size());
+        if (XmlUtf16Print(doc16) != expected)
+            return false;
+
+        std::u16string swapped(1, char16_t(0xFFFE));
+        for (size_t i = 0; i < utf16.size(); ++i)
+            swapped.push_back(char16_t((utf16[i] >> 8) | (utf16[i] << 8)));
+        doc16.ParseUtf16<0>(swapped.c_str(), swapped.size());
+        if (XmlUtf16Print(doc16) != expected)
+            return false;
+
+        doc16.ParseWide<0>(wide.c_str(), wide.size());
+        if (XmlUtf16Print(doc16) != expected)
+            return false;
+
+        return true;
+    }
+
+    /// It is run only by -i=XmlUtf16Benchmark.
+    bool XmlUtf16BenchmarkTest()
+    {
+        std::string utf8, buffer;
+        std::u16string utf16;
+        std::wstring wide;
+
+        // XmlDocument<char16_t> classifies characters by their low byte, so the benchmark sample is ASCII only.
+        // The best time of several runs is compared, converted input takes an extra pass, so it isn't expected to be faster.
+        XmlUtf16Sample(10000, true, utf8, utf16, wide);
+        std::u16string native;
+        typedef std::chrono::steady_clock Clock;
+        double best[4] = { 1e9, 1e9, 1e9, 1e9 };
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        for (int i = 0; i < 20; ++i)
+        {
+            Clock::time_point start = Clock::now();
+            {
+                CPL_PERF_BEGF("utf-8 input", utf8.size());
+                Cpl::Xml::XmlDocument<char> doc;
+                buffer = utf8;
+                doc.Parse<0>((char*)buffer.c_str(), buffer.size());
+            }
+            Clock::time_point utf8End = Clock::now();
+            {
+                CPL_PERF_BEGF("utf-16 input, converted to utf-8", utf16.size() * sizeof(char16_t));
+                Cpl::Xml::XmlDocument<char> doc;
+                doc.ParseUtf16<0>(utf16.c_str(), utf16.size());
+            }
+            Clock::time_point utf16End = Clock::now();
+            {
+                CPL_PERF_BEGF("wchar_t input, converted to utf-8", wide.size() * sizeof(wchar_t));
+                Cpl::Xml::XmlDocument<char> doc;
+                doc.ParseWide<0>(wide.c_str(), wide.size());
+            }
+            Clock::time_point wideEnd = Clock::now();
+            {
+                CPL_PERF_BEGF("utf-16 input, XmlDocument<char16_t>", utf16.size() * sizeof(char16_t));
+                Cpl::Xml::XmlDocument<char16_t> doc;
+                native = utf16;
+                doc.Parse<0>((char16_t*)native.c_str(), native.size());
+            }
+            Clock::time_point nativeEnd = Clock::now();
+            best[0] = std::min(best[0], std::chrono::duration<double, std::milli>(utf8End - start).count());
+            best[1] = std::min(best[1], std::chrono::duration<double, std::milli>(utf16End - utf8End).count());
+            best[2] = std::min(best[2], std::chrono::duration<double, std::milli>(wideEnd - utf16End).count());
+            best[3] = std::min(best[3], std::chrono::duration<double, std::milli>(nativeEnd - wideEnd).count());
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        CPL_LOG_SS(Info, "Best parsing time of " << utf16.size() << " characters: utf-8 " << Cpl::ToStr(best[0], 3) << " ms, utf-16 converted "
+            << Cpl::ToStr(best[1], 3) << " ms, wchar_t converted " << Cpl::ToStr(best[2], 3) << " ms, XmlDocument<char16_t> " << Cpl::ToStr(best[3], 3) << " ms.");
+        return true;
+    }
+
+    static bool XmlLimitsParse(const Cpl::Xml::Limits& limits, const std::string& text, const std::string& error)
+    {
+        Cpl::Xml::XmlDocument<char> doc;
+        doc.SetLimits(limits);
+        std::string buffer = text;
+        try
+        {
+            doc.Parse<0>((char*)buffer.c_str(), buffer.size());
+        }
+        catch (const Cpl::Xml::ParseError& e)
+        {
+            return error == e.what();
+        }
+        return error.empty();
+    }
+
+    bool XmlLimitsTest()
+    {
+        std::string deep;
+        for (int i = 0; i < 100; ++i)
+            deep += "<a x=\"1\">";
+        for (int i = 0; i < 100; ++i)
+            deep += "</a>";
+
+        Cpl::Xml::XmlDocument<char> doc;
+        std::string buffer = deep;
+        doc.Parse<0>((char*)buffer.c_str(), buffer.size());
+        const Cpl::Xml::Statistics& stat = doc.GetStatistics();
+        if (stat.nodes != 100 || stat.attributes != 100 || stat.depth != 100 || stat.bytes == 0 || stat.blocks != 0)
+            return false;
+
+        if (!XmlLimitsParse(Cpl::Xml::Limits(0, 0, 100), deep, ""))
+            return false;
+        if (!XmlLimitsParse(Cpl::Xml::Limits(0, 0, 99), deep, "nesting depth limit exceeded"))
+            return false;
+        if (!XmlLimitsParse(Cpl::Xml::Limits(0, 50, 0), deep, "node count limit exceeded"))
+            return false;
+        if (!XmlLimitsParse(Cpl::Xml::Limits(stat.bytes - 1, 0, 0), deep, "memory limit exceeded"))
+            return false;
+
+        doc.SetLimits(Cpl::Xml::Limits(0, 0, 99));
+        buffer = deep;
+        try
+        {
+            doc.Parse<0>((char*)buffer.c_str(), buffer.size());
+            return false;
+        }
+        catch (const Cpl::Xml::ParseError& e)
+        {
+            if (std::string(e.what()) != "nesting depth limit exceeded")
+                return false;
+        }
+        doc.SetLimits(Cpl::Xml::Limits());
+
+        // Limits are checked only during parsing, bytes of a failed allocation are not counted.
+        Cpl::Xml::XmlDocument<char> built;
+        built.SetLimits(Cpl::Xml::Limits(1, 1, 1));
+        for (int i = 0; i < 10; ++i)
+            built.AppendNode(built.CreateNode(Cpl::Xml::NodeElement, "a", "1"));
+        if (built.GetStatistics().nodes != 10)
+            return false;
+        const size_t bytes = built.GetStatistics().bytes;
+        built.SetLimits(Cpl::Xml::Limits(bytes + 1, 0, 0));
+        buffer = deep;
+        try
+        {
+            built.Parse<0>((char*)buffer.c_str(), buffer.size());
+            return false;
+        }
+        catch (const Cpl::Xml::ParseError&)
+        {
+            if (built.GetStatistics().bytes > bytes + 1)
+                return false;
+        }
+
+        doc.Clear();
+        if (doc.GetStatistics().nodes != 0 || doc.GetStatistics().bytes != 0)
+            return false;
+
+        return true;
+    }
+
+    static std::string XmlDeepSample(size_t depth)
+    {
+        std::string text;
+        for (size_t i = 0; i < depth; ++i)
+            text += "<a>";
+        text += "v";
+        for (size_t i = 0; i < depth; ++i)
+            text += "</a>";
+        return text;
+    }
+
+    static std::string XmlCatalogSample(size_t count)
+    {
+        std::string text = "<?xml version=\"1.0\"?>\n<catalog>\n";
+        for (size_t i = 0; i < count; ++i)
+        {
+            text += "  <book id=\"" + std::to_string(i) + "\">\n";
+            text += "    <title>Title " + std::to_string(i) + "</title>\n";
+            text += "    <authors><author>First</author><author>Second</author></authors>\n";
+            text += "    <price currency=\"USD\">" + std::to_string(i % 100) + ".99</price>\n";
+            text += "  </book>\n";
+        }
+        text += "</catalog>\n";
+        return text;
+    }
+
+    bool XmlDeepTest()
+    {
+        const size_t depth = 200000;
+        const std::string text = XmlDeepSample(depth);
+
+        Cpl::Xml::XmlDocument<char> doc;
+        std::string buffer = text;
+        doc.Parse<Cpl::Xml::ParseValidateClosingTags>((char*)buffer.c_str(), buffer.size());
+        if (doc.GetStatistics().depth != depth)
+            return false;
+        if (XmlToString(&doc) != text)
+            return false;
+
+        Cpl::Xml::XmlDocument<char> clones;
+        if (XmlToString(clones.CloneNode(doc.FirstNode())) != text || XmlToString(clones.CopyNode(doc.FirstNode())) != text)
+            return false;
+
+        Cpl::Xml::XmlDocument<char> normal;
+        buffer = XmlCatalogSample(3);
+        normal.Parse<0>((char*)buffer.c_str(), buffer.size());
+        if (normal.GetStatistics().depth != 4)
+            return false;
+
+        return true;
+    }
+
+    /// It is run only by -i=XmlDeepBenchmark.
+    bool XmlDeepBenchmarkTest()
+    {
+        // Parsing without recursion must not slow down usual documents with a few levels of nesting.
+        const std::string text = XmlDeepSample(200000), normal = XmlCatalogSample(10000);
+        std::string buffer;
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        for (int i = 0; i < 10; ++i)
+        {
+            {
+                CPL_PERF_BEGF("parse normal document", normal.size());
+                Cpl::Xml::XmlDocument<char> doc;
+                buffer = normal;
+                doc.Parse<0>((char*)buffer.c_str(), buffer.size());
+            }
+            {
+                CPL_PERF_BEGF("parse deep document", text.size());
+                Cpl::Xml::XmlDocument<char> doc;
+                buffer = text;
+                doc.Parse<Cpl::Xml::ParseValidateClosingTags>((char*)buffer.c_str(), buffer.size());
+            }
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        return true;
+    }
 }
\ No newline at end of file
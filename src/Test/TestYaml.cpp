@@ -25,8 +25,11 @@
 #include "Test/Test.h"
 
 #include "Cpl/Yaml.h"
+#include "Cpl/YamlXml.h"
 #include "Cpl/Param.h"
 
+#include <functional>
+
 namespace Test
 {
     bool YamlSimpleTest()
@@ -124,4 +127,1831 @@ namespace Test
 
         return true;
     }
+
+    //---------------------------------------------------------------------------------------------
+
+    static std::string YamlBufferSample(size_t count)
+    {
+        std::stringstream ss;
+        ss << "# generated sample\n";
+        ss << "items:\n";
+        for (size_t i = 0; i < count; ++i)
+        {
+            ss << "  - name: \"item #" << i << "\" # quoted name\n";
+            ss << "    id: " << i << "\n";
+            ss << "    tags:\n";
+            ss << "      - first\n";
+            ss << "      - second   \n";
+            ss << "\n";
+            ss << "    note: plain text with spaces\r\n";
+        }
+        return ss.str();
+    }
+
+    bool YamlBufferTest()
+    {
+        const std::string sample = YamlBufferSample(3);
+        Cpl::Yaml::Node fromBuffer, fromStream;
+        std::stringstream stream(sample);
+        Cpl::Yaml::Parse(fromBuffer, sample.c_str(), sample.size());
+        Cpl::Yaml::Parse(fromStream, stream);
+        std::string expected, serialized;
+        Cpl::Yaml::Serialize(fromBuffer, expected);
+        Cpl::Yaml::Serialize(fromStream, serialized);
+        if (serialized != expected)
+            return false;
+        if (fromBuffer["items"].Size() != 3 || fromBuffer["items"][2]["name"].As<std::string>() != "item #2" ||
+            fromBuffer["items"][1]["tags"][1].As<std::string>() != "second" || fromBuffer["items"][0]["note"].As<std::string>() != "plain text with spaces")
+        {
+            CPL_LOG_SS(Error, "Wrong parsed values: " << std::endl << expected);
+            return false;
+        }
+
+        const std::string twoDocs = "---\na: 1\n---\nb: 2\n";
+        stream.clear();
+        stream.str(twoDocs);
+        Cpl::Yaml::Parse(fromStream, stream);
+        Cpl::Yaml::Parse(fromBuffer, stream);
+        if (fromStream["a"].As<int>() != 1 || fromBuffer["b"].As<int>() != 2)
+            return false;
+
+        const std::string large = YamlBufferSample(10000);
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        for (int i = 0; i < 5; ++i)
+        {
+            {
+                CPL_PERF_BEGF("yaml buffer", large.size());
+                Cpl::Yaml::Node root;
+                Cpl::Yaml::Parse(root, large.c_str(), large.size());
+            }
+            {
+                CPL_PERF_BEGF("yaml stream", large.size());
+                Cpl::Yaml::Node root;
+                std::stringstream is(large);
+                Cpl::Yaml::Parse(root, is);
+            }
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        return true;
+    }
+
+    //---------------------------------------------------------------------------------------------
+
+    bool YamlContainerTest()
+    {
+        Cpl::Yaml::Node root;
+        Cpl::Yaml::Node& first = root["z"];
+        first = "first";
+        const size_t count = 1000;
+        for (size_t i = 0; i < count; ++i)
+            root["key" + std::to_string(i)] = std::to_string(i);
+        if (root.Size() != count + 1 || first.As<std::string>() != "first")
+            return false;
+        for (size_t i = 0; i < count; i += 7)
+        {
+            if (root["key" + std::to_string(i)].As<size_t>() != i)
+                return false;
+        }
+        root.Erase("key5");
+        if (root.Size() != count || root["key6"].As<int>() != 6 || root["key999"].As<int>() != 999)
+            return false;
+        size_t index = 0;
+        for (auto it = root.Begin(); it != root.End(); it++, index++)
+        {
+            const std::string expected = index == 0 ? "z" : "key" + std::to_string(index < 6 ? index - 1 : index);
+            if ((*it).first != expected)
+            {
+                CPL_LOG_SS(Error, "Wrong map order: " << (*it).first << " instead of " << expected);
+                return false;
+            }
+        }
+
+        Cpl::Yaml::Node seq;
+        seq.PushBack() = "b";
+        seq.PushBack() = "d";
+        seq.PushFront() = "a";
+        seq.Insert(2) = "c";
+        seq.Erase(3);
+        std::string joined;
+        for (auto it = seq.Begin(); it != seq.End(); it++)
+            joined += (*it).second.As<std::string>();
+        if (joined != "abc" || seq[1].As<std::string>() != "b" || !seq[5].IsNone())
+            return false;
+
+        std::string text;
+        Cpl::Yaml::Serialize(root, text);
+        Cpl::Yaml::Node loaded;
+        Cpl::Yaml::Parse(loaded, text);
+        std::string again;
+        Cpl::Yaml::Serialize(loaded, again);
+        return again == text;
+    }
+
+    //---------------------------------------------------------------------------------------------
+
+    bool YamlDocumentTest()
+    {
+        const std::string sample = YamlBufferSample(100);
+        Cpl::Yaml::Document doc;
+        doc.Parse(sample);
+        Cpl::Yaml::Node copy = doc.Root()["items"][42];
+        const size_t reserved = doc.Reserved();
+        for (int i = 0; i < 10; ++i)
+            doc.Parse(sample);
+        if (doc.Reserved() > reserved * 2)
+        {
+            CPL_LOG_SS(Error, "Document memory grows on reparsing: " << reserved << " -> " << doc.Reserved());
+            return false;
+        }
+        doc.Clear();
+        if (!doc.Root().IsNone() || copy["name"].As<std::string>() != "item #42" || copy["tags"][1].As<std::string>() != "second")
+            return false;
+
+        Cpl::Yaml::Node& root = doc.Root();
+        root["a"]["b"] = "c";
+        root = root["a"];
+        if (root["b"].As<std::string>() != "c" || root.Size() != 1)
+            return false;
+
+        // A long-lived node which is edited in place reuses memory of overwritten and erased subtrees.
+        Cpl::Yaml::Document editedDocument;
+        Cpl::Yaml::Node& edited = editedDocument.Root(), sub;
+        sub["x"] = "1";
+        sub["y"]["z"] = "a value which is longer than a short string";
+        sub["w"].PushBack() = "q";
+        auto edit = [&](int i)
+        {
+            edited["m"] = sub;
+            edited["s"].PushBack() = std::to_string(i);
+            edited["s"].Erase(0);
+            edited["k"]["a key which is longer than a short string"] = std::to_string(i);
+            edited["k"] = "scalar";
+            edited.Erase("k");
+        };
+        for (int i = 0; i < 1000; ++i)
+            edit(i);
+        {
+            const size_t reserved = editedDocument.Reserved();
+            for (int i = 0; i < 100000; ++i)
+                edit(i);
+            const size_t grown = editedDocument.Reserved() - reserved;
+            if (grown > 64 * 1024 || edited["m"]["y"]["z"].As<std::string>() != sub["y"]["z"].As<std::string>() || edited["s"].Size() != 0)
+            {
+                CPL_LOG_SS(Error, "Memory of edited YAML node grows: " << grown << " bytes!");
+                return false;
+            }
+        }
+
+        // Keys of map iterators are stored with elements: they stay valid after increment and are not copied per step.
+        Cpl::Yaml::Node keyed;
+        for (int i = 0; i < 8; ++i)
+            keyed["a key which is longer than a short string #" + std::to_string(i)] = i;
+        Cpl::Yaml::Iterator first = keyed.Begin();
+        const std::string& firstKey = (*first).first;
+        first++;
+        if (firstKey != "a key which is longer than a short string #0" || &(*keyed.Begin()).first != &firstKey)
+        {
+            CPL_LOG_SS(Error, "Key of YAML map iterator is not stable: '" << firstKey << "'!");
+            return false;
+        }
+        const Cpl::Yaml::Node& constKeyed = keyed;
+        std::vector<const std::string*> keys;
+        for (Cpl::Yaml::ConstIterator it = constKeyed.Begin(); it != constKeyed.End(); it++)
+            keys.push_back(&(*it).first);
+        {
+            size_t index = 0, keysSize = 0;
+            for (Cpl::Yaml::ConstIterator it = constKeyed.Begin(); it != constKeyed.End(); it++, index++)
+            {
+                if (index >= keys.size() || keys[index] != &(*it).first)
+                {
+                    CPL_LOG_SS(Error, "Iteration of YAML map copies key " << index << "!");
+                    return false;
+                }
+                keysSize += (*it).first.size();
+            }
+            if (keysSize != 8 * firstKey.size())
+            {
+                CPL_LOG_SS(Error, "Iteration of YAML map returns wrong keys!");
+                return false;
+            }
+        }
+
+        const std::string large = YamlBufferSample(10000);
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        for (int i = 0; i < 5; ++i)
+        {
+            {
+                CPL_PERF_BEGF("yaml node parse and release", large.size());
+                Cpl::Yaml::Node node;
+                Cpl::Yaml::Parse(node, large);
+            }
+            {
+                CPL_PERF_BEGF("yaml document parse and release", large.size());
+                doc.Parse(large);
+                doc.Clear();
+            }
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        return true;
+    }
+
+    //---------------------------------------------------------------------------------------------
+
+    static std::string YamlStreamSample(size_t count)
+    {
+        std::stringstream ss;
+        for (size_t i = 0; i < count; ++i)
+        {
+            ss << "---\n# record " << i << "\n";
+            ss << "id: " << i << "\n";
+            ss << "name: \"record #" << i << "\"\n";
+            ss << "values:\n";
+            for (size_t j = 0; j < i % 7; ++j)
+                ss << "  - " << j << "\n";
+            if (i % 3 == 0)
+                ss << "...\n";
+        }
+        return ss.str();
+    }
+
+    static bool CheckYamlStream(Cpl::Yaml::DocumentReader& reader, size_t count)
+    {
+        Cpl::Yaml::Document doc;
+        size_t reserved = 0;
+        while (reader.Next(doc))
+        {
+            const size_t i = reader.Count() - 1;
+            Cpl::Yaml::Node& root = doc.Root();
+            if (root["id"].As<size_t>() != i || root["name"].As<std::string>() != "record #" + std::to_string(i) || root["values"].Size() != i % 7)
+            {
+                CPL_LOG_SS(Error, "Wrong YAML stream document " << i << " !");
+                return false;
+            }
+            if (i == 100)
+                reserved = doc.Reserved();
+            else if (i > 100 && doc.Reserved() > reserved)
+            {
+                CPL_LOG_SS(Error, "YAML stream document memory grows: " << reserved << " -> " << doc.Reserved());
+                return false;
+            }
+        }
+        if (reader.Count() != count)
+        {
+            CPL_LOG_SS(Error, "YAML stream has " << reader.Count() << " documents instead of " << count << " !");
+            return false;
+        }
+        return true;
+    }
+
+    bool YamlStreamTest()
+    {
+        const size_t count = 10000;
+        const std::string sample = YamlStreamSample(count);
+
+        Cpl::Yaml::DocumentReader buffer(sample.data(), sample.size());
+        if (!CheckYamlStream(buffer, count))
+            return false;
+
+        std::stringstream stream(sample);
+        Cpl::Yaml::DocumentReader chunked(stream, 4096);
+        if (!CheckYamlStream(chunked, count))
+            return false;
+
+        std::stringstream broken("---\na: 1\n---\n\tb: 2\n---\nc: 3\n");
+        Cpl::Yaml::DocumentReader tolerant(broken, 4);
+        Cpl::Yaml::Document doc;
+        size_t errors = 0, read = 0;
+        for (bool next = true; next;)
+        {
+            try
+            {
+                next = tolerant.Next(doc);
+                read += next ? 1 : 0;
+            }
+            catch (const Cpl::Yaml::Exception&)
+            {
+                errors++;
+            }
+        }
+        if (read != 2 || errors != 1)
+        {
+            CPL_LOG_SS(Error, "YAML stream does not continue after a broken document!");
+            return false;
+        }
+
+        // Content before the first "---" is a document, leading comments and directives are not.
+        const std::pair<std::string, std::string> streams[] = {
+            { "a: 1\n---\nb: 2\n", "a: 1\n|b: 2\n|" },
+            { "- x\n---\n- y", "- x\n|- y\n|" },
+            { "---\n---\nb: 2\n", "|b: 2\n|" },
+            { "a: 1\n...\n---\nb: 2\n", "a: 1\n|b: 2\n|" },
+            { "# header\n\n---\nb: 2\n", "b: 2\n|" },
+            { "%YAML 1.2\n---\nb: 2\n", "b: 2\n|" } };
+        for (size_t s = 0; s < sizeof(streams) / sizeof(streams[0]); ++s)
+        {
+            for (size_t chunk = 1; chunk <= 64; chunk *= 64)
+            {
+                std::stringstream input(streams[s].first);
+                Cpl::Yaml::DocumentReader reader(input, chunk);
+                std::string documents;
+                while (reader.Next(doc))
+                {
+                    std::string text;
+                    Cpl::Yaml::Serialize(doc.Root(), text);
+                    documents += text + "|";
+                }
+                if (documents != streams[s].second)
+                {
+                    CPL_LOG_SS(Error, "Wrong documents of YAML stream '" << streams[s].first << "': '" << documents << "' !");
+                    return false;
+                }
+            }
+        }
+
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        for (int i = 0; i < 5; ++i)
+        {
+            CPL_PERF_BEGF("yaml stream parse", sample.size());
+            std::stringstream ss(sample);
+            Cpl::Yaml::DocumentReader reader(ss);
+            while (reader.Next(doc));
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        return true;
+    }
+
+    //---------------------------------------------------------------------------------------------
+
+    class YamlEventRecorder : public Cpl::Yaml::Handler
+    {
+    public:
+        YamlEventRecorder(const std::string& skip = std::string())
+            : skip(skip)
+        {
+        }
+
+        bool MapStart() override { events += "{"; return true; }
+        void MapEnd() override { events += "}"; }
+        bool SequenceStart() override { events += "["; return true; }
+        void SequenceEnd() override { events += "]"; }
+        bool Key(const char* data, size_t size) override
+        {
+            const std::string key(data, size);
+            events += key + ":";
+            return key != skip;
+        }
+        void Scalar(const char* data, size_t size) override { events += std::string(data, size) + ","; }
+        void Null() override { events += "~,"; }
+
+        std::string events, skip;
+    };
+
+    class YamlEventCounter : public Cpl::Yaml::Handler
+    {
+    public:
+        YamlEventCounter()
+            : count(0)
+        {
+        }
+
+        void Scalar(const char* /*data*/, size_t /*size*/) override { count++; }
+
+        size_t count;
+    };
+
+    bool YamlEventTest()
+    {
+        const std::string sample = "a: 1\nb:\n  - x\n  - 'y z'\n  - |\nc:\n  d: |\n    line\n";
+        YamlEventRecorder all, skip("b");
+        Cpl::Yaml::Parse(all, sample);
+        Cpl::Yaml::Parse(skip, sample);
+        if (all.events != "{a:1,b:[x,y z,~,]c:{d:line\n,}}" || skip.events != "{a:1,b:c:{d:line\n,}}")
+        {
+            CPL_LOG_SS(Error, "Wrong YAML events: " << all.events << " / " << skip.events);
+            return false;
+        }
+
+        const std::string large = YamlBufferSample(10000);
+        YamlEventCounter counter;
+        Cpl::Yaml::Parse(counter, large);
+        if (counter.count != 10000 * 5)
+        {
+            CPL_LOG_SS(Error, "Wrong number of YAML scalar events: " << counter.count);
+            return false;
+        }
+
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        for (int i = 0; i < 5; ++i)
+        {
+            {
+                CPL_PERF_BEGF("yaml node parse", large.size());
+                Cpl::Yaml::Node node;
+                Cpl::Yaml::Parse(node, large);
+            }
+            {
+                CPL_PERF_BEGF("yaml event parse", large.size());
+                Cpl::Yaml::Parse(counter, large);
+            }
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        return true;
+    }
+
+    //---------------------------------------------------------------------------------------------
+
+    bool YamlSerializeTest()
+    {
+        Cpl::Yaml::Node root;
+        root["name"] = "value";
+        root["quoted \"key\""] = "a: b";
+        root["list"].PushBack() = "1";
+        root["list"].PushBack()["x"] = "y";
+        root["text"] = "first line\nsecond line\n";
+        root["long"] = "a long text which is folded because it is longer than the limit";
+        root["empty"];
+        std::string serialized;
+        Cpl::Yaml::Serialize(root, serialized, Cpl::Yaml::SerializeConfig(2, 32));
+        const std::string expected =
+            "name: value\n"
+            "\"quoted \\\"key\\\"\": \"a: b\"\n"
+            "list: \n"
+            "  - 1\n"
+            "  - x: y\n"
+            "text: |\n"
+            "  first line\n"
+            "  second line\n"
+            "long: >-\n"
+            "  a long text which is folded because\n"
+            "  it is longer than the limit\n";
+        if (serialized != expected)
+        {
+            CPL_LOG_SS(Error, "Wrong YAML serialization: " << std::endl << serialized);
+            return false;
+        }
+
+        Cpl::Yaml::Node large;
+        for (size_t i = 0; i < 10000; ++i)
+        {
+            Cpl::Yaml::Node& item = large["items"].PushBack();
+            item["name"] = "item #" + std::to_string(i);
+            item["id"] = std::to_string(i);
+            for (size_t j = 0; j < 4; ++j)
+                item["values"].PushBack() = std::to_string(j);
+        }
+        std::string buffer;
+        std::stringstream stream;
+        Cpl::Yaml::Serialize(large, buffer);
+        Cpl::Yaml::Serialize(large, stream);
+        if (stream.str() != buffer)
+            return false;
+        Cpl::Yaml::Node parsed;
+        Cpl::Yaml::Parse(parsed, buffer);
+        if (parsed["items"].Size() != 10000 || parsed["items"][9999]["name"].As<std::string>() != "item #9999")
+            return false;
+
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        for (int i = 0; i < 5; ++i)
+        {
+            CPL_PERF_BEGF("yaml serialize", buffer.size());
+            Cpl::Yaml::Serialize(large, buffer);
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        return true;
+    }
+
+    //---------------------------------------------------------------------------------------------
+
+    bool YamlFindTest()
+    {
+        Cpl::Yaml::Node root;
+        Cpl::Yaml::Parse(root, std::string("a:\n  b: 42\n  c: 2.5\n  d: text\nlist:\n  - 7\n"));
+        const Cpl::Yaml::Node& croot = root;
+        if (croot.Find("x") || croot["a"].Find("x") || !croot["x"]["y"].IsNone() || !croot["list"][5].IsNone() || croot.Size() != 2 || croot["a"].Size() != 3)
+        {
+            CPL_LOG_SS(Error, "Read-only YAML lookup changes the tree!");
+            return false;
+        }
+        const Cpl::Yaml::Node* b = croot["a"].Find("b");
+        if (b == nullptr || b->As<int>() != 42 || b->As<double>() != 42.0 || b->As<uint16_t>() != 42 || croot["list"][0].As<int>() != 7)
+            return false;
+        if (croot["a"]["c"].As<float>() != 2.5f || croot["a"]["c"].As<int>() != 2 || croot["a"]["d"].As<int>(-1) != -1 || croot["a"]["d"].As<std::string>() != "text")
+            return false;
+        root["a"]["b"] = "100000";
+        if (b->As<int>() != 100000 || b->As<uint16_t>(3) != 3)
+        {
+            CPL_LOG_SS(Error, "Cached YAML scalar is not updated!");
+            return false;
+        }
+        Cpl::Yaml::Node shared;
+        for (int i = 0; i < 1000; ++i)
+            shared.PushBack() = std::to_string(i) + ".75";
+        const Cpl::Yaml::Node& cshared = shared;
+        std::atomic<int> errors(0);
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 4; ++t)
+        {
+            readers.push_back(std::thread([&cshared, &errors, t]()
+            {
+                for (int i = 0; i < 1000; ++i)
+                {
+                    if (t % 2 ? cshared[i].As<int>() != i : cshared[i].As<double>() != i + 0.75)
+                        errors++;
+                }
+            }));
+        }
+        for (size_t t = 0; t < readers.size(); ++t)
+            readers[t].join();
+        if (errors)
+        {
+            CPL_LOG_SS(Error, "Concurrent YAML scalar conversions are wrong!");
+            return false;
+        }
+        int value = 0;
+        std::vector<int> values;
+        root["v"] = "1 2 3";
+        if (!b->Get(value) || value != 100000 || croot["a"]["d"].Get(value) || value != 100000 || !croot["v"].Get(values) || values.size() != 3)
+            return false;
+
+        // Negative values are not converted to unsigned types (std::stringstream used to wrap them around).
+        root["a"]["b"] = "-1";
+        unsigned negative = 7;
+        if (b->As<int>() != -1 || b->As<unsigned>() != 0 || b->As<unsigned>(5) != 5 || b->As<uint64_t>(5) != 5 || b->Get(negative) || negative != 7)
+        {
+            CPL_LOG_SS(Error, "Negative YAML scalar is converted to unsigned type!");
+            return false;
+        }
+
+        Cpl::Yaml::Node large;
+        for (int i = 0; i < 1000; ++i)
+            large[std::to_string(i)] = std::to_string(i * 0.5);
+        const Cpl::Yaml::Node& clarge = large;
+        double sum = 0;
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        for (int n = 0; n < 5; ++n)
+        {
+            {
+                CPL_PERF_BEGF("yaml string convert", 1000);
+                for (int i = 0; i < 1000; ++i)
+                {
+                    double number;
+                    Cpl::ToVal(clarge[std::to_string(i)].As<std::string>(), number);
+                    sum += number;
+                }
+            }
+            {
+                CPL_PERF_BEGF("yaml cached convert", 1000);
+                for (int i = 0; i < 1000; ++i)
+                    sum += clarge.Find(std::to_string(i))->As<double>();
+            }
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        return sum == 10 * 0.5 * 999 * 1000 / 2;
+    }
+
+    //---------------------------------------------------------------------------------------------
+
+    bool YamlFlowTest()
+    {
+        Cpl::Yaml::Node root;
+        Cpl::Yaml::Parse(root, std::string(
+            "list: [1, 2.5, -3]\n"
+            "point: {x: 1, y: \"a, b\", z}\n"
+            "nested: [[1, 2], {k: [3]}, 'q: r']\n"
+            "multi: [10,\n"
+            "  20, 30]\n"
+            "empty: []\n"));
+        const Cpl::Yaml::Node& croot = root;
+        std::vector<double> list;
+        if (!croot["list"].Get(list) || list.size() != 3 || list[1] != 2.5 || list[2] != -3 || !croot["list"].IsFlow())
+        {
+            CPL_LOG_SS(Error, "Flow sequence is parsed incorrectly!");
+            return false;
+        }
+        if (croot["point"]["x"].As<int>() != 1 || croot["point"]["y"].As<std::string>() != "a, b" || !croot["point"]["z"].IsNone())
+        {
+            CPL_LOG_SS(Error, "Flow map is parsed incorrectly!");
+            return false;
+        }
+        if (croot["nested"][0][1].As<int>() != 2 || croot["nested"][1]["k"][0].As<int>() != 3 || croot["nested"][2].As<std::string>() != "q: r" ||
+            croot["multi"].Size() != 3 || croot["multi"][2].As<int>() != 30 || !croot["empty"].IsSequence() || croot["empty"].Size() != 0)
+        {
+            CPL_LOG_SS(Error, "Nested or multi-line flow collection is parsed incorrectly!");
+            return false;
+        }
+
+        std::string text;
+        Cpl::Yaml::Serialize(root, text);
+        Cpl::Yaml::Node back;
+        Cpl::Yaml::Parse(back, text);
+        std::string again;
+        Cpl::Yaml::Serialize(back, again);
+        if (text != again || text.find("list: [1, 2.5, -3]\n") == std::string::npos)
+        {
+            CPL_LOG_SS(Error, "Flow collections are not preserved on serialize:" << std::endl << text);
+            return false;
+        }
+
+        struct FlowParam
+        {
+            CPL_PARAM_VALUE(Cpl::Floats, weights, Cpl::Floats({ 0.5f, 1.5f, 2.0f }));
+            CPL_PARAM_VALUE(Cpl::Strings, names, Cpl::Strings({ "a", "b" }));
+        };
+        CPL_PARAM_HOLDER(FlowParamHolder, FlowParam, flow);
+        FlowParamHolder param, loaded;
+        param().weights().push_back(-4.0f);
+        std::stringstream ss;
+        if (!param.Save(ss, true, Cpl::ParamFormatYaml, true) || ss.str().find("weights: [") == std::string::npos)
+        {
+            CPL_LOG_SS(Error, "Param vector is not saved in flow style:" << std::endl << ss.str());
+            return false;
+        }
+        if (!loaded.Load(ss, Cpl::ParamFormatYaml) || !loaded.Equal(param))
+        {
+            CPL_LOG_SS(Error, "Param vector saved in flow style is loaded incorrectly!");
+            return false;
+        }
+
+        const size_t count = 100000;
+        std::string block = "values:\n", flow = "values: [";
+        for (size_t i = 0; i < count; ++i)
+        {
+            std::string value = std::to_string(i * 0.25);
+            block += "  - " + value + "\n";
+            flow += (i ? ", " : "") + value;
+        }
+        flow += "]\n";
+        double sum = 0;
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        for (int n = 0; n < 5; ++n)
+        {
+            std::vector<double> values;
+            {
+                CPL_PERF_BEGF("yaml block array", block.size());
+                Cpl::Yaml::Node node;
+                Cpl::Yaml::Parse(node, block);
+                node["values"].Get(values);
+            }
+            sum += values.back();
+            {
+                CPL_PERF_BEGF("yaml flow array", flow.size());
+                Cpl::Yaml::Node node;
+                Cpl::Yaml::Parse(node, flow);
+                node["values"].Get(values);
+            }
+            sum += values.back();
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        return sum == 10 * (count - 1) * 0.25;
+    }
+
+    //---------------------------------------------------------------------------------------------
+
+    static std::string YamlAnchorSample(size_t count, bool aliases)
+    {
+        std::string block = "\n";
+        for (int i = 0; i < 50; ++i)
+            block += "    key" + std::to_string(i) + ": value " + std::to_string(i) + "\n";
+        std::string data = "defaults: &defaults" + block + "items:\n";
+        for (size_t i = 0; i < count; ++i)
+        {
+            data += "  - name: item" + std::to_string(i) + "\n";
+            data += aliases ? "    config: *defaults\n" : "    config:" + block;
+        }
+        return data;
+    }
+
+    bool YamlAnchorTest()
+    {
+        Cpl::Yaml::Node root;
+        Cpl::Yaml::Parse(root, std::string(
+            "base: &base\n"
+            "  x: 1\n"
+            "  y: 2\n"
+            "derived:\n"
+            "  <<: *base\n"
+            "  y: 3\n"
+            "list:\n"
+            "  - &word hello\n"
+            "  - *word\n"
+            "  - *base\n"
+            "flow: [&five 5, *five, {k: *word}]\n"
+            "merged: {<<: [*base, {z: 9}], x: 0}\n"));
+        const Cpl::Yaml::Node& croot = root;
+        if (croot["derived"]["x"].As<int>() != 1 || croot["derived"]["y"].As<int>() != 3 || croot["derived"].Find("<<") ||
+            croot["list"][1].As<std::string>() != "hello" || croot["list"][2]["y"].As<int>() != 2 ||
+            croot["flow"][1].As<int>() != 5 || croot["flow"][2]["k"].As<std::string>() != "hello" ||
+            croot["merged"]["x"].As<int>() != 0 || croot["merged"]["y"].As<int>() != 2 || croot["merged"]["z"].As<int>() != 9)
+        {
+            CPL_LOG_SS(Error, "YAML anchors, aliases or merge keys are parsed incorrectly!");
+            return false;
+        }
+        root["base"]["x"] = "10";
+        root["list"][2]["y"] = "20";
+        if (croot["base"]["x"].As<int>() != 10 || croot["derived"]["x"].As<int>() != 1 || croot["list"][2]["x"].As<int>() != 1 ||
+            croot["list"][2]["y"].As<int>() != 20 || croot["base"]["y"].As<int>() != 2 || croot["merged"]["y"].As<int>() != 2)
+        {
+            CPL_LOG_SS(Error, "Changes of YAML anchored nodes are visible through aliases!");
+            return false;
+        }
+
+        std::string text, again;
+        Cpl::Yaml::Serialize(root, text);
+        Cpl::Yaml::Node back;
+        Cpl::Yaml::Parse(back, text);
+        Cpl::Yaml::Serialize(back, again);
+        if (text != again || text.find("*") == std::string::npos)
+        {
+            CPL_LOG_SS(Error, "YAML aliases are not preserved on serialize:" << std::endl << text);
+            return false;
+        }
+        if (text.find("- &word hello\n  - *word") == std::string::npos || text.find("[&five 5, *five, {k: *word}]") == std::string::npos)
+        {
+            CPL_LOG_SS(Error, "Names of YAML anchors are not preserved on serialize:" << std::endl << text);
+            return false;
+        }
+
+        bool unknown = false;
+        try
+        {
+            Cpl::Yaml::Parse(back, std::string("a: &a\n  - *a\n"));
+        }
+        catch (const Cpl::Yaml::ParsingException&)
+        {
+            unknown = true;
+        }
+        if (!unknown)
+        {
+            CPL_LOG_SS(Error, "Alias of unfinished anchor is accepted!");
+            return false;
+        }
+
+        const size_t count = 1000;
+        const std::string anchored = YamlAnchorSample(count, true), expanded = YamlAnchorSample(count, false);
+        Cpl::Yaml::Document documentA, documentE;
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        for (int n = 0; n < 5; ++n)
+        {
+            {
+                CPL_PERF_BEGF("yaml expanded parse", expanded.size());
+                documentE.Parse(expanded);
+            }
+            {
+                CPL_PERF_BEGF("yaml aliased parse", anchored.size());
+                documentA.Parse(anchored);
+            }
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        if (documentA.Root()["items"][count - 1]["config"]["key49"].As<std::string>() != "value 49" ||
+            documentA.Root()["items"].Size() != count || documentA.Reserved() * 10 > documentE.Reserved())
+        {
+            CPL_LOG_SS(Error, "YAML aliased document: " << documentA.Reserved() << " bytes, expanded: " << documentE.Reserved() << " bytes.");
+            return false;
+        }
+        return true;
+    }
+
+    //-------------------------------------------------------------------------------------------------
+
+    bool YamlCopyTest()
+    {
+        Cpl::Yaml::Node config;
+        Cpl::Yaml::Parse(config, std::string("server:\n  host: local\n  port: 80\nlimits:\n  - 1\n  - 2\n"));
+        Cpl::Yaml::Node copy = config;
+        copy["server"]["port"] = "8080";
+        copy["limits"].PushBack() = "3";
+        const Cpl::Yaml::Node& cconfig = config, & ccopy = copy;
+        if (cconfig["server"]["port"].As<int>() != 80 || cconfig["limits"].Size() != 2 || ccopy["server"]["port"].As<int>() != 8080 ||
+            ccopy["server"]["host"].As<std::string>() != "local" || ccopy["limits"].Size() != 3 || ccopy["limits"][1].As<int>() != 2)
+        {
+            CPL_LOG_SS(Error, "Change of YAML node copy is visible in the source!");
+            return false;
+        }
+        config["server"]["host"] = "remote";
+        config["limits"].Erase(0);
+        if (ccopy["server"]["host"].As<std::string>() != "local" || ccopy["limits"][0].As<int>() != 1)
+        {
+            CPL_LOG_SS(Error, "Change of YAML node source is visible in the copy!");
+            return false;
+        }
+
+        Cpl::Yaml::Node& port = config["server"]["port"];
+        Cpl::Yaml::Node request = config;
+        config["server"]["user"] = "admin";
+        port = "9090";
+        if (cconfig["server"]["port"].As<int>() != 9090 || request["server"]["port"].As<int>() != 80 || request["server"].Find("user"))
+        {
+            CPL_LOG_SS(Error, "Change through YAML node reference taken before copying is wrong!");
+            return false;
+        }
+        std::string copied, expected;
+        config["backup"] = config["server"];
+        Cpl::Yaml::Serialize(config, copied);
+        Cpl::Yaml::Node deep;
+        Cpl::Yaml::CopyNode(config, deep);
+        Cpl::Yaml::Serialize(deep, expected);
+        if (copied != expected || copied.find('&') != std::string::npos)
+        {
+            CPL_LOG_SS(Error, "YAML node copies are serialized with anchors!");
+            return false;
+        }
+
+        Cpl::Yaml::Node kept;
+        {
+            Cpl::Yaml::Document document;
+            document.Parse(std::string("a:\n  b: 1\n"));
+            kept = document.Root();
+            document.Parse(std::string("c: 2\n"));
+        }
+        Cpl::Yaml::Node nested;
+        nested["x"] = "1";
+        config["nested"] = nested;
+        nested["y"] = config;
+        if (kept["a"]["b"].As<int>() != 1 || nested["y"]["nested"]["x"].As<int>() != 1 || nested["y"]["nested"].Find("y"))
+        {
+            CPL_LOG_SS(Error, "YAML node copy doesn't outlive its source!");
+            return false;
+        }
+
+        std::string data;
+        for (int i = 0; i < 1000; ++i)
+            data += "record" + std::to_string(i) + ":\n  name: item " + std::to_string(i) + "\n  values:\n    - 1\n    - 2\n";
+        Cpl::Yaml::Document document;
+        document.Parse(data);
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        for (int n = 0; n < 5; ++n)
+        {
+            {
+                CPL_PERF_BEGF("yaml deep copy", data.size());
+                Cpl::Yaml::Node deep;
+                Cpl::Yaml::CopyNode(document.Root(), deep);
+            }
+            {
+                CPL_PERF_BEGF("yaml cow copy", data.size());
+                Cpl::Yaml::Node request = document.Root();
+                request["record500"]["name"] = "override";
+                if (document.Root()["record500"]["name"].As<std::string>() != "item 500")
+                    return false;
+            }
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        return true;
+    }
+
+    //-------------------------------------------------------------------------------------------------
+
+    bool YamlViewTest()
+    {
+        std::string data;
+        for (int i = 0; i < 2000; ++i)
+        {
+            data += "record" + std::to_string(i) + ":\n  name: \"item " + std::to_string(i) + "\"\n  size: " + std::to_string(i * 3) + "\n";
+            data += "  text: long text of the record\n    which takes two lines\n  tags: [a, b, c]\n";
+        }
+        Cpl::Yaml::Document copied, viewed, loaded;
+        copied.Parse(data);
+        viewed.ParseInPlace(data.data(), data.size());
+        std::ofstream("yaml_view.yml", std::ofstream::binary) << data;
+        loaded.Parse("yaml_view.yml");
+        std::string text0, text1, text2;
+        Cpl::Yaml::Serialize(copied.Root(), text0);
+        Cpl::Yaml::Serialize(viewed.Root(), text1);
+        Cpl::Yaml::Serialize(loaded.Root(), text2);
+        if (text0 != text1 || text0 != text2 || viewed.Root()["record7"]["name"].As<std::string>() != "item 7" || viewed.Reserved() >= copied.Reserved())
+        {
+            CPL_LOG_SS(Error, "YAML in place parsing is incorrect: " << viewed.Reserved() << " bytes (copied " << copied.Reserved() << " bytes).");
+            return false;
+        }
+        viewed.Root()["record7"]["size"] = "changed";
+        if (viewed.Root()["record7"]["size"].As<std::string>() != "changed" || data.find("size: 21\n") == std::string::npos)
+        {
+            CPL_LOG_SS(Error, "Change of YAML scalar view changes the input buffer!");
+            return false;
+        }
+
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        for (int n = 0; n < 5; ++n)
+        {
+            {
+                CPL_PERF_BEGF("yaml copied parse", data.size());
+                copied.Parse(data);
+            }
+            {
+                CPL_PERF_BEGF("yaml in place parse", data.size());
+                viewed.ParseInPlace(data.data(), data.size());
+            }
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        CPL_LOG_SS(Verbose, "YAML document memory: copied " << copied.Reserved() << " bytes, in place " << viewed.Reserved() << " bytes.");
+        return true;
+    }
+
+    //-------------------------------------------------------------------------------------------------
+
+    static std::string YamlParallelSerialized(Cpl::Yaml::Document& document, const std::string& data, bool parallel)
+    {
+        std::string text;
+        try
+        {
+            if (parallel)
+                document.ParseParallel(data.data(), data.size(), 4);
+            else
+                document.Parse(data);
+            Cpl::Yaml::Serialize(document.Root(), text);
+        }
+        catch (const Cpl::Yaml::Exception& e)
+        {
+            text = e.what();
+        }
+        return text;
+    }
+
+    bool YamlParallelTest()
+    {
+        std::string records, list;
+        for (int i = 0; i < 5000; ++i)
+        {
+            records += "record" + std::to_string(i) + ": # comment\n  name: \"item " + std::to_string(i) + "\"\n  values: [1, 2,\n3]\n";
+            records += "  text: |\n    block\n\n    scalar\n";
+            list += "- id: " + std::to_string(i) + "\n  tags:\n    - a\n    - b\n";
+        }
+        const char* cases[] = {
+            "a: &x 1\nb: 2\nc: 3\nd: *x\n",
+            "a: 1\nb: 2\nc: 3\na: 4\n",
+            "a:\n  x: 1\nb: 2\nc: 3\na:\n  y: 2\n",
+            "a: 1\nb: 2\n---\nc: 3\nd: 4\n",
+            "a: [1,\nb: 2]\nc: 3\nd: 4\n",
+            "- 1\n- 2\n- 3\nx: 4\n",
+            "a: 1\nb: 2\nc: 3\n  d: 4\n",
+        };
+        Cpl::Yaml::Document serial, parallel;
+        for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+        {
+            if (YamlParallelSerialized(serial, cases[i], false) != YamlParallelSerialized(parallel, cases[i], true))
+            {
+                CPL_LOG_SS(Error, "Parallel YAML parsing differs from serial one for:" << std::endl << cases[i]);
+                return false;
+            }
+        }
+
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        const std::string* inputs[] = { &records, &list };
+        for (size_t i = 0; i < 2; ++i)
+        {
+            const std::string& data = *inputs[i];
+            for (int n = 0; n < 5; ++n)
+            {
+                {
+                    CPL_PERF_BEGF("yaml serial parse", data.size());
+                    serial.Parse(data);
+                }
+                {
+                    CPL_PERF_BEGF("yaml parallel parse", data.size());
+                    parallel.ParseParallel(data.data(), data.size(), 4);
+                }
+            }
+            std::string text0, text1;
+            Cpl::Yaml::Serialize(serial.Root(), text0);
+            Cpl::Yaml::Serialize(parallel.Root(), text1);
+            if (text0 != text1 || parallel.Root().Size() != 5000)
+            {
+                CPL_LOG_SS(Error, "Parallel YAML parsing gives other tree!");
+                return false;
+            }
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        return true;
+    }
+
+    //-------------------------------------------------------------------------------------------------
+
+    bool YamlPathTest()
+    {
+        Cpl::Yaml::Node root;
+        Cpl::Yaml::Parse(root, std::string(
+            "a:\n"
+            "  b:\n"
+            "    - c: 0\n"
+            "    - c: 1\n"
+            "    - x: 2\n"
+            "    - c: 3\n"
+            "  \"d.e\": 5\n"
+            "list: [{n: 1}, {n: 2}, {m: 3}]\n"));
+        const Cpl::Yaml::Node& croot = root;
+        const Cpl::Yaml::Node* c3 = Cpl::Yaml::Path("a.b[3].c").Find(croot);
+        const Cpl::Yaml::Node* de = Cpl::Yaml::Path("a[\"d.e\"]").Find(croot);
+        std::vector<const Cpl::Yaml::Node*> all, names;
+        Cpl::Yaml::Path("a.b[*].c").Select(croot, all);
+        Cpl::Yaml::Path("list.*.n").Select(croot, names);
+        if (c3 == nullptr || c3->As<int>() != 3 || de == nullptr || de->As<int>() != 5 || all.size() != 3 || all[1]->As<int>() != 1 ||
+            names.size() != 2 || names[1]->As<int>() != 2 || Cpl::Yaml::Path("a.b[4].c").Find(croot) || Cpl::Yaml::Path("a.b.c").Find(croot) ||
+            Cpl::Yaml::Path("*.b[*].x").Find(croot)->As<int>() != 2 || croot["a"].Size() != 2)
+        {
+            CPL_LOG_SS(Error, "YAML path is resolved incorrectly!");
+            return false;
+        }
+        const char* invalid[] = { "a..b", "a[", "a[x]", "a.", "[\"a]", "a[99999999999999999999999]", "a[0]b" };
+        for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i)
+        {
+            try
+            {
+                Cpl::Yaml::Path path(invalid[i]);
+                CPL_LOG_SS(Error, "Invalid YAML path " << invalid[i] << " is accepted!");
+                return false;
+            }
+            catch (const Cpl::Yaml::OperationException&)
+            {
+            }
+        }
+        const size_t columns[] = { 3, 3, 3, 3, 1, 22, 5 };
+        Cpl::Yaml::Path compiled;
+        for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i)
+        {
+            Cpl::Yaml::Status status = compiled.TryCompile(invalid[i]);
+            if (status || status.Type != Cpl::Yaml::Exception::OperationError || status.Column != columns[i])
+            {
+                CPL_LOG_SS(Error, "Invalid YAML path " << invalid[i] << " is reported incorrectly!");
+                return false;
+            }
+        }
+        if (!compiled.TryCompile("a.b[3].c") || compiled.Find(croot) != c3)
+            return false;
+
+        Cpl::Yaml::Node copy = root;
+        Cpl::Yaml::Node* pC = Cpl::Yaml::Path("a.b[3].c").Find(copy);
+        *pC = "30";
+        if (c3->As<int>() != 3 || Cpl::Yaml::Path("a.b[3].c").Find(static_cast<const Cpl::Yaml::Node&>(copy))->As<int>() != 30)
+        {
+            CPL_LOG_SS(Error, "Change of YAML node found by path is visible in the source!");
+            return false;
+        }
+
+        Cpl::Yaml::Node large;
+        std::vector<std::string> keys;
+        for (int i = 0; i < 100; ++i)
+        {
+            keys.push_back("group" + std::to_string(i));
+            for (int j = 0; j < 10; ++j)
+                large[keys.back()]["items"].PushBack()["value"] = std::to_string(i * j);
+        }
+        const Cpl::Yaml::Node& clarge = large;
+        Cpl::Yaml::PathSet set;
+        std::vector<Cpl::Yaml::Path> paths;
+        for (int i = 0; i < 100; ++i)
+        {
+            paths.push_back(Cpl::Yaml::Path(keys[i] + ".items[7].value"));
+            set.Add(paths.back());
+        }
+        int sum0 = 0, sum1 = 0, sum2 = 0;
+        std::vector<std::vector<const Cpl::Yaml::Node*>> results;
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        for (int n = 0; n < 10; ++n)
+        {
+            {
+                CPL_PERF_BEGF("yaml operator chain", 100);
+                for (int i = 0; i < 100; ++i)
+                    sum0 += clarge[keys[i]]["items"][7]["value"].As<int>();
+            }
+            {
+                CPL_PERF_BEGF("yaml path find", 100);
+                for (int i = 0; i < 100; ++i)
+                    sum1 += paths[i].Find(clarge)->As<int>();
+            }
+            {
+                CPL_PERF_BEGF("yaml path set", 100);
+                set.Select(clarge, results);
+                for (int i = 0; i < 100; ++i)
+                    sum2 += results[i][0]->As<int>();
+            }
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        return sum0 == sum1 && sum1 == sum2 && sum0 == 10 * 7 * 99 * 100 / 2;
+    }
+
+    //---------------------------------------------------------------------------------------------
+
+    bool YamlXmlTest()
+    {
+        struct SubParam
+        {
+            CPL_PARAM_VALUE(Int, id, 1);
+            CPL_PARAM_VALUE(String, desc, "no");
+        };
+
+        struct TestParam
+        {
+            CPL_PARAM_VALUE(String, name, "Name");
+            CPL_PARAM_VALUE(Strings, letters, Strings({ "A", "B", "C" }));
+            CPL_PARAM_VALUE(Cpl::Floats, weights, Cpl::Floats({ 0.5f, 1.5f }));
+            CPL_PARAM_STRUCT(SubParam, sub);
+            CPL_PARAM_VECTOR(SubParam, subs);
+            CPL_PARAM_MAP(String, SubParam, dict);
+            CPL_PARAM_MAP(Int, SubParam, ids);
+        };
+        CPL_PARAM_HOLDER(TestParamHolder, TestParam, test);
+
+        TestParamHolder test, loaded;
+        test().name() = "<Changed & 'more'>";
+        test().subs().resize(2);
+        test().subs()[1].desc() = "seven";
+        test().dict()["A"].desc() = "A";
+        test().dict()["item"].id() = 3;
+        test().dict()["two words"];
+        test().ids()[7].desc() = "seven";
+
+        std::stringstream xml, yaml, flow;
+        test.Save(xml, true, Cpl::ParamFormatXml);
+        test.Save(yaml, true, Cpl::ParamFormatYaml);
+        test.Save(flow, true, Cpl::ParamFormatYaml, true);
+
+        std::string transcoded;
+        Cpl::Yaml::FromXml(xml.str().data(), xml.str().size(), transcoded);
+        if (transcoded != yaml.str())
+        {
+            CPL_LOG_SS(Error, "XML of Param is transcoded to YAML incorrectly:" << std::endl << transcoded);
+            return false;
+        }
+        const Cpl::Strings maps({ "dict", "ids" });
+        Cpl::Yaml::ToXml(yaml.str().data(), yaml.str().size(), transcoded, maps);
+        if (transcoded != xml.str() || !loaded.Load(transcoded.data(), transcoded.size(), Cpl::ParamFormatXml) || !loaded.Equal(test))
+        {
+            CPL_LOG_SS(Error, "YAML of Param is transcoded to XML incorrectly:" << std::endl << transcoded);
+            return false;
+        }
+        std::stringstream stream;
+        Cpl::Yaml::ToXml(flow.str().data(), flow.str().size(), stream, maps);
+        if (stream.str() != transcoded || !loaded.Load(stream, Cpl::ParamFormatXml) || !loaded.Equal(test))
+        {
+            CPL_LOG_SS(Error, "YAML of Param with flow vectors is transcoded to XML incorrectly:" << std::endl << stream.str());
+            return false;
+        }
+
+        const std::string anchors =
+            "base: &base\n"
+            "  x: 1\n"
+            "  y: [a, b c]\n"
+            "copy: *base\n"
+            "derived:\n"
+            "  <<: *base\n"
+            "  x: 2\n"
+            "1: [1, 2, 3]\n";
+        const std::string expected =
+            "base: \n"
+            "  x: 1\n"
+            "  y: \n"
+            "    - a\n"
+            "    - b c\n"
+            "copy: \n"
+            "  x: 1\n"
+            "  y: \n"
+            "    - a\n"
+            "    - b c\n"
+            "derived: \n"
+            "  x: 2\n"
+            "  y: \n"
+            "    - a\n"
+            "    - b c\n"
+            "1: 1 2 3\n";
+        std::string back;
+        Cpl::Yaml::ToXml(anchors.data(), anchors.size(), transcoded);
+        Cpl::Yaml::FromXml(transcoded.data(), transcoded.size(), back);
+        if (back != expected)
+        {
+            CPL_LOG_SS(Error, "Anchors are transcoded incorrectly:" << std::endl << transcoded << std::endl << back);
+            return false;
+        }
+
+        const std::string invalid = "<root><a>1</a>";
+        if (!Cpl::Yaml::TryFromXml(invalid.data(), invalid.size(), back).Failed || Cpl::Yaml::TryFromXml(transcoded.data(), transcoded.size(), back).Failed ||
+            back != expected || !Cpl::Yaml::TryToXml("a: [1, 2", 8, transcoded).Failed)
+        {
+            CPL_LOG_SS(Error, "Transcoding without exceptions reports errors incorrectly!");
+            return false;
+        }
+
+        std::stringstream ss;
+        for (size_t i = 0; i < 20000; ++i)
+        {
+            ss << "record" << i << ":\n";
+            ss << "  name: \"record #" << i << "\"\n";
+            ss << "  values: [" << i << ", " << i * 2 << ", " << i * 3 << "]\n";
+            ss << "  tags:\n";
+            ss << "    - first\n";
+            ss << "    - second: " << i << "\n";
+        }
+        const std::string large = ss.str();
+        Cpl::Yaml::Node node;
+        Cpl::Yaml::Parse(node, large);
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        for (int n = 0; n < 3; ++n)
+        {
+            {
+                CPL_PERF_BEGF("yaml to xml", large.size());
+                Cpl::Yaml::ToXml(large.data(), large.size(), transcoded);
+            }
+            {
+                CPL_PERF_BEGF("xml to yaml", transcoded.size());
+                Cpl::Yaml::FromXml(transcoded.data(), transcoded.size(), back);
+            }
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        Cpl::Yaml::Node node2;
+        Cpl::Yaml::Parse(node2, back);
+        if (node2.Size() != node.Size() || node2["record7"]["tags"][1]["second"].As<int>() != 7 ||
+            node2["record9"]["values"].As<std::string>() != "9 18 27")
+        {
+            CPL_LOG_SS(Error, "Large YAML is transcoded incorrectly!");
+            return false;
+        }
+
+        // Stream is transcoded by blocks of top-level entries, aliases refer to anchors of previous blocks.
+        const std::string inputs[] = { yaml.str(), flow.str(), anchors, large, anchors + large + "last: *base\n", "---\n" + anchors, "- 1\n- [2, 3]\n" };
+        const size_t chunks[] = { 16, 100, 4096 };
+        for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+        {
+            std::string whole;
+            Cpl::Yaml::ToXml(inputs[i].data(), inputs[i].size(), whole, maps);
+            for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); ++c)
+            {
+                std::stringstream input(inputs[i]), output;
+                if (Cpl::Yaml::TryToXml(input, output, maps, chunks[c]).Failed || output.str() != whole)
+                {
+                    CPL_LOG_SS(Error, "YAML stream " << i << " is transcoded by chunks of " << chunks[c] << " bytes incorrectly:" << std::endl << output.str());
+                    return false;
+                }
+            }
+        }
+        std::stringstream documents("a: 1\n---\nb: 2\n"), single, broken("a: 1\nb: [1, 2\n");
+        if (Cpl::Yaml::TryToXml(documents, single).Failed || single.str() != "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<a>1</a>\n\n" ||
+            !Cpl::Yaml::TryToXml(broken, single).Failed)
+        {
+            CPL_LOG_SS(Error, "Documents of YAML stream are transcoded incorrectly:" << std::endl << single.str());
+            return false;
+        }
+
+        return true;
+    }
+
+    //---------------------------------------------------------------------------------------------
+
+    bool YamlQuoteTest()
+    {
+        Cpl::Yaml::Node root;
+        Cpl::Yaml::Parse(root, std::string(
+            "\"key #1\": \"value: with \\\"escapes\\\" # hash\" # comment\n"
+            "\"k\\\\2\": 'single' # comment\n"
+            "list:\n"
+            "  - \"a: b\" # c\n"
+            "  - \"x\": y\n"));
+        if (root["key #1"].As<std::string>() != "value: with \\\"escapes\\\" # hash" || root["k\\2"].As<std::string>() != "single" ||
+            root["list"][0].As<std::string>() != "a: b" || root["list"][1]["x"].As<std::string>() != "y" || root.Size() != 3)
+        {
+            CPL_LOG_SS(Error, "Quoted YAML is parsed incorrectly!");
+            return false;
+        }
+        const char* invalid[] = { "a: b \"c # d\n", "a: \"b\" c\"\n", "\"a\" \"b\": c\n", "a: 'b\n" };
+        for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i)
+        {
+            try
+            {
+                Cpl::Yaml::Node node;
+                Cpl::Yaml::Parse(node, std::string(invalid[i]));
+                CPL_LOG_SS(Error, "Invalid quoted YAML " << invalid[i] << " is accepted!");
+                return false;
+            }
+            catch (const Cpl::Yaml::ParsingException&)
+            {
+            }
+        }
+
+        std::stringstream ss;
+        for (int i = 0; i < 10000; ++i)
+        {
+            ss << "\"key #" << i << "\": \"value: with \\\"escapes\\\" and # hash " << i << "\" # comment\n";
+            ss << "list" << i << ":\n  - \"a: " << i << "\"\n  - 'b' # c\n";
+        }
+        const std::string text = ss.str();
+        Cpl::Yaml::Document doc;
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        for (int n = 0; n < 10; ++n)
+        {
+            CPL_PERF_BEGF("yaml quoted parse", text.size());
+            doc.Parse(text.data(), text.size());
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        return doc.Root().Size() == 20000 && doc.Root()["list9999"][0].As<std::string>() == "a: 9999";
+    }
+
+    //-------------------------------------------------------------------------------------------------
+
+    bool YamlStatusTest()
+    {
+        const char* invalid[] = { "a: [1, 2\n", "a:\n\t- 1\n", "- &x 1\n- *y\n", "a: 'b\n", "a: |x\n  b\n", "a: b \"c # d\n" };
+        const size_t lines[] = { 1, 2, 2, 1, 1, 1 };
+        for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i)
+        {
+            std::string message;
+            try
+            {
+                Cpl::Yaml::Node node;
+                Cpl::Yaml::Parse(node, std::string(invalid[i]));
+            }
+            catch (const Cpl::Yaml::Exception& e)
+            {
+                message = e.what();
+            }
+            Cpl::Yaml::Node node;
+            node["old"] = "value";
+            const Cpl::Yaml::Status status = Cpl::Yaml::TryParse(node, std::string(invalid[i]));
+            if (status || status.Type != Cpl::Yaml::Exception::ParsingError || status.Message != message ||
+                status.Line != lines[i] || status.Column == 0 || node.IsNone() == false)
+            {
+                CPL_LOG_SS(Error, "Wrong status of invalid YAML " << invalid[i] << ": " << status.Line << ":" << status.Column << " " << status.Message);
+                return false;
+            }
+        }
+
+        Cpl::Yaml::Document doc;
+        Cpl::Yaml::Status status = doc.TryParse(std::string("a: 1\nb:\n  - x\n  - [y, z]\n"));
+        if (!status || status.Message.size() || doc.Root()["b"][1][1].As<std::string>() != "z")
+        {
+            CPL_LOG_SS(Error, "Valid YAML is not parsed by TryParse()!");
+            return false;
+        }
+        status = doc.TryParse("not_existing_file.yaml");
+        if (status || status.Type != Cpl::Yaml::Exception::OperationError || doc.Root().IsNone() == false)
+        {
+            CPL_LOG_SS(Error, "Missing file is not reported by TryParse()!");
+            return false;
+        }
+
+        std::stringstream in("a: 1\n...\nb: [2\n...\nc: 3\n");
+        Cpl::Yaml::DocumentReader reader(in);
+        size_t count = 0, failed = 0;
+        while (reader.Next(doc, status))
+        {
+            if (status)
+                count++;
+            else if (status.Line == 1)
+                failed++;
+        }
+        if (count != 2 || failed != 1)
+        {
+            CPL_LOG_SS(Error, "DocumentReader::Next() returns wrong status!");
+            return false;
+        }
+
+        std::stringstream ss;
+        for (int i = 0; i < 1000; ++i)
+            ss << "key" << i << ": value " << i << "\n";
+        ss << "broken: [1, 2\n";
+        const std::string text = ss.str();
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        for (int n = 0; n < 100; ++n)
+        {
+            {
+                CPL_PERF_BEGF("yaml error by exception", text.size());
+                try
+                {
+                    doc.Parse(text.data(), text.size());
+                }
+                catch (const Cpl::Yaml::ParsingException&)
+                {
+                }
+            }
+            {
+                CPL_PERF_BEGF("yaml error by status", text.size());
+                status = doc.TryParse(text.data(), text.size());
+            }
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        return status.Failed && status.Line == 1001;
+    }
+
+    //-------------------------------------------------------------------------------------------------
+
+    bool YamlFileTest()
+    {
+        std::string data;
+        for (int i = 0; i < 20000; ++i)
+            data += "record" + std::to_string(i) + ":\n  name: \"item " + std::to_string(i) + "\"\n  tags: [a, b]\n";
+        // The size is a multiple of the page: reading past the end of the mapping would fail.
+        const size_t size = (data.size() + 4096 + 4095) / 4096 * 4096;
+        data += "#" + std::string(size - data.size() - 9, '-') + "\nend: 12";
+        std::ofstream("yaml_file.yml", std::ofstream::binary) << data;
+
+        Cpl::Yaml::Node root, copy;
+        Cpl::Yaml::Parse(root, "yaml_file.yml");
+        {
+            Cpl::Yaml::Document document;
+            document.Parse("yaml_file.yml");
+            copy = document.Root();
+        }
+        if (root["record7"]["name"].As<std::string>() != "item 7" || root["end"].As<int>() != 12 ||
+            copy["record7"]["name"].As<std::string>() != "item 7" || copy["end"].As<int>() != 12)
+        {
+            CPL_LOG_SS(Error, "YAML file is parsed incorrectly!");
+            return false;
+        }
+
+#if defined(__linux__)
+        // A pipe can't be mapped and has no size: it is read by chunks.
+        ::remove("yaml_file.fifo");
+        if (mkfifo("yaml_file.fifo", 0600) == 0)
+        {
+            std::thread writer([&data]() { std::ofstream("yaml_file.fifo", std::ofstream::binary) << data; });
+            Cpl::Yaml::Node piped;
+            const Cpl::Yaml::Status status = Cpl::Yaml::TryParse(piped, "yaml_file.fifo");
+            writer.join();
+            ::remove("yaml_file.fifo");
+            if (status.Failed || piped["record19999"]["name"].As<std::string>() != "item 19999" || piped["end"].As<int>() != 12)
+            {
+                CPL_LOG_SS(Error, "YAML file from a pipe is parsed incorrectly!");
+                return false;
+            }
+        }
+#endif
+
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        Cpl::Yaml::Document document;
+        for (int n = 0; n < 5; ++n)
+        {
+            {
+                CPL_PERF_BEGF("yaml file read and parse", data.size());
+                std::ifstream file("yaml_file.yml", std::ifstream::binary);
+                std::string buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+                document.Parse(buffer);
+            }
+            {
+                CPL_PERF_BEGF("yaml file mapped parse", data.size());
+                document.Parse("yaml_file.yml");
+            }
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        return document.Root()["record7"]["tags"][1].As<std::string>() == "b";
+    }
+
+    //-------------------------------------------------------------------------------------------------
+
+    bool YamlIncrementalTest()
+    {
+        std::string text;
+        for (int i = 0; i < 5000; ++i)
+            text += "record" + std::to_string(i) + ":\n  name: \"item " + std::to_string(i) + "\"\n  tags: [a, b]\n";
+        Cpl::Yaml::IncrementalDocument document;
+        document.Parse(text.data(), text.size());
+
+        const char* edits[][2] = { { "  name: \"item 2500\"", "  name: \"edited\"\n  size: 3" }, { "record100:", "renamed:" },
+            { "record4999:\n", "" }, { "record7:\n", "new: value\nrecord7:\n" }, { "  tags: [a, b]\nrecord10:", "  tags: [a, b, c]\nrecord10:" } };
+        for (size_t e = 0; e < sizeof(edits) / sizeof(edits[0]); ++e)
+        {
+            const size_t offset = text.find(edits[e][0]), removed = strlen(edits[e][0]);
+            text.replace(offset, removed, edits[e][1]);
+            document.Update(text.data(), text.size(), offset, removed);
+            Cpl::Yaml::Document full;
+            full.Parse(text);
+            std::string text0, text1;
+            Cpl::Yaml::Serialize(document.Root(), text0);
+            Cpl::Yaml::Serialize(full.Root(), text1);
+            if (text0 != text1 || document.Blocks() == 0 || document.Parsed() * 10 > text.size())
+            {
+                CPL_LOG_SS(Error, "Incremental YAML parsing after edit " << e << " is incorrect: parsed " << document.Parsed() << " bytes of " << text.size() << ".");
+                return false;
+            }
+        }
+        if (document.Root()["record2500"]["size"].As<int>() != 3 || document.Root()["renamed"]["name"].As<std::string>() != "item 100" ||
+            document.Root()["record4999"].IsNone() == false || document.Root()["new"].As<std::string>() != "value")
+        {
+            CPL_LOG_SS(Error, "Incremental YAML parsing gives wrong values!");
+            return false;
+        }
+
+        const size_t offset = text.find("record300:");
+        text.insert(offset, "bad: [1\n");
+        if (document.TryUpdate(text.data(), text.size(), offset, 0) || document.Root().IsNone() == false)
+        {
+            CPL_LOG_SS(Error, "Invalid edit of YAML is not reported!");
+            return false;
+        }
+        text.erase(offset, 8);
+        document.Update(text.data(), text.size(), offset, 8);
+
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        Cpl::Yaml::Document full;
+        for (int n = 0; n < 20; ++n)
+        {
+            const size_t pos = text.find("item " + std::to_string(n * 200));
+            {
+                CPL_PERF_BEGF("yaml full reparse", text.size());
+                text[pos] = 'I';
+                full.Parse(text);
+            }
+            {
+                CPL_PERF_BEGF("yaml incremental reparse", text.size());
+                text[pos] = 'i';
+                document.Update(text.data(), text.size(), pos, 1);
+            }
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        return document.Root()["record3800"]["name"].As<std::string>() == "item 3800";
+    }
+
+    //-------------------------------------------------------------------------------------------------
+
+    struct YamlPoint
+    {
+        double x, y;
+    };
+
+    struct YamlServer
+    {
+        std::string host;
+        int port;
+        bool tls;
+        std::vector<int> ids;
+        YamlPoint origin;
+        std::vector<YamlPoint> path;
+    };
+
+    bool YamlSchemaTest()
+    {
+        Cpl::Yaml::Schema<YamlPoint> point;
+        point.Field("x", &YamlPoint::x, 1.5).Field("y", &YamlPoint::y);
+        Cpl::Yaml::Schema<YamlServer> schema;
+        schema.Field("host", &YamlServer::host, "localhost").Field("port", &YamlServer::port, 80).Field("tls", &YamlServer::tls, true)
+            .Field("ids", &YamlServer::ids).Field("origin", &YamlServer::origin, point).Field("path", &YamlServer::path, point);
+
+        YamlServer server;
+        schema.Load(server, std::string("host: example.org\nport: 8080\nids: [1, 2, 3]\norigin:\n  y: 2\nunknown:\n  deep: [1, {a: b}]\npath:\n  - x: 1\n    y: 2\n  - {x: 3}\n"));
+        if (server.host != "example.org" || server.port != 8080 || server.tls != true || server.ids.size() != 3 || server.ids[2] != 3 ||
+            server.origin.x != 1.5 || server.origin.y != 2 || server.path.size() != 2 || server.path[0].y != 2 || server.path[1].x != 3 || server.path[1].y != 0)
+        {
+            CPL_LOG_SS(Error, "Schema loading of YAML gives wrong values!");
+            return false;
+        }
+
+        const char* errors[][2] = { { "port: 80x\n", "Field 'port' (integer). Line 1" }, { "tls: no\nids: 1 2 q\n", "Field 'ids' (sequence). Line 2" },
+            { "path:\n  - x: 1\n  - y: [2]\n", "Field 'path[1].y' (number). Line 3" }, { "origin: 5\n", "Field 'origin' (map). Line 1" } };
+        for (size_t e = 0; e < sizeof(errors) / sizeof(errors[0]); ++e)
+        {
+            Cpl::Yaml::Status status = schema.TryLoad(server, std::string(errors[e][0]));
+            if (status || status.Message.find(errors[e][1]) == std::string::npos)
+            {
+                CPL_LOG_SS(Error, "Schema loading error of YAML is wrong: " << status.Message);
+                return false;
+            }
+        }
+
+        std::string text;
+        for (int i = 0; i < 20000; ++i)
+            text += "  - x: " + std::to_string(i) + ".5\n    y: " + std::to_string(i) + "\n";
+        text = "host: bench\npath:\n" + text;
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        double sum0 = 0, sum1 = 0;
+        for (int n = 0; n < 5; ++n)
+        {
+            {
+                CPL_PERF_BEGF("yaml node loading", text.size());
+                Cpl::Yaml::Document document;
+                document.Parse(text);
+                const Cpl::Yaml::Node& path = document.Root()["path"];
+                for (size_t i = 0; i < path.Size(); ++i)
+                    sum0 += path[i]["x"].As<double>() + path[i]["y"].As<double>();
+            }
+            {
+                CPL_PERF_BEGF("yaml schema loading", text.size());
+                schema.Load(server, text);
+                for (size_t i = 0; i < server.path.size(); ++i)
+                    sum1 += server.path[i].x + server.path[i].y;
+            }
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+        return sum0 == sum1 && server.host == "bench";
+    }
+
+    //-------------------------------------------------------------------------------------------------
+
+    /// Synthetic YAML which is shaped like production configs: deep maps, long sequences, block and quoted scalars.
+    static std::string GenerateYamlCorpus(size_t size)
+    {
+        std::string text;
+        uint32_t seed = 1;
+        auto random = [&seed](uint32_t range) { seed = seed * 1664525 + 1013904223; return (seed >> 8) % range; };
+        for (size_t s = 0; text.size() < size; ++s)
+        {
+            const std::string id = std::to_string(s);
+            text += "service" + id + ":\n  name: \"service " + id + " \\\"main\\\"\"\n  owner: 'team, " + id + "'\n";
+            text += "  enabled: " + std::string(random(2) ? "true" : "false") + "\n";
+            text += "  ports: [" + std::to_string(8000 + random(1000)) + ", 443, {internal: " + std::to_string(random(100)) + "}]\n";
+            std::string indent = "  ";
+            for (uint32_t d = 0, depth = 3 + random(6); d < depth; ++d, indent += "  ")
+                text += indent + "level" + std::to_string(d) + ":\n" + indent + "  weight: " + std::to_string(random(1000)) + ".25\n";
+            text += indent + "leaf: value " + id + "\n  hosts:\n";
+            for (uint32_t i = 0, n = 10 + random(40); i < n; ++i)
+                text += "    - host-" + std::to_string(i) + ".region" + std::to_string(random(8)) + ".example.org\n";
+            text += "  replicas:\n";
+            for (uint32_t i = 0, n = 2 + random(6); i < n; ++i)
+                text += "    - id: " + std::to_string(i) + "\n      zone: \"zone " + std::to_string(random(4)) + "\"\n";
+            text += "  script: |\n    set -e\n    run --service " + id + " --verbose\n    echo done\n";
+            text += "  summary: >\n    Service " + id + " handles requests\n    of its region and reports metrics.\n";
+        }
+        return text;
+    }
+
+    struct YamlBenchmarkResult
+    {
+        std::string name;
+        double speed;
+        size_t memory;
+    };
+
+    struct YamlBenchmarkResults
+    {
+        std::vector<YamlBenchmarkResult> results;
+    };
+
+    /// It is run only by -i=YamlBenchmark. If -bd=dir is set, results are saved to "dir/yaml_benchmark.yml"
+    /// and compared with "dir/yaml_benchmark_baseline.yml" (a copy of earlier results).
+    bool YamlBenchmarkTest()
+    {
+        const std::string text = GenerateYamlCorpus(2 * 1024 * 1024);
+        Cpl::Yaml::Document document;
+        document.Parse(text);
+        Cpl::Yaml::Handler handler;
+        std::string serialized;
+        typedef std::function<size_t()> Stage;
+        const std::pair<std::string, Stage> stages[] = {
+            { "parse", [&]() {
+                Cpl::Yaml::Document parsed;
+                parsed.Parse(text);
+                return parsed.Reserved(); } },
+            { "parse in place", [&]() {
+                Cpl::Yaml::Document inPlace;
+                inPlace.ParseInPlace(text.data(), text.size());
+                return inPlace.Reserved(); } },
+            { "parse events", [&]() {
+                Cpl::Yaml::Parse(handler, text);
+                return size_t(0); } },
+            { "serialize", [&]() {
+                serialized.clear();
+                serialized.shrink_to_fit();
+                Cpl::Yaml::Serialize(document.Root(), serialized);
+                return serialized.capacity(); } } };
+
+        // Speed (MB/s of the corpus) is the best of several runs, memory is the size of the document arena (or of the output) a stage leaves.
+        YamlBenchmarkResults current;
+#if defined(CPL_PERF_ENABLE)
+        Cpl::PerformanceStorage::Global().Clear();
+#endif
+        for (size_t s = 0; s < sizeof(stages) / sizeof(stages[0]); ++s)
+        {
+            YamlBenchmarkResult result = { stages[s].first, 0.0, 0 };
+            for (int n = 0; n < 3; ++n)
+            {
+                CPL_PERF_BEGF(stages[s].first, text.size());
+                const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                const size_t memory = stages[s].second();
+                const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                result.speed = std::max(result.speed, double(text.size()) / 1000000.0 / std::max(seconds, 1e-9));
+                result.memory = std::max(result.memory, memory);
+                CPL_PERF_MEM(stages[s].first, memory);
+            }
+            current.results.push_back(result);
+        }
+#if defined(CPL_PERF_ENABLE)
+        CPL_LOG_SS(Verbose, std::endl << Cpl::PerformanceStorage::Global().Report());
+#endif
+
+        Cpl::Yaml::Document reparsed;
+        reparsed.Parse(serialized);
+        const Cpl::Yaml::Node& service = reparsed.Root()["service7"];
+        if (reparsed.Root().Size() != document.Root().Size() || service["name"].As<std::string>() != document.Root()["service7"]["name"].As<std::string>() ||
+            service["script"].As<std::string>() != "set -e\nrun --service 7 --verbose\necho done\n" || service["hosts"].Size() < 10)
+        {
+            CPL_LOG_SS(Error, "YAML benchmark corpus doesn't survive serialization!");
+            return false;
+        }
+
+        YamlBenchmarkResults baseline;
+        const std::string& dir = Test::BenchmarkDir();
+        if (!dir.empty())
+        {
+            Cpl::Yaml::Document saved;
+            for (size_t i = 0; i < current.results.size(); ++i)
+            {
+                const YamlBenchmarkResult& result = current.results[i];
+                Cpl::Yaml::Node& node = saved.Root()["results"].PushBack();
+                node["name"] = result.name;
+                node["speed"] = Cpl::ToStr(result.speed, 1);
+                node["memory"] = std::to_string(result.memory);
+            }
+            Cpl::Yaml::Serialize(saved.Root(), (dir + "/yaml_benchmark.yml").c_str());
+
+            Cpl::Yaml::Schema<YamlBenchmarkResult> result;
+            result.Field("name", &YamlBenchmarkResult::name).Field("speed", &YamlBenchmarkResult::speed)
+                .Field("memory", &YamlBenchmarkResult::memory);
+            Cpl::Yaml::Schema<YamlBenchmarkResults> schema;
+            schema.Field("results", &YamlBenchmarkResults::results, result);
+            const Cpl::Yaml::Status status = schema.TryLoad(baseline, (dir + "/yaml_benchmark_baseline.yml").c_str());
+            if (status.Failed && status.Type != Cpl::Yaml::Exception::OperationError)
+                CPL_LOG_SS(Warning, "YAML benchmark baseline is invalid: " << status.Message);
+        }
+
+        std::stringstream report;
+        report << "YAML benchmark on " << Cpl::ToStr(double(text.size()) / 1000000.0, 1) << " MB of synthetic YAML:" << std::endl;
+        for (size_t i = 0; i < current.results.size(); ++i)
+        {
+            const YamlBenchmarkResult& now = current.results[i];
+            report << now.name << ": " << Cpl::ToStr(now.speed, 1) << " MB/s";
+            if (now.memory)
+                report << ", memory " << now.memory / 1024 << " kB";
+            for (size_t j = 0; j < baseline.results.size(); ++j)
+            {
+                const YamlBenchmarkResult& base = baseline.results[j];
+                if (base.name == now.name && base.speed > 0)
+                {
+                    report << " (baseline " << Cpl::ToStr(base.speed, 1) << " MB/s: " << Cpl::ToStr((now.speed / base.speed - 1.0) * 100.0, 1) << "%";
+                    if (base.memory)
+                        report << ", memory " << base.memory / 1024 << " kB";
+                    report << ")";
+                    if (now.speed < base.speed * 0.8 || (base.memory > 0 && now.memory > base.memory + base.memory / 5))
+                        CPL_LOG_SS(Warning, "YAML benchmark stage '" << now.name << "' is worse than the baseline!");
+                }
+            }
+            report << std::endl;
+        }
+        CPL_LOG_SS(Info, report.str());
+        return true;
+    }
 }